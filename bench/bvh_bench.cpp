@@ -0,0 +1,207 @@
+// Measures the bounding volume hierarchy against flat loops over every object: frustum culling against cull_spheres,
+// and picking with a ray against testing every sphere. Also measures building, optimizing and keeping the tree in sync
+// with moving objects.
+// The scene is scattered around the camera so that under a tenth of it is visible, like a large open level.
+
+#include "gfx/bvh.h"
+#include "gfx/frustum_culling.h"
+#include "types.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+using namespace rune;
+
+namespace {
+
+struct Scene {
+    std::vector<f32> x, y, z, radius;
+
+    [[nodiscard]] BoundingSpheres get_bounding_spheres() const {
+        BoundingSpheres result = {};
+        result.x               = x.data();
+        result.y               = y.data();
+        result.z               = z.data();
+        result.radius          = radius.data();
+        result.count           = x.size();
+        return result;
+    }
+
+    [[nodiscard]] Aabb get_bounds(u32 i) const {
+        return Aabb::from_sphere(glm::vec3(x[i], y[i], z[i]), radius[i]);
+    }
+};
+
+Scene make_scene(u32 num_spheres) {
+    std::mt19937                          rng(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.5f, 4.0f);
+
+    Scene scene;
+    for (u32 i = 0; i < num_spheres; ++i) {
+        scene.x.push_back(position(rng));
+        scene.y.push_back(position(rng));
+        scene.z.push_back(position(rng));
+        scene.radius.push_back(size(rng));
+    }
+
+    return scene;
+}
+
+/**
+ * Distance along a normalized ray to where it enters a sphere
+ * @return The distance, or a negative number if it misses
+ */
+f32 intersect_sphere(const Scene& scene, u32 i, glm::vec3 origin, glm::vec3 direction) {
+    glm::vec3 offset = origin - glm::vec3(scene.x[i], scene.y[i], scene.z[i]);
+    f32       b      = glm::dot(offset, direction);
+    f32       c      = glm::dot(offset, offset) - scene.radius[i] * scene.radius[i];
+    f32       h      = b * b - c;
+    return h < 0.0f ? -1.0f : -b - std::sqrt(h);
+}
+
+/**
+ * Time a function, the fastest run is the one least disturbed by the rest of the system
+ * @return The time of the fastest run in nanoseconds
+ */
+template <typename Func> f64 measure(Func func, u32 iterations) {
+    func(); // warm up
+
+    f64 best_ns = 1e30;
+    for (u32 i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+        best_ns  = std::min(best_ns, std::chrono::duration<f64, std::nano>(end - start).count());
+    }
+
+    return best_ns;
+}
+
+} // namespace
+
+int main() {
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+    glm::mat4 view       = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum   frustum    = Frustum(projection * view);
+
+    for (u32 num_spheres : {10'000u, 100'000u, 1'000'000u}) {
+        Scene           scene   = make_scene(num_spheres);
+        BoundingSpheres spheres = scene.get_bounding_spheres();
+
+        Bvh              bvh;
+        std::vector<u32> proxies(num_spheres);
+        f64              build_ns = measure(
+            [&]() {
+                bvh.clear();
+                for (u32 i = 0; i < num_spheres; ++i) {
+                    proxies[i] = bvh.insert(scene.get_bounds(i), i);
+                }
+            },
+            3);
+
+        std::printf("%u spheres, tree height %u, built in %.2f ms\n", num_spheres, bvh.get_height(), build_ns * 1e-6);
+
+        f64 optimize_ns = measure([&]() { bvh.optimize(); }, 3);
+        std::printf("  %-34s %9.3f ms\n", "optimize", optimize_ns * 1e-6);
+
+        std::vector<u32> visible(num_spheres);
+        u32              num_visible = 0;
+
+        f64 flat_ns = measure([&]() { num_visible = cull_spheres(frustum, spheres, visible.data()); }, 20);
+        std::printf("  %-34s %9.3f ms %8u visible\n", "frustum, cull_spheres", flat_ns * 1e-6, num_visible);
+
+        f64 tree_ns = measure(
+            [&]() {
+                num_visible = 0;
+                bvh.query_frustum(frustum, [&](u32 i) { visible[num_visible++] = i; });
+            },
+            20);
+        std::printf("  %-34s %9.3f ms %8u visible %6.2fx\n",
+                    "frustum, Bvh::query_frustum",
+                    tree_ns * 1e-6,
+                    num_visible,
+                    flat_ns / tree_ns);
+
+        // every object reports its bounds each frame, most of them haven't moved
+        f64 sync_ns = measure(
+            [&]() {
+                for (u32 i = 0; i < num_spheres; ++i) {
+                    bvh.move(proxies[i], scene.get_bounds(i));
+                }
+            },
+            20);
+        std::printf("  %-34s %9.3f ms\n", "sync, nothing moved", sync_ns * 1e-6);
+
+        // a tenth of the objects drift a little every frame
+        std::mt19937                          rng(5678);
+        std::uniform_real_distribution<float> drift(-0.05f, 0.05f);
+        f64                                   move_ns = measure(
+            [&]() {
+                for (u32 i = 0; i < num_spheres; i += 10) {
+                    scene.x[i] += drift(rng);
+                    scene.y[i] += drift(rng);
+                    scene.z[i] += drift(rng);
+                    bvh.move(proxies[i], scene.get_bounds(i));
+                }
+            },
+            20);
+        std::printf("  %-34s %9.3f ms\n", "sync, a tenth drifting", move_ns * 1e-6);
+
+        // picking, closest hit along rays from the camera
+        constexpr u32 num_rays = 100;
+
+        std::uniform_real_distribution<float> spread(-0.5f, 0.5f);
+        std::vector<glm::vec3>                directions;
+        for (u32 i = 0; i < num_rays; ++i) {
+            directions.push_back(glm::normalize(glm::vec3(spread(rng), spread(rng), -1.0f)));
+        }
+
+        u32 num_brute_hits = 0;
+        f64 brute_ns       = measure(
+            [&]() {
+                num_brute_hits = 0;
+                for (glm::vec3 direction : directions) {
+                    f32 closest = 1000.0f;
+                    for (u32 i = 0; i < num_spheres; ++i) {
+                        f32 t = intersect_sphere(scene, i, glm::vec3(0.0f), direction);
+                        closest = t >= 0.0f && t < closest ? t : closest;
+                    }
+                    num_brute_hits += closest < 1000.0f ? 1 : 0;
+                }
+            },
+            3);
+        std::printf("  %-34s %9.3f us/ray %5u hits\n",
+                    "pick, every sphere",
+                    brute_ns * 1e-3 / num_rays,
+                    num_brute_hits);
+
+        u32 num_tree_hits = 0;
+        f64 pick_ns       = measure(
+            [&]() {
+                num_tree_hits = 0;
+                for (glm::vec3 direction : directions) {
+                    f32 closest = 1000.0f;
+                    bvh.query_ray(glm::vec3(0.0f), direction, closest, [&](u32 i, f32 max_t) {
+                        f32 t   = intersect_sphere(scene, i, glm::vec3(0.0f), direction);
+                        closest = t >= 0.0f && t < max_t ? t : max_t;
+                        return closest;
+                    });
+                    num_tree_hits += closest < 1000.0f ? 1 : 0;
+                }
+            },
+            3);
+        std::printf("  %-34s %9.3f us/ray %5u hits %6.2fx\n",
+                    "pick, Bvh::query_ray",
+                    pick_ns * 1e-3 / num_rays,
+                    num_tree_hits,
+                    brute_ns / pick_ns);
+    }
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Measures ordering a frame's draws: grouping render objects by mesh in a hash map of vectors, like the renderer used
+// to, against sorting draw keys with std::sort and with radix_sort. Speedups are relative to the grouping, which
+// doesn't order the objects by depth.
+// Objects are spread over a few hundred meshes at random depths, like a level with a lot of instanced props.
+
+#include "gfx/draw_key.h"
+#include "types.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace rune;
+
+namespace {
+
+struct Scene {
+    std::vector<u32> mesh_indices;
+    std::vector<f32> depths;
+};
+
+Scene make_scene(u32 num_objects, u32 num_meshes) {
+    std::mt19937                          rng(1234);
+    std::uniform_int_distribution<u32>    mesh(0, num_meshes - 1);
+    std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+
+    Scene scene;
+    for (u32 i = 0; i < num_objects; ++i) {
+        scene.mesh_indices.push_back(mesh(rng));
+        scene.depths.push_back(depth(rng));
+    }
+
+    return scene;
+}
+
+/**
+ * Time a function, the fastest run is the one least disturbed by the rest of the system
+ * @return The time of the fastest run in nanoseconds
+ */
+template <typename Func> f64 measure(Func func, u32 iterations) {
+    func(); // warm up
+
+    f64 best_ns = 1e30;
+    for (u32 i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+        best_ns  = std::min(best_ns, std::chrono::duration<f64, std::nano>(end - start).count());
+    }
+
+    return best_ns;
+}
+
+} // namespace
+
+int main() {
+    constexpr u32 num_meshes = 300;
+
+    for (u32 num_objects : {1'000u, 10'000u, 100'000u}) {
+        Scene scene = make_scene(num_objects, num_meshes);
+        std::printf("%u objects, %u meshes\n", num_objects, num_meshes);
+
+        // a fresh map every frame, like the arena backed one that was reset each frame
+        u32 num_groups = 0;
+        f64 map_ns     = measure(
+            [&]() {
+                std::unordered_map<u64, std::vector<u32>> objects_by_mesh;
+                for (u32 i = 0; i < num_objects; ++i) {
+                    objects_by_mesh[scene.mesh_indices[i]].push_back(i);
+                }
+                num_groups = objects_by_mesh.size();
+            },
+            20);
+        std::printf("  %-34s %9.3f us %6u batches\n", "group, unordered_map", map_ns * 1e-3, num_groups);
+
+        std::vector<gfx::SortItem> items(num_objects);
+        std::vector<gfx::SortItem> temp(num_objects);
+        auto                       make_keys = [&]() {
+            for (u32 i = 0; i < num_objects; ++i) {
+                items[i] = {gfx::DrawKey::make(0, 0, scene.mesh_indices[i], scene.depths[i]), i};
+            }
+        };
+
+        f64 std_sort_ns = measure(
+            [&]() {
+                make_keys();
+                std::sort(items.begin(), items.end(), [](const gfx::SortItem& a, const gfx::SortItem& b) {
+                    return a.key < b.key;
+                });
+            },
+            20);
+        std::printf("  %-34s %9.3f us %6.2fx\n", "sort keys, std::sort", std_sort_ns * 1e-3, map_ns / std_sort_ns);
+
+        f64 radix_ns = measure(
+            [&]() {
+                make_keys();
+                gfx::radix_sort(items, temp);
+            },
+            20);
+        std::printf("  %-34s %9.3f us %6.2fx\n", "sort keys, radix_sort", radix_ns * 1e-3, map_ns / radix_ns);
+    }
+
+    return 0;
+}
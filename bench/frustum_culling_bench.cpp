@@ -0,0 +1,130 @@
+// Measures cpu frustum culling of bounding spheres: a loop over Frustum::intersects_sphere on an array of spheres,
+// against cull_spheres' scalar and SIMD versions on the same spheres in structure of arrays layout.
+// The scene is scattered around the camera so that under a tenth of it is visible, like a large open level.
+
+#include "gfx/frustum_culling.h"
+#include "types.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+using namespace rune;
+
+namespace {
+
+struct Scene {
+    std::vector<glm::vec4> spheres; // array of structures, xyz center and w radius
+    std::vector<f32>       x, y, z, radius;
+
+    [[nodiscard]] BoundingSpheres get_bounding_spheres() const {
+        BoundingSpheres result = {};
+        result.x               = x.data();
+        result.y               = y.data();
+        result.z               = z.data();
+        result.radius          = radius.data();
+        result.count           = spheres.size();
+        return result;
+    }
+};
+
+Scene make_scene(u32 num_spheres) {
+    std::mt19937                          rng(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.5f, 4.0f);
+
+    Scene scene;
+    for (u32 i = 0; i < num_spheres; ++i) {
+        glm::vec4 sphere = glm::vec4(position(rng), position(rng), position(rng), size(rng));
+        scene.spheres.push_back(sphere);
+        scene.x.push_back(sphere.x);
+        scene.y.push_back(sphere.y);
+        scene.z.push_back(sphere.z);
+        scene.radius.push_back(sphere.w);
+    }
+
+    return scene;
+}
+
+[[gnu::noinline]] u32 cull_array_of_structures(const Frustum&                frustum,
+                                               const std::vector<glm::vec4>& spheres,
+                                               u32*                          visible_indices) {
+    u32 num_visible = 0;
+    for (u32 i = 0; i < spheres.size(); ++i) {
+        if (frustum.intersects_sphere(glm::vec3(spheres[i]), spheres[i].w)) {
+            visible_indices[num_visible++] = i;
+        }
+    }
+    return num_visible;
+}
+
+/**
+ * Time a culling function, the fastest run is the one least disturbed by the rest of the system
+ * @return The time of the fastest run in nanoseconds
+ */
+template <typename CullFunc> f64 measure(CullFunc cull, std::vector<u32>& visible, u32& num_visible) {
+    constexpr u32 iterations = 50;
+
+    cull(visible.data()); // warm up
+
+    f64 best_ns = 1e30;
+    for (u32 i = 0; i < iterations; ++i) {
+        auto start  = std::chrono::steady_clock::now();
+        num_visible = cull(visible.data());
+        auto end    = std::chrono::steady_clock::now();
+        best_ns     = std::min(best_ns, std::chrono::duration<f64, std::nano>(end - start).count());
+    }
+
+    return best_ns;
+}
+
+} // namespace
+
+int main() {
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+    glm::mat4 view       = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum   frustum    = Frustum(projection * view);
+
+    for (u32 num_spheres : {100'000u, 1'000'000u}) {
+        Scene            scene   = make_scene(num_spheres);
+        BoundingSpheres  spheres = scene.get_bounding_spheres();
+        std::vector<u32> expected(num_spheres);
+        std::vector<u32> visible(num_spheres);
+
+        auto aos = [&](u32* out) { return cull_array_of_structures(frustum, scene.spheres, out); };
+
+        u32 num_expected = 0;
+        f64 baseline_ns  = measure(aos, expected, num_expected);
+
+        std::printf("%u spheres, %u visible\n", num_spheres, num_expected);
+        std::printf("%-28s %8.3f ms %6.2f ns/sphere\n",
+                    "Frustum::intersects_sphere",
+                    baseline_ns * 1e-6,
+                    baseline_ns / num_spheres);
+
+        // every version has to find the same spheres as the plain loop
+        auto report = [&](const char* name, auto cull) {
+            u32 num_visible = 0;
+            f64 ns          = measure(cull, visible, num_visible);
+            std::printf("%-28s %8.3f ms %6.2f ns/sphere %5.2fx", name, ns * 1e-6, ns / num_spheres, baseline_ns / ns);
+            bool is_same = num_visible == num_expected &&
+                           std::equal(expected.begin(), expected.begin() + num_expected, visible.begin());
+            std::printf(is_same ? "\n" : " MISMATCH\n");
+        };
+
+        report("cull_spheres_scalar", [&](u32* out) { return detail::cull_spheres_scalar(frustum, spheres, out); });
+#ifdef RUNE_HAS_CULL_SSE
+        report("cull_spheres_sse", [&](u32* out) { return detail::cull_spheres_sse(frustum, spheres, out); });
+#endif
+#ifdef RUNE_HAS_CULL_AVX2
+        if (detail::cpu_supports_avx2()) {
+            report("cull_spheres_avx2", [&](u32* out) { return detail::cull_spheres_avx2(frustum, spheres, out); });
+        }
+#endif
+    }
+
+    return 0;
+}
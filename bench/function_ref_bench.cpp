@@ -0,0 +1,114 @@
+// Measures the per-call overhead of passing a recording callback to a pass as a std::function versus a FunctionRef.
+// The callbacks capture about as much as the ones in Renderer::render and GraphicsBackend::copy_to_buffer.
+
+#include "function_ref.h"
+#include "types.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+using namespace rune;
+
+namespace {
+
+u64 g_num_allocations = 0;
+
+struct FakeCommandBuffer_T {
+    u64 num_commands = 0;
+};
+using FakeCommandBuffer = FakeCommandBuffer_T*;
+
+// stands in for what gets captured by copy_to_buffer
+struct FakeBuffer {
+    void* buffer     = nullptr;
+    u64   range      = 0;
+    void* allocation = nullptr;
+    u64   info[7]    = {};
+};
+
+[[gnu::noinline]] void run_std_function(FakeCommandBuffer cmd, const std::function<void(FakeCommandBuffer)>& func) {
+    ++cmd->num_commands; // begin pass
+    func(cmd);
+    ++cmd->num_commands; // end pass
+}
+
+[[gnu::noinline]] void run_function_ref(FakeCommandBuffer cmd, FunctionRef<void(FakeCommandBuffer)> func) {
+    ++cmd->num_commands;
+    func(cmd);
+    ++cmd->num_commands;
+}
+
+template <typename RunFunc> f64 bench_render_lambda(RunFunc run, u32 iterations) {
+    FakeCommandBuffer_T cmd_data;
+    FakeBuffer          vertices, objects;
+    u64                 batch_group = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < iterations; ++i) {
+        run(&cmd_data, [&](FakeCommandBuffer cmd) {
+            cmd->num_commands += (u64)vertices.range + (u64)objects.range + batch_group;
+        });
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<f64, std::nano>(end - start).count() / iterations;
+}
+
+template <typename RunFunc> f64 bench_copy_lambda(RunFunc run, u32 iterations) {
+    FakeCommandBuffer_T cmd_data;
+    FakeBuffer          staging, dst;
+    u64                 size = 64, offset = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < iterations; ++i) {
+        run(&cmd_data, [=](FakeCommandBuffer cmd) { cmd->num_commands += size + offset + staging.range + dst.range; });
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<f64, std::nano>(end - start).count() / iterations;
+}
+
+template <typename Bench, typename RunFunc> void report(const char* name, Bench bench, RunFunc run) {
+    constexpr u32 iterations = 10'000'000;
+
+    bench(run, iterations / 10); // warm up
+
+    u64 allocations_before = g_num_allocations;
+    f64 ns_per_call        = bench(run, iterations);
+    f64 allocs_per_call    = (f64)(g_num_allocations - allocations_before) / iterations;
+
+    std::printf("%-36s %8.2f ns/pass %6.2f allocations/pass\n", name, ns_per_call, allocs_per_call);
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    ++g_num_allocations;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+int main() {
+    auto std_function = [](FakeCommandBuffer cmd, const auto& func) { run_std_function(cmd, func); };
+    auto function_ref = [](FakeCommandBuffer cmd, const auto& func) { run_function_ref(cmd, func); };
+
+    report("render lambda, std::function", [](auto r, u32 n) { return bench_render_lambda(r, n); }, std_function);
+    report("render lambda, FunctionRef", [](auto r, u32 n) { return bench_render_lambda(r, n); }, function_ref);
+    report("copy lambda, std::function", [](auto r, u32 n) { return bench_copy_lambda(r, n); }, std_function);
+    report("copy lambda, FunctionRef", [](auto r, u32 n) { return bench_copy_lambda(r, n); }, function_ref);
+
+    return 0;
+}
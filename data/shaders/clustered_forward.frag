@@ -0,0 +1,46 @@
+#version 450
+#include "lights.glsl"
+#include "material.glsl"
+
+// Lights geometry as it's drawn with only the lights of the cluster each pixel falls in, see light_clustering.comp.
+// Drawn with gbuffer.vert, which passes on the world position the flat normal is taken from like in gbuffer.frag
+
+layout (location = 0) in VertexData {
+    vec2 uv;
+    float object_id;
+    vec3 world_position;
+    flat uint material_index;
+} FS_IN;
+
+layout (location = 0) out vec4 o_img;
+
+// after the vertex shaders' bindings
+layout (std430, set = 0, binding = 4) readonly buffer LightBuffer {
+    PointLight data[];
+} u_lights;
+
+layout (std430, set = 0, binding = 5) readonly buffer LightClusterBuffer {
+    LightClusterGrid grid;
+    uint data[];
+} u_light_clusters;
+
+layout (std430, set = 0, binding = 8) readonly buffer DirectionalLightBuffer {
+    DirectionalLightData data;
+} u_directional_light;
+
+void main() {
+    // framebuffer y points down, so this faces the camera
+    vec3 normal = normalize(cross(dFdy(FS_IN.world_position), dFdx(FS_IN.world_position)));
+    vec3 diffuse = u_materials.data[FS_IN.material_index].base_color.rgb;
+
+    uint first = get_light_cluster(u_light_clusters.grid, gl_FragCoord.xyz);
+    uint num_lights = u_light_clusters.data[first];
+
+    vec3 irradiance = AMBIENT_LIGHT + get_directional_light_irradiance(u_directional_light.data.light, normal);
+    for (uint i = 0; i < num_lights; ++i) {
+        PointLight light = u_lights.data[u_light_clusters.data[first + 1 + i]];
+        irradiance += get_point_light_irradiance(light, FS_IN.world_position, normal);
+    }
+
+    o_img = vec4(diffuse * irradiance, 1);
+}
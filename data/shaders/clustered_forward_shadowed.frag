@@ -0,0 +1,65 @@
+#version 450
+#include "lights.glsl"
+#include "material.glsl"
+
+// Like clustered_forward.frag, but the directional light is tested against its cascaded shadow maps, see
+// gfx::ShadowMaps
+
+layout (location = 0) in VertexData {
+    vec2 uv;
+    float object_id;
+    vec3 world_position;
+    flat uint material_index;
+} FS_IN;
+
+layout (location = 0) out vec4 o_img;
+
+// after the vertex shaders' bindings
+layout (std430, set = 0, binding = 4) readonly buffer LightBuffer {
+    PointLight data[];
+} u_lights;
+
+layout (std430, set = 0, binding = 5) readonly buffer LightClusterBuffer {
+    LightClusterGrid grid;
+    uint data[];
+} u_light_clusters;
+
+layout (std430, set = 0, binding = 8) readonly buffer DirectionalLightBuffer {
+    DirectionalLightData data;
+} u_directional_light;
+
+// a layer per cascade, compares with the depth it's given
+layout (set = 0, binding = 9) uniform sampler2DArrayShadow u_shadow_map;
+
+// How much of the directional light reaches a position, tested in the smallest cascade that covers it. Outside of
+// every cascade nothing is in shadow
+float get_shadow(vec3 position) {
+    for (uint i = 0; i < u_directional_light.data.num_cascades; ++i) {
+        vec3 ndc = (u_directional_light.data.cascades[i] * vec4(position, 1)).xyz;
+
+        // the shadow pass' viewport is flipped like the geometry passes', so y points up in ndc
+        vec2 uv = vec2(0.5 + 0.5 * ndc.x, 0.5 - 0.5 * ndc.y);
+        if (all(greaterThanEqual(uv, vec2(0))) && all(lessThanEqual(uv, vec2(1))) && ndc.z <= 1) {
+            return texture(u_shadow_map, vec4(uv, i, ndc.z));
+        }
+    }
+    return 1;
+}
+
+void main() {
+    // framebuffer y points down, so this faces the camera
+    vec3 normal = normalize(cross(dFdy(FS_IN.world_position), dFdx(FS_IN.world_position)));
+    vec3 diffuse = u_materials.data[FS_IN.material_index].base_color.rgb;
+
+    uint first = get_light_cluster(u_light_clusters.grid, gl_FragCoord.xyz);
+    uint num_lights = u_light_clusters.data[first];
+
+    vec3 sun = get_directional_light_irradiance(u_directional_light.data.light, normal);
+    vec3 irradiance = AMBIENT_LIGHT + sun * get_shadow(FS_IN.world_position);
+    for (uint i = 0; i < num_lights; ++i) {
+        PointLight light = u_lights.data[u_light_clusters.data[first + 1 + i]];
+        irradiance += get_point_light_irradiance(light, FS_IN.world_position, normal);
+    }
+
+    o_img = vec4(diffuse * irradiance, 1);
+}
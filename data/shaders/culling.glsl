@@ -0,0 +1,17 @@
+// Whether a sphere is at least partly inside the frustum of a view projection matrix.
+// Gribb and Hartmann plane extraction, see Frustum
+bool is_in_frustum(mat4 vp, vec3 center, float radius) {
+    mat4 rows = transpose(vp);
+    vec4 planes[6] = vec4[](rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1],
+                            rows[3] + rows[2], rows[3] - rows[2]);
+
+    for (uint i = 0; i < 6; ++i) {
+        vec4 plane = planes[i] / length(planes[i].xyz);
+        if (dot(plane.xyz, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
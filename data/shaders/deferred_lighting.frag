@@ -0,0 +1,57 @@
+#version 450
+#include "lights.glsl"
+
+// Lights every pixel of the g-buffer with only the lights binned into its screen tile by light_culling.comp, so the
+// cost per pixel follows the lights that reach it and not the lights in the scene
+
+layout (set = 0, binding = 0) uniform sampler2D u_diffuse;
+layout (set = 0, binding = 1) uniform sampler2D u_normal;
+layout (set = 0, binding = 2) uniform sampler2D u_occlusion_roughness_metallic;
+layout (set = 0, binding = 3) uniform sampler2D u_depth;
+
+layout (std430, set = 0, binding = 4) readonly buffer LightBuffer {
+    PointLight data[];
+} u_lights;
+
+layout (std430, set = 0, binding = 5) readonly buffer LightTileBuffer {
+    uint data[];
+} u_light_tiles;
+
+layout (location = 0) out vec4 o_img;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 inverse_vp;
+    vec4 viewport; // offset in xy and extent in zw, in pixels
+    uvec4 info;    // the number of tiles along x in x
+} u_push;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(u_depth, pixel, 0).r;
+    if (depth == 1) {
+        o_img = vec4(0, 0, 0, 1);
+        return;
+    }
+
+    // the geometry pass' viewport is flipped so y points up in ndc
+    vec2 ndc = (gl_FragCoord.xy - u_push.viewport.xy) / u_push.viewport.zw * 2 - 1;
+    vec4 world_position = u_push.inverse_vp * vec4(ndc.x, -ndc.y, depth, 1);
+    vec3 position = world_position.xyz / world_position.w;
+
+    vec3 diffuse = texelFetch(u_diffuse, pixel, 0).rgb;
+    vec3 normal = normalize(texelFetch(u_normal, pixel, 0).xyz * 2 - 1);
+    float occlusion = texelFetch(u_occlusion_roughness_metallic, pixel, 0).r;
+
+    uvec2 tile = uvec2(pixel) / LIGHT_TILE_SIZE;
+    uint first = (tile.y * u_push.info.x + tile.x) * (1 + MAX_LIGHTS_PER_TILE);
+    uint num_lights = u_light_tiles.data[first];
+
+    vec3 irradiance = AMBIENT_LIGHT * occlusion;
+    for (uint i = 0; i < num_lights; ++i) {
+        PointLight light = u_lights.data[u_light_tiles.data[first + 1 + i]];
+        irradiance += get_point_light_irradiance(light, position, normal);
+    }
+
+    o_img = vec4(diffuse * irradiance, 1);
+}
@@ -0,0 +1,19 @@
+#version 450
+#include "vertex_pulling.glsl"
+
+// Position only version of triangle.vert for the depth prepass. Both declare gl_Position invariant so the depth written
+// here matches the geometry pass exactly and it can test with EQUAL.
+
+invariant gl_Position;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+} u_push;
+
+void main() {
+    Vertex v = get_vertex(gl_VertexIndex);
+    ObjectData o = u_object_data.data[gl_InstanceIndex];
+
+    gl_Position = u_push.vp * o.model_matrix * vec4(v.position, 1);
+}
@@ -0,0 +1,24 @@
+#version 450
+#include "vertex_pulling.glsl"
+#include "single_draw.glsl"
+
+// Position only version of triangle_single_draw.vert for the depth prepass.
+
+invariant gl_Position;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+} u_push;
+
+void main() {
+    uint flat_vertex = gl_VertexIndex;
+
+    InstanceRange range = find_instance_range(flat_vertex, gl_InstanceIndex);
+    MeshData mesh = u_mesh_table.data[range.mesh_index];
+
+    Vertex v = get_vertex(mesh.lods[0].first_vertex + (flat_vertex - range.first_vertex));
+    ObjectData o = u_object_data.data[range.object_index];
+
+    gl_Position = u_push.vp * o.model_matrix * vec4(v.position, 1);
+}
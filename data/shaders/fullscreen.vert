@@ -0,0 +1,8 @@
+#version 450
+
+// A triangle that covers the whole viewport, draw it with 3 vertices and no buffers.
+
+void main() {
+    vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(uv * 2 - 1, 0, 1);
+}
@@ -0,0 +1,27 @@
+#version 450
+#include "material.glsl"
+
+// Writes the surface of each pixel to the g-buffer, deferred_lighting.frag lights it later. Vertices don't carry
+// normals, so each triangle gets its flat normal from the screen space derivatives of its world position
+
+layout (location = 0) in VertexData {
+    vec2 uv;
+    float object_id;
+    vec3 world_position;
+    flat uint material_index;
+} FS_IN;
+
+layout (location = 0) out vec4 o_diffuse;
+layout (location = 1) out vec4 o_normal;
+layout (location = 2) out vec4 o_occlusion_roughness_metallic;
+
+void main() {
+    // framebuffer y points down, so this faces the camera
+    vec3 normal = normalize(cross(dFdy(FS_IN.world_position), dFdx(FS_IN.world_position)));
+
+    MaterialData material = u_materials.data[FS_IN.material_index];
+
+    o_diffuse = material.base_color;
+    o_normal = vec4(normal * 0.5 + 0.5, 0);
+    o_occlusion_roughness_metallic = vec4(1, material.roughness, material.metallic, 0);
+}
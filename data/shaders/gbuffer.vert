@@ -0,0 +1,34 @@
+#version 450
+#include "vertex_pulling.glsl"
+
+// Like triangle.vert, but also passes on the world space position gbuffer.frag derives the surface normal from
+
+layout (location = 0) out VertexData {
+    vec2 uv;
+    float object_id;
+    vec3 world_position;
+    flat uint material_index;
+} VS_OUT;
+
+// matches depth_prepass.vert exactly so the prepass depth can be tested with EQUAL
+invariant gl_Position;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+} u_push;
+
+void main() {
+    uint object_id = gl_InstanceIndex;
+
+    Vertex v = get_vertex(gl_VertexIndex);
+    ObjectData o = u_object_data.data[object_id];
+
+    vec4 position = u_push.vp * o.model_matrix * vec4(v.position, 1);
+    VS_OUT.uv = v.uv;
+    VS_OUT.object_id = object_id;
+    VS_OUT.material_index = o.material_index;
+    VS_OUT.world_position = (o.model_matrix * vec4(v.position, 1)).xyz;
+
+    gl_Position = position;
+}
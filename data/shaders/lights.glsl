@@ -0,0 +1,75 @@
+// matches gfx::PointLight
+struct PointLight {
+    vec3 position;
+    float radius; // the light has no effect past this distance
+    vec3 color;
+    float intensity;
+};
+
+// matches gfx::DirectionalLight
+struct DirectionalLight {
+    vec3 direction; // the way the light travels
+    float intensity;
+    vec3 color;
+};
+
+// matches gfx::MAX_SHADOW_CASCADES
+#define MAX_SHADOW_CASCADES 4
+
+// matches gfx::DirectionalLightData
+struct DirectionalLightData {
+    DirectionalLight light;
+    mat4 cascades[MAX_SHADOW_CASCADES]; // world space to the shadow map of each cascade, smallest first
+    uint num_cascades; // 0 if the light casts no shadows
+};
+
+// matches gfx::LIGHT_TILE_SIZE and gfx::MAX_LIGHTS_PER_TILE, a tile's list is a count followed by the light indices
+#define LIGHT_TILE_SIZE 16
+#define MAX_LIGHTS_PER_TILE 255
+
+// matches gfx::LIGHT_CLUSTERS_X, Y and Z and gfx::MAX_LIGHTS_PER_CLUSTER, a cluster's list is laid out like a tile's
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 127
+
+// The grid the cluster lists were built for, it's written in front of them so the shaders that read them don't need it
+// passed again. Its size matches gfx::LIGHT_CLUSTER_HEADER_SIZE
+struct LightClusterGrid {
+    vec4 viewport; // the render area the grid covers, offset in xy and extent in zw, in pixels
+    vec4 depth;    // p[2][2] and p[3][2] of the projection matrix p, the near plane and the slices per log of distance
+};
+
+// lights the whole scene a little, so surfaces no light reaches aren't black
+#define AMBIENT_LIGHT vec3(0.03)
+
+// Diffuse light from a point light reaching a surface, it falls off to nothing at the light's radius
+vec3 get_point_light_irradiance(PointLight light, vec3 position, vec3 normal) {
+    vec3 to_light = light.position - position;
+    float distance_sq = dot(to_light, to_light);
+
+    float window = clamp(1 - distance_sq / (light.radius * light.radius), 0, 1);
+    float attenuation = window * window / (1 + distance_sq);
+    float n_dot_l = max(dot(normal, to_light * inversesqrt(max(distance_sq, 1e-8))), 0);
+
+    return light.color * light.intensity * attenuation * n_dot_l;
+}
+
+// Diffuse light from a directional light reaching a surface, it's the same everywhere
+vec3 get_directional_light_irradiance(DirectionalLight light, vec3 normal) {
+    float n_dot_l = max(dot(normal, -normalize(light.direction)), 0);
+    return light.color * light.intensity * n_dot_l;
+}
+
+// Get where the list of the cluster a fragment falls in starts, its light count comes first
+uint get_light_cluster(LightClusterGrid grid, vec3 frag_coord) {
+    vec2 screen = clamp((frag_coord.xy - grid.viewport.xy) / grid.viewport.zw, 0, 1);
+    vec2 xy = screen * vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y);
+
+    // the distance along the view direction, from the depth the projection wrote
+    float distance = grid.depth.y / (frag_coord.z + grid.depth.x);
+    float slice = max(log(distance / grid.depth.z) * grid.depth.w, 0);
+
+    uvec3 cluster = min(uvec3(vec3(xy, slice)), uvec3(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z) - 1);
+    return ((cluster.z * LIGHT_CLUSTERS_Y + cluster.y) * LIGHT_CLUSTERS_X + cluster.x) * (1 + MAX_LIGHTS_PER_CLUSTER);
+}
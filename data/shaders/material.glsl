@@ -0,0 +1,13 @@
+// matches gfx::MaterialData
+struct MaterialData {
+    vec4 base_color;
+    float roughness;
+    float metallic;
+    uint diffuse_texture; // not sampled until there's a texture table
+    uint normal_texture;
+};
+
+// after every vertex and mesh shader's bindings, so any of them can be paired with a fragment shader that shades
+layout (std430, set = 0, binding = 6) readonly buffer MaterialBuffer {
+    MaterialData data[];
+} u_materials;
@@ -0,0 +1,20 @@
+// matches gfx::MAX_MESH_LODS
+#define MAX_MESH_LODS 4
+
+// matches gfx::MeshLod
+struct MeshLod {
+    uint first_vertex;
+    uint num_vertices;
+    float error; // how far this lod's surface is from the full detail mesh, in model space
+    uint padding;
+};
+
+// matches gfx::MeshData
+struct MeshData {
+    vec4 bounding_sphere; // xyz is the center, w is the radius, in model space
+    uint num_lods;
+    uint first_meshlet; // the meshlets of lods[0] in u_meshlets
+    uint num_meshlets;
+    uint padding;
+    MeshLod lods[MAX_MESH_LODS]; // from most to least detailed
+};
@@ -0,0 +1,65 @@
+#include "culling.glsl"
+
+// matches gfx::MAX_MESHLET_VERTICES and gfx::MAX_MESHLET_TRIANGLES
+#define MAX_MESHLET_VERTICES 64
+#define MAX_MESHLET_TRIANGLES 124
+
+// matches gfx::Meshlet
+struct Meshlet {
+    vec4 bounding_sphere; // xyz is the center, w is the radius, in model space
+    vec4 cone; // xyz is the average normal, w is the cone's cutoff, 1 if it can't be backface culled
+    uint vertex_offset; // first index into u_meshlet_vertices
+    uint triangle_offset; // first entry in u_meshlet_triangles
+    uint vertex_count;
+    uint triangle_count;
+};
+
+struct DrawCommand {
+    uint vertex_count;
+    uint instance_count;
+    uint first_vertex;
+    uint first_instance;
+};
+
+layout (std430, set = 0, binding = 2) readonly buffer MeshletBuffer {
+    Meshlet data[];
+} u_meshlets;
+
+// indices into u_vertices
+layout (std430, set = 0, binding = 3) readonly buffer MeshletVertexBuffer {
+    uint data[];
+} u_meshlet_vertices;
+
+// three indices into a meshlet's vertices, one per byte from the lowest
+layout (std430, set = 0, binding = 4) readonly buffer MeshletTriangleBuffer {
+    uint data[];
+} u_meshlet_triangles;
+
+// meshlets that passed culling when drawing without mesh shaders, drawn with one instance each
+layout (std430, set = 0, binding = 5) buffer VisibleMeshletBuffer {
+    DrawCommand draw;
+    uvec2 data[]; // object index and meshlet index
+} u_visible_meshlets;
+
+uvec3 get_meshlet_triangle(Meshlet meshlet, uint triangle) {
+    uint packed = u_meshlet_triangles.data[meshlet.triangle_offset + triangle];
+    return uvec3(packed & 0xff, (packed >> 8) & 0xff, (packed >> 16) & 0xff);
+}
+
+// Whether any of a meshlet of an object could be seen: it has to be in the frustum and some of its triangles have to
+// face the camera, see gfx::is_meshlet_backfacing
+bool is_meshlet_visible(Meshlet meshlet, mat4 vp, mat4 model_matrix, vec3 camera_position) {
+    // the radius grows with the largest axis scale so that non-uniform scaling stays conservative
+    mat4 m = model_matrix;
+    vec4 sphere = meshlet.bounding_sphere;
+    vec3 center = (m * vec4(sphere.xyz, 1)).xyz;
+    float scale = max(length(m[0].xyz), max(length(m[1].xyz), length(m[2].xyz)));
+    if (!is_in_frustum(vp, center, sphere.w * scale)) {
+        return false;
+    }
+
+    // which side of a triangle the camera is on doesn't change under the model matrix, so the cone is tested in
+    // model space where it's exact even with non-uniform scaling
+    vec3 offset = sphere.xyz - (inverse(m) * vec4(camera_position, 1)).xyz;
+    return dot(offset, meshlet.cone.xyz) < meshlet.cone.w * length(offset) + sphere.w;
+}
@@ -0,0 +1,45 @@
+#version 450
+#include "meshlet.glsl"
+#include "vertex_pulling.glsl"
+
+// Draws the meshlets that cull_meshlets.comp found visible, one instance per meshlet. Every instance has enough
+// vertices for a full meshlet, the ones past the meshlet's last triangle are collapsed to a point outside the view.
+
+layout (location = 0) out VertexData {
+    vec2 uv;
+    float object_id;
+    flat uint material_index;
+} VS_OUT;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+} u_push;
+
+void main() {
+    uint triangle = gl_VertexIndex / 3;
+    uint corner = gl_VertexIndex % 3;
+
+    if (gl_InstanceIndex >= u_visible_meshlets.data.length()) {
+        gl_Position = vec4(0, 0, -1, 1);
+        return;
+    }
+
+    uvec2 visible = u_visible_meshlets.data[gl_InstanceIndex];
+    uint object_id = visible.x;
+    Meshlet meshlet = u_meshlets.data[visible.y];
+    if (triangle >= meshlet.triangle_count) {
+        gl_Position = vec4(0, 0, -1, 1);
+        return;
+    }
+
+    uint local_vertex = get_meshlet_triangle(meshlet, triangle)[corner];
+    Vertex v = get_vertex(u_meshlet_vertices.data[meshlet.vertex_offset + local_vertex]);
+    ObjectData o = u_object_data.data[object_id];
+
+    VS_OUT.uv = v.uv;
+    VS_OUT.object_id = object_id;
+    VS_OUT.material_index = o.material_index;
+
+    gl_Position = u_push.vp * o.model_matrix * vec4(v.position, 1);
+}
@@ -0,0 +1,8 @@
+// matches gfx::ObjectData
+struct ObjectData {
+    mat4 model_matrix;
+    uint mesh_index;
+    uint batch_index; // index of the object's batch within its batch group
+    uint material_index; // into the material buffer, see material.glsl
+    uint visibility_index; // the object's entry in the visibility history, the same every frame the object is drawn
+};
@@ -0,0 +1,19 @@
+#version 450
+
+// Particles are round, fading towards their edge, and blended over what was drawn before them
+
+layout (location = 0) in VertexData {
+    vec2 offset;
+    vec4 color;
+} FS_IN;
+
+layout (location = 0) out vec4 o_img;
+
+void main() {
+    float falloff = 1 - dot(FS_IN.offset, FS_IN.offset);
+    if (falloff <= 0) {
+        discard;
+    }
+
+    o_img = vec4(FS_IN.color.rgb, FS_IN.color.a * falloff);
+}
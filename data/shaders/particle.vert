@@ -0,0 +1,42 @@
+#version 450
+#include "particles.glsl"
+
+// Draws each particle of the draw list as a quad facing the camera. Nothing is bound as vertex input, like
+// triangle.vert pulls its vertices the particle is pulled by instance and the corner of its quad by vertex. The
+// instances are in draw list order, back to front, and their count was written by particle_counts.comp.
+
+layout (std430, set = 0, binding = 0) readonly buffer ParticleBuffer {
+    Particle data[];
+} u_particles;
+
+layout (std430, set = 0, binding = 1) readonly buffer DrawListBuffer {
+    uvec2 data[]; // sort key and index into u_particles
+} u_draw_list;
+
+layout (location = 0) out VertexData {
+    vec2 offset; // from the center of the quad to its corners at -1 and 1
+    vec4 color;
+} VS_OUT;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+    vec4 right; // the camera's right and up in world space, the quad's sides
+    vec4 up;
+} u_push;
+
+// two counter clockwise triangles
+const vec2 CORNERS[6] = vec2[](vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, -1), vec2(1, 1), vec2(-1, 1));
+
+void main() {
+    Particle particle = u_particles.data[u_draw_list.data[gl_InstanceIndex].y];
+    vec2 corner = CORNERS[gl_VertexIndex];
+
+    // fades out over its life
+    float life = clamp(particle.age / particle.lifetime, 0, 1);
+    VS_OUT.offset = corner;
+    VS_OUT.color = vec4(particle.color.rgb, particle.color.a * (1 - life));
+
+    vec3 side = corner.x * u_push.right.xyz + corner.y * u_push.up.xyz;
+    gl_Position = u_push.vp * vec4(particle.position + 0.5 * particle.size * side, 1);
+}
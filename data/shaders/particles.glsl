@@ -0,0 +1,37 @@
+// matches gfx::ParticleSystem::WORKGROUP_SIZE and SORT_WORKGROUP_SIZE
+#define PARTICLE_WORKGROUP_SIZE 64
+#define PARTICLE_SORT_WORKGROUP_SIZE 512
+
+// each sort workgroup sorts a block of two entries per invocation in shared memory
+#define PARTICLE_SORT_BLOCK_SIZE (2 * PARTICLE_SORT_WORKGROUP_SIZE)
+
+// matches gfx::ParticleSystem::Particle
+struct Particle {
+    vec3 position;
+    float size; // world units across
+    vec3 velocity;
+    float age; // seconds since it was emitted
+    vec4 color;
+    float lifetime; // seconds it lives for
+};
+
+struct DrawCommand {
+    uint vertex_count;
+    uint instance_count;
+    uint first_vertex;
+    uint first_instance;
+};
+
+struct DispatchCommand {
+    uint x;
+    uint y;
+    uint z;
+};
+
+// Entries of the draw list sort back to front by their key. The key is never 0, the draw list is cleared to 0 so its
+// unused entries sort after every particle
+uint get_sort_key(vec3 position, vec3 camera_position) {
+    // distances are positive so their bits order the same way, the squared distance orders like the distance
+    vec3 offset = position - camera_position;
+    return floatBitsToUint(dot(offset, offset)) + 1;
+}
@@ -0,0 +1,17 @@
+#version 450
+#include "vertex_pulling.glsl"
+#include "views.glsl"
+
+// Draws shadow map depth with multiview, each view is a cascade of the directional light
+
+layout (push_constant) uniform PushConstants
+{
+    uint first_view;
+} u_push;
+
+void main() {
+    Vertex v = get_vertex(gl_VertexIndex);
+    ObjectData o = u_object_data.data[gl_InstanceIndex];
+
+    gl_Position = get_view_projection(u_push.first_view) * o.model_matrix * vec4(v.position, 1);
+}
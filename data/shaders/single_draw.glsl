@@ -0,0 +1,35 @@
+#include "mesh_table.glsl"
+
+// Used when multiDrawIndirect is unavailable. Every instance of every batch is flattened into one vertex range, so the
+// whole batch group is a single non-indexed draw. The instance and mesh are resolved from gl_VertexIndex.
+
+struct InstanceRange {
+    uint object_index;
+    uint mesh_index;
+    uint first_vertex; // first vertex of this instance in the flattened range
+};
+
+layout (std430, set = 0, binding = 2) readonly buffer MeshTableBuffer {
+    MeshData data[];
+} u_mesh_table;
+
+layout (std430, set = 0, binding = 3) readonly buffer InstanceRangeBuffer {
+    uint count;
+    InstanceRange data[];
+} u_instance_ranges;
+
+// first_range is the first instance range of the batch group, ranges are sorted by first_vertex
+InstanceRange find_instance_range(uint flat_vertex, uint first_range) {
+    uint lo = first_range;
+    uint hi = u_instance_ranges.count;
+    while (hi - lo > 1) {
+        uint mid = (lo + hi) / 2;
+        if (u_instance_ranges.data[mid].first_vertex <= flat_vertex) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return u_instance_ranges.data[lo];
+}
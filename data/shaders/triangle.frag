@@ -1,19 +1,21 @@
 #version 450
 #include "colors.glsl"
+#include "material.glsl"
 
-#define DRAW_OBJECT_ID 1
+#define DRAW_OBJECT_ID 0
 
 layout (location = 0) out vec4 o_img;
 
 layout (location = 0) in VertexData {
     vec2 uv;
     float object_id;
+    flat uint material_index;
 } FS_IN;
 
 void main() {
 #if DRAW_OBJECT_ID
     o_img = vec4(get_color_for_float(FS_IN.object_id), 1);
 #else
-    o_img = vec4(FS_IN.uv, 0.5, 1);
+    o_img = u_materials.data[FS_IN.material_index].base_color;
 #endif
 }
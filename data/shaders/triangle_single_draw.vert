@@ -0,0 +1,36 @@
+#version 450
+#include "vertex_pulling.glsl"
+#include "single_draw.glsl"
+
+layout (location = 0) out VertexData {
+    vec2 uv;
+    float object_id;
+    flat uint material_index;
+} VS_OUT;
+
+// matches depth_prepass_single_draw.vert exactly so the prepass depth can be tested with EQUAL
+invariant gl_Position;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+} u_push;
+
+void main() {
+    uint flat_vertex = gl_VertexIndex;
+
+    // gl_InstanceIndex holds the first instance range of the batch group
+    InstanceRange range = find_instance_range(flat_vertex, gl_InstanceIndex);
+    MeshData mesh = u_mesh_table.data[range.mesh_index];
+    uint object_id = range.object_index;
+
+    Vertex v = get_vertex(mesh.lods[0].first_vertex + (flat_vertex - range.first_vertex));
+    ObjectData o = u_object_data.data[object_id];
+
+    vec4 position = u_push.vp * o.model_matrix * vec4(v.position, 1);
+    VS_OUT.uv = v.uv;
+    VS_OUT.object_id = object_id;
+    VS_OUT.material_index = o.material_index;
+
+    gl_Position = position;
+}
@@ -0,0 +1,24 @@
+#include "object_data.glsl"
+
+struct Vertex {
+    vec3 position;
+    vec2 uv;
+};
+
+layout (std430, set = 0, binding = 0) readonly buffer VertexBuffer {
+    float data[];
+} u_vertices;
+
+layout (std430, set = 0, binding = 1) readonly buffer ObjectDataBuffer {
+    ObjectData data[];
+} u_object_data;
+
+Vertex get_vertex(uint id) {
+    Vertex v;
+    v.position.x = u_vertices.data[id * 5 + 0];
+    v.position.y = u_vertices.data[id * 5 + 1];
+    v.position.z = u_vertices.data[id * 5 + 2];
+    v.uv.x = u_vertices.data[id * 5 + 3];
+    v.uv.y = u_vertices.data[id * 5 + 4];
+    return v;
+}
@@ -0,0 +1,12 @@
+#extension GL_EXT_multiview : require
+
+// The view-projection matrices of multiview passes, see GraphicsBackend::add_views. Each view of a pass draws the same
+// instances with its own matrix, picked by gl_ViewIndex
+
+layout (std430, set = 0, binding = 7) readonly buffer ViewBuffer {
+    mat4 data[];
+} u_views;
+
+mat4 get_view_projection(uint first_view) {
+    return u_views.data[first_view + gl_ViewIndex];
+}
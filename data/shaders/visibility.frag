@@ -0,0 +1,9 @@
+#version 450
+
+layout (location = 0) flat in uint i_visibility_id;
+
+layout (location = 0) out uint o_visibility_id;
+
+void main() {
+    o_visibility_id = i_visibility_id;
+}
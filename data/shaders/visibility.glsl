@@ -0,0 +1,17 @@
+// A visibility buffer id packs the object index, into the object data the geometry was drawn with, above the index of
+// the triangle in the unified vertex buffer. Matches gfx::VISIBILITY_TRIANGLE_BITS
+
+#define VISIBILITY_TRIANGLE_BITS 20
+#define VISIBILITY_NO_ID 0xffffffffu // what the visibility buffer is cleared to
+
+uint pack_visibility_id(uint object_index, uint triangle) {
+    return (object_index << VISIBILITY_TRIANGLE_BITS) | triangle;
+}
+
+uint get_visibility_object_index(uint id) {
+    return id >> VISIBILITY_TRIANGLE_BITS;
+}
+
+uint get_visibility_triangle(uint id) {
+    return id & ((1u << VISIBILITY_TRIANGLE_BITS) - 1u);
+}
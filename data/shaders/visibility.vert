@@ -0,0 +1,24 @@
+#version 450
+#include "vertex_pulling.glsl"
+#include "visibility.glsl"
+
+// Like triangle.vert, but instead of attributes each triangle passes on the id it writes to the visibility buffer.
+// Meshes aren't indexed, so a vertex's triangle in the unified vertex buffer is just its index over 3.
+
+layout (location = 0) flat out uint o_visibility_id;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+} u_push;
+
+void main() {
+    uint object_id = gl_InstanceIndex;
+
+    Vertex v = get_vertex(gl_VertexIndex);
+    ObjectData o = u_object_data.data[object_id];
+
+    o_visibility_id = pack_visibility_id(object_id, gl_VertexIndex / 3);
+
+    gl_Position = u_push.vp * o.model_matrix * vec4(v.position, 1);
+}
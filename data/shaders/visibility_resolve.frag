@@ -0,0 +1,57 @@
+#version 450
+#include "colors.glsl"
+#include "material.glsl"
+#include "vertex_pulling.glsl"
+#include "visibility.glsl"
+
+#define DRAW_OBJECT_ID 0
+
+// Shades every pixel of the visibility buffer exactly once. The pixel's triangle is fetched from the unified vertex
+// buffer again and its attributes are interpolated here instead of by the rasterizer
+
+layout (set = 0, binding = 2) uniform usampler2D u_visibility_ids;
+
+layout (location = 0) out vec4 o_img;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+    vec4 viewport; // offset in xy and extent in zw, in pixels
+} u_push;
+
+void main() {
+    uint id = texelFetch(u_visibility_ids, ivec2(gl_FragCoord.xy), 0).r;
+    if (id == VISIBILITY_NO_ID) {
+        o_img = vec4(0, 0, 0, 1);
+        return;
+    }
+
+    uint object_id = get_visibility_object_index(id);
+    uint triangle = get_visibility_triangle(id);
+    ObjectData o = u_object_data.data[object_id];
+    mat4 mvp = u_push.vp * o.model_matrix;
+
+    Vertex v[3];
+    vec3 h[3];
+    for (uint i = 0; i < 3; ++i) {
+        v[i] = get_vertex(triangle * 3 + i);
+        h[i] = (mvp * vec4(v[i].position, 1)).xyw;
+    }
+
+    // the geometry pass' viewport is flipped so y points up in ndc
+    vec2 ndc = (gl_FragCoord.xy - u_push.viewport.xy) / u_push.viewport.zw * 2 - 1;
+    vec3 p = vec3(ndc.x, -ndc.y, 1);
+
+    // perspective correct barycentrics from the homogeneous 2d positions, they stay correct for vertices behind the
+    // camera that a divide by w would mirror
+    vec3 b = vec3(dot(p, cross(h[1], h[2])), dot(p, cross(h[2], h[0])), dot(p, cross(h[0], h[1])));
+    b /= b.x + b.y + b.z;
+
+    vec2 uv = b.x * v[0].uv + b.y * v[1].uv + b.z * v[2].uv;
+
+#if DRAW_OBJECT_ID
+    o_img = vec4(get_color_for_float(object_id), 1);
+#else
+    o_img = u_materials.data[o.material_index].base_color;
+#endif
+}
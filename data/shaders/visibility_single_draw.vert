@@ -0,0 +1,29 @@
+#version 450
+#include "vertex_pulling.glsl"
+#include "single_draw.glsl"
+#include "visibility.glsl"
+
+// Like triangle_single_draw.vert, but instead of attributes each triangle passes on the id it writes to the visibility
+// buffer, see visibility.vert.
+
+layout (location = 0) flat out uint o_visibility_id;
+
+layout (push_constant) uniform PushConstants
+{
+    mat4 vp;
+} u_push;
+
+void main() {
+    uint flat_vertex = gl_VertexIndex;
+
+    InstanceRange range = find_instance_range(flat_vertex, gl_InstanceIndex);
+    MeshData mesh = u_mesh_table.data[range.mesh_index];
+
+    uint vertex_index = mesh.lods[0].first_vertex + (flat_vertex - range.first_vertex);
+    Vertex v = get_vertex(vertex_index);
+    ObjectData o = u_object_data.data[range.object_index];
+
+    o_visibility_id = pack_visibility_id(range.object_index, vertex_index / 3);
+
+    gl_Position = u_push.vp * o.model_matrix * vec4(v.position, 1);
+}
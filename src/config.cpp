@@ -2,10 +2,71 @@
 
 #include "core.h"
 
+#include <cstdlib>
+#include <string_view>
+
 namespace rune {
 
 Config::Config(Core& core) {
     core.get_logger().info("using default values for config");
+
+    if (const char* meshlets = std::getenv("RUNE_MESHLETS")) {
+        std::string_view mode = meshlets;
+        if (mode == "on") {
+            meshlet_mode_ = MeshletMode::ON;
+        } else if (mode == "fallback") {
+            meshlet_mode_ = MeshletMode::FALLBACK;
+        } else if (mode != "off") {
+            core.get_logger().warn("unknown RUNE_MESHLETS '%', expected on, fallback or off", mode);
+        }
+    }
+
+    if (const char* depth_prepass = std::getenv("RUNE_DEPTH_PREPASS")) {
+        std::string_view mode = depth_prepass;
+        if (mode == "on") {
+            is_depth_prepass_enabled_ = true;
+        } else if (mode != "off") {
+            core.get_logger().warn("unknown RUNE_DEPTH_PREPASS '%', expected on or off", mode);
+        }
+    }
+
+    if (const char* visibility_buffer = std::getenv("RUNE_VISIBILITY_BUFFER")) {
+        std::string_view mode = visibility_buffer;
+        if (mode == "on") {
+            is_visibility_buffer_enabled_ = true;
+        } else if (mode != "off") {
+            core.get_logger().warn("unknown RUNE_VISIBILITY_BUFFER '%', expected on or off", mode);
+        }
+    }
+
+    if (const char* lighting = std::getenv("RUNE_LIGHTING")) {
+        std::string_view mode = lighting;
+        if (mode == "deferred") {
+            lighting_mode_ = LightingMode::DEFERRED;
+        } else if (mode == "clustered") {
+            lighting_mode_ = LightingMode::CLUSTERED;
+        } else if (mode != "forward") {
+            core.get_logger().warn("unknown RUNE_LIGHTING '%', expected forward, deferred or clustered", mode);
+        }
+    }
+
+    if (const char* shadows = std::getenv("RUNE_SHADOWS")) {
+        std::string_view mode = shadows;
+        if (mode == "on") {
+            is_shadows_enabled_ = true;
+        } else if (mode != "off") {
+            core.get_logger().warn("unknown RUNE_SHADOWS '%', expected on or off", mode);
+        }
+    }
+
+    if (const char* particles = std::getenv("RUNE_PARTICLES")) {
+        std::string_view mode = particles;
+        if (mode == "on") {
+            is_particles_enabled_ = true;
+        } else if (mode != "off") {
+            core.get_logger().warn("unknown RUNE_PARTICLES '%', expected on or off", mode);
+        }
+    }
 }
 
 } // namespace rune
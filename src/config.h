@@ -7,6 +7,18 @@ namespace rune {
 
 class Core;
 
+enum class MeshletMode {
+    OFF,      // draw whole meshes
+    ON,       // draw meshlets, with mesh shaders if they're supported
+    FALLBACK, // draw meshlets, culled with compute even if mesh shaders are supported
+};
+
+enum class LightingMode {
+    FORWARD,   // geometry is shaded as it's drawn, without lights
+    DEFERRED,  // geometry is drawn to a g-buffer that's lit per screen tile by the frame's lights
+    CLUSTERED, // geometry is lit as it's drawn by the frame's lights, binned into clusters of the view frustum
+};
+
 class Config {
   public:
     explicit Config(Core& core);
@@ -19,9 +31,62 @@ class Config {
         return window_height_;
     }
 
+    /**
+     * How meshes are drawn, set with RUNE_MESHLETS=on or RUNE_MESHLETS=fallback
+     */
+    [[nodiscard]] MeshletMode get_meshlet_mode() const {
+        return meshlet_mode_;
+    }
+
+    /**
+     * Whether geometry gets a depth only pass before it's shaded, set with RUNE_DEPTH_PREPASS=on
+     */
+    [[nodiscard]] bool is_depth_prepass_enabled() const {
+        return is_depth_prepass_enabled_;
+    }
+
+    /**
+     * Whether geometry only writes triangle ids to a visibility buffer that a full screen pass shades, set with
+     * RUNE_VISIBILITY_BUFFER=on. Takes the place of the depth prepass, which is ignored while it's on
+     */
+    [[nodiscard]] bool is_visibility_buffer_enabled() const {
+        return is_visibility_buffer_enabled_;
+    }
+
+    /**
+     * How geometry is lit, set with RUNE_LIGHTING=deferred or RUNE_LIGHTING=clustered. Either takes the place of the
+     * visibility buffer, which is ignored while they're on
+     */
+    [[nodiscard]] LightingMode get_lighting_mode() const {
+        return lighting_mode_;
+    }
+
+    /**
+     * Whether the directional light casts cascaded shadows, set with RUNE_SHADOWS=on. Only clustered lighting draws
+     * them, on devices with multiview and gpu culling
+     */
+    [[nodiscard]] bool is_shadows_enabled() const {
+        return is_shadows_enabled_;
+    }
+
+    /**
+     * Whether particles are simulated and drawn on the gpu, set with RUNE_PARTICLES=on. They're drawn over geometry
+     * that's shaded as it's drawn, so not with deferred lighting, the visibility buffer or meshlets
+     */
+    [[nodiscard]] bool is_particles_enabled() const {
+        return is_particles_enabled_;
+    }
+
   private:
     u32 window_width_  = 800;
     u32 window_height_ = 600;
+
+    MeshletMode  meshlet_mode_                 = MeshletMode::OFF;
+    bool         is_depth_prepass_enabled_     = false;
+    bool         is_visibility_buffer_enabled_ = false;
+    LightingMode lighting_mode_                = LightingMode::FORWARD;
+    bool         is_shadows_enabled_           = false;
+    bool         is_particles_enabled_         = false;
 };
 
 } // namespace rune
@@ -1,5 +1,7 @@
 #include "core.h"
 
+#include "static_batching.h"
+
 #include <GLFW/glfw3.h>
 
 namespace rune {
@@ -29,6 +31,61 @@ void Core::run() {
     Vertex    square_vertices[] = {bl, br, tr, bl, tr, tl};
     gfx::Mesh square = platform_.get_graphics_backend().load_mesh(square_vertices, std::size(square_vertices));
 
+    // a few materials with evenly spread hues
+    constexpr i32 num_materials = 4;
+    gfx::Material materials[num_materials];
+    for (i32 i = 0; i < num_materials; ++i) {
+        const f32 t = float(i) / float(num_materials) * glm::two_pi<f32>();
+
+        gfx::MaterialDesc material_desc = {};
+        material_desc.data.base_color   = glm::vec4(0.5f + 0.5f * glm::cos(glm::vec3(t, t + 2.1f, t + 4.2f)), 1.0f);
+        material_desc.data.roughness    = 0.25f + 0.5f * float(i) / float(num_materials);
+        materials[i]                    = platform_.get_graphics_backend().create_material(material_desc);
+    }
+
+    // the first instance stays put, the rest orbit it and are moved every frame. What stays put is static, so it's
+    // only drawn again into the shadow maps when they move
+    constexpr i32  num_meshes = 20;
+    InstanceHandle instances[num_meshes];
+    for (i32 i = 0; i < num_meshes; ++i) {
+        // gfx::Mesh mesh = (i < num_meshes / 2) ? triangle : square;
+        gfx::Mesh     mesh     = (i % 2 == 0) ? triangle : square;
+        gfx::Material material = materials[(i / 2) % num_materials];
+
+        instances[i] = renderer_.create_instance(mesh,
+                                                 glm::translate(glm::mat4(1), glm::vec3(0, 0, -1)),
+                                                 material,
+                                                 i == 0);
+    }
+
+    // a checkered wall behind them that never moves, its tiles are merged into a mesh per material
+    constexpr i32             wall_size = 6;
+    std::vector<StaticObject> wall_tiles;
+    for (i32 y = 0; y < wall_size; ++y) {
+        for (i32 x = 0; x < wall_size; ++x) {
+            const f32 spacing = 0.4f;
+            const f32 offset  = 0.5f * float(wall_size - 1);
+            glm::vec3 pos     = glm::vec3(spacing * (float(x) - offset), spacing * (float(y) - offset), -1.5f);
+            glm::mat4 scale   = glm::scale(glm::mat4(1), glm::vec3(0.9f * spacing));
+
+            StaticObject tile        = {};
+            tile.object.model_matrix = glm::translate(glm::mat4(1), pos) * scale;
+            tile.object.mesh         = square;
+            tile.object.material     = materials[(x + y) % 2];
+            tile.vertices            = square_vertices;
+            wall_tiles.emplace_back(tile);
+        }
+    }
+    for (const RenderObject& cluster : build_static_clusters(platform_.get_graphics_backend(), wall_tiles)) {
+        renderer_.create_instance(cluster.mesh, cluster.model_matrix, cluster.material, true);
+    }
+
+    // a dim sun from over the camera's shoulder, the orbiting meshes cast shadows on the wall while they're enabled
+    gfx::DirectionalLight sun = {};
+    sun.direction             = glm::normalize(glm::vec3(-0.4f, -0.5f, -1.0f));
+    sun.intensity             = 0.5f;
+    renderer_.set_directional_light(sun);
+
     while (running_) {
         platform_.update();
 
@@ -36,33 +93,43 @@ void Core::run() {
         f32 time = (f32)glfwGetTime();
         camera.set_position(glm::vec3(std::sin(time), 0, 0));
         renderer_.set_camera(camera);
+        renderer_.set_time(time);
+
+        for (i32 i = 1; i < num_meshes; ++i) {
+            const f32 t        = (0.25f * time + float(i) / float(num_meshes - 1)) * glm::two_pi<f32>();
+            const f32 distance = 0.75f;
+            const f32 scale    = 0.25f;
+            glm::vec3 pos      = distance * glm::vec3(std::cos(t), std::sin(t), -1);
 
-        i32 num_meshes = 20;
-        for (i32 i = 0; i < num_meshes; ++i) {
-            RenderObject obj;
-            // obj.mesh = (i < num_meshes / 2) ? triangle : square;
-            obj.mesh = (i % 2 == 0) ? triangle : square;
-
-            /*
-            obj.model_matrix = ;
-            obj.mesh_id      = ;
-            obj.material_id  = ;
-            */
-
-            if (i == 0) {
-                obj.model_matrix = glm::translate(glm::mat4(1), glm::vec3(0, 0, -1));
-            } else {
-                const f32 t        = (0.25f * time + float(i) / float(num_meshes - 1)) * glm::two_pi<f32>();
-                const f32 distance = 0.75f;
-                const f32 scale    = 0.25f;
-                glm::vec3 pos      = distance * glm::vec3(std::cos(t), std::sin(t), -1);
-
-                obj.model_matrix = glm::translate(glm::mat4(1), pos) * glm::scale(glm::mat4(1), glm::vec3(scale));
-            }
-
-            renderer_.add_to_frame(obj);
+            renderer_.set_transform(instances[i],
+                                    glm::translate(glm::mat4(1), pos) * glm::scale(glm::mat4(1), glm::vec3(scale)));
         }
 
+        // a ring of small lights circling in front of the meshes, they're only seen with deferred or clustered lighting
+        constexpr i32 num_lights = 256;
+        for (i32 i = 0; i < num_lights; ++i) {
+            const f32 t = (-0.1f * time + float(i) / float(num_lights)) * glm::two_pi<f32>();
+
+            gfx::PointLight light = {};
+            light.position        = glm::vec3(0.9f * std::cos(t), 0.9f * std::sin(t), -0.9f);
+            light.radius          = 0.3f;
+            light.color           = 0.5f + 0.5f * glm::cos(glm::vec3(t, t + 2.1f, t + 4.2f));
+            light.intensity       = 1.0f;
+            renderer_.add_light(light);
+        }
+
+        // a fountain rising from below the meshes, it's only seen with particles enabled
+        gfx::ParticleEmitter fountain = {};
+        fountain.position             = glm::vec3(0, -1, -1.2f);
+        fountain.radius               = 0.05f;
+        fountain.velocity             = glm::vec3(0, 3.5f, 0);
+        fountain.spread               = 0.6f;
+        fountain.color                = glm::vec4(0.4f, 0.7f, 1.0f, 0.5f);
+        fountain.rate                 = 50000.0f;
+        fountain.lifetime             = 1.5f;
+        fountain.size                 = 0.02f;
+        renderer_.add_particle_emitter(fountain);
+
         renderer_.render();
     }
 }
@@ -0,0 +1,75 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace rune {
+
+FrameArena::FrameArena(size_t initial_capacity) {
+    current_ = allocate_block(initial_capacity, nullptr);
+}
+
+FrameArena::~FrameArena() {
+    while (current_) {
+        Block* prev = current_->prev;
+        std::free(current_);
+        current_ = prev;
+    }
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    auto aligned_offset = [&](const Block* block) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(block->data) + block->offset;
+        uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+        return block->offset + (aligned - address);
+    };
+
+    size_t offset = aligned_offset(current_);
+    if (offset + size > current_->capacity) {
+        // doesn't fit, start a new block that's at least as big as everything so far
+        current_ = allocate_block(std::max(capacity_, size + alignment), current_);
+        offset   = aligned_offset(current_);
+    }
+
+    bytes_used_ += offset + size - current_->offset;
+    current_->offset = offset + size;
+    return current_->data + offset;
+}
+
+void FrameArena::reset() {
+    if (current_->prev) {
+        // merge the blocks into one so the next frame fits without growing
+        size_t total_capacity = capacity_;
+        while (current_) {
+            Block* prev = current_->prev;
+            std::free(current_);
+            current_ = prev;
+        }
+
+        capacity_ = 0;
+        current_  = allocate_block(total_capacity, nullptr);
+    }
+
+    current_->offset = 0;
+    bytes_used_      = 0;
+}
+
+FrameArena::Block* FrameArena::allocate_block(size_t capacity, Block* prev) {
+    // the arena's own blocks come straight from malloc, they're its backing store and not per-frame allocations
+    auto* block = static_cast<Block*>(std::malloc(sizeof(Block) + capacity));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+
+    block->prev     = prev;
+    block->capacity = capacity;
+    block->offset   = 0;
+    block->data     = reinterpret_cast<std::byte*>(block + 1);
+
+    capacity_ += capacity;
+    return block;
+}
+
+} // namespace rune
@@ -0,0 +1,103 @@
+#ifndef RUNE_FRAME_ARENA_H
+#define RUNE_FRAME_ARENA_H
+
+#include "types.h"
+
+#include <cstddef>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace rune {
+
+/**
+ * A linear allocator for temporaries that only live until the end of a frame. Allocating is a pointer bump and
+ * freeing is a no-op, everything is released at once by reset.
+ * @note When a frame needs more than the arena holds, another block is added. On reset the blocks are merged into one,
+ * so after the first few frames a steady workload never needs to grow it again
+ */
+class FrameArena {
+  public:
+    explicit FrameArena(size_t initial_capacity = 1024 * 1024);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /**
+     * Allocate memory that's valid until the next reset
+     * @param size The size in bytes
+     * @param alignment The alignment in bytes, must be a power of two
+     * @return A pointer to the memory
+     */
+    void* allocate(size_t size, size_t alignment);
+
+    /**
+     * Release everything allocated since the last reset
+     */
+    void reset();
+
+    [[nodiscard]] size_t get_bytes_used() const {
+        return bytes_used_;
+    }
+
+    [[nodiscard]] size_t get_capacity() const {
+        return capacity_;
+    }
+
+  private:
+    struct Block {
+        Block*     prev;
+        size_t     capacity;
+        size_t     offset;
+        std::byte* data;
+    };
+
+    Block* allocate_block(size_t capacity, Block* prev);
+
+    Block* current_    = nullptr;
+    size_t bytes_used_ = 0;
+    size_t capacity_   = 0;
+};
+
+/**
+ * An STL compatible allocator that allocates from a FrameArena
+ * @tparam T The type to allocate
+ */
+template <typename T> class FrameAllocator {
+  public:
+    using value_type                             = T;
+    using propagate_on_container_move_assignment = std::true_type;
+
+    explicit FrameAllocator(FrameArena& arena) noexcept : arena_(&arena) {}
+
+    template <typename U> FrameAllocator(const FrameAllocator<U>& other) noexcept : arena_(other.arena_) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    template <typename U> bool operator==(const FrameAllocator<U>& rhs) const {
+        return arena_ == rhs.arena_;
+    }
+    template <typename U> bool operator!=(const FrameAllocator<U>& rhs) const {
+        return !(*this == rhs);
+    }
+
+  private:
+    template <typename U> friend class FrameAllocator;
+
+    FrameArena* arena_;
+};
+
+template <typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+template <typename K, typename V>
+using FrameUnorderedMap =
+    std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, FrameAllocator<std::pair<const K, V>>>;
+
+} // namespace rune
+
+#endif // RUNE_FRAME_ARENA_H
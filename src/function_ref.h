@@ -0,0 +1,39 @@
+#ifndef RUNE_FUNCTION_REF_H
+#define RUNE_FUNCTION_REF_H
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace rune {
+
+template <typename Signature> class FunctionRef;
+
+/**
+ * A non-owning reference to a callable, like std::function but it never allocates or copies the callable.
+ * Meant for callbacks that are only called during the call they're passed to, like RenderPass::run.
+ * @note The callable must outlive the FunctionRef, don't store one that was constructed from a temporary
+ */
+template <typename R, typename... Args> class FunctionRef<R(Args...)> {
+  public:
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same_v<std::remove_cvref_t<F>, FunctionRef> &&
+                                          std::is_invocable_r_v<R, F&, Args...>>>
+    FunctionRef(F&& func) // NOLINT: implicit so lambdas can be passed directly
+        : callable_(const_cast<void*>(static_cast<const void*>(std::addressof(func)))),
+          callback_([](void* callable, Args... args) -> R {
+              return (*static_cast<std::add_pointer_t<F>>(callable))(std::forward<Args>(args)...);
+          }) {}
+
+    R operator()(Args... args) const {
+        return callback_(callable_, std::forward<Args>(args)...);
+    }
+
+  private:
+    void* callable_;
+    R (*callback_)(void*, Args...);
+};
+
+} // namespace rune
+
+#endif // RUNE_FUNCTION_REF_H
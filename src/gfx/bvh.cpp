@@ -0,0 +1,406 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+namespace rune {
+
+u32 Bvh::insert(const Aabb& bounds, u32 user_data) {
+    u32 proxy = proxy_nodes_.size();
+    if (free_proxies_.empty()) {
+        proxy_nodes_.emplace_back();
+    } else {
+        proxy = free_proxies_.back();
+        free_proxies_.pop_back();
+    }
+
+    u32 leaf               = allocate_node();
+    nodes_[leaf].bounds    = bounds.expand(margin_);
+    nodes_[leaf].user_data = user_data;
+    nodes_[leaf].proxy     = proxy;
+    proxy_nodes_[proxy]    = leaf;
+
+    insert_leaf(leaf);
+    ++num_leaves_;
+    return proxy;
+}
+
+void Bvh::remove(u32 proxy) {
+    u32 leaf = proxy_nodes_[proxy];
+    remove_leaf(leaf);
+    free_node(leaf);
+    --num_leaves_;
+
+    proxy_nodes_[proxy] = NULL_NODE;
+    free_proxies_.push_back(proxy);
+}
+
+bool Bvh::move(u32 proxy, const Aabb& bounds) {
+    u32   leaf_index = proxy_nodes_[proxy];
+    Node& leaf       = nodes_[leaf_index];
+    if (leaf.bounds.contains(bounds)) {
+        return false;
+    }
+
+    // Refitting keeps the leaf next to its old siblings. That's fine for an object that moved a bit, but one that
+    // jumped somewhere else would stretch every ancestor across the gap, so find it a new place instead
+    bool has_jumped = !leaf.bounds.overlaps(bounds);
+    leaf.bounds     = bounds.expand(margin_);
+    if (has_jumped) {
+        remove_leaf(leaf_index);
+        insert_leaf(leaf_index);
+    } else {
+        refit_ancestors(leaf.parent);
+    }
+
+    return true;
+}
+
+void Bvh::clear() {
+    nodes_.clear();
+    proxy_nodes_.clear();
+    free_proxies_.clear();
+    root_       = NULL_NODE;
+    free_list_  = NULL_NODE;
+    num_leaves_ = 0;
+}
+
+void Bvh::optimize() {
+    if (root_ == NULL_NODE) {
+        return;
+    }
+
+    // Number the nodes in depth first order with each node's first child right after it, free nodes are dropped
+    std::vector<u32> new_indices(nodes_.size(), NULL_NODE);
+    std::vector<u32> stack     = {root_};
+    u32              num_nodes = 0;
+    while (!stack.empty()) {
+        u32 index = stack.back();
+        stack.pop_back();
+
+        new_indices[index] = num_nodes++;
+        if (!nodes_[index].is_leaf()) {
+            stack.push_back(nodes_[index].child2);
+            stack.push_back(nodes_[index].child1);
+        }
+    }
+
+    auto remap = [&](u32 index) { return index == NULL_NODE ? NULL_NODE : new_indices[index]; };
+
+    std::vector<Node> ordered(num_nodes);
+    for (u32 i = 0; i < nodes_.size(); ++i) {
+        if (new_indices[i] == NULL_NODE) {
+            continue;
+        }
+
+        Node& node  = ordered[new_indices[i]];
+        node        = nodes_[i];
+        node.parent = remap(node.parent);
+        node.child1 = remap(node.child1);
+        node.child2 = remap(node.child2);
+        if (node.is_leaf()) {
+            proxy_nodes_[node.proxy] = new_indices[i];
+        }
+    }
+
+    nodes_     = std::move(ordered);
+    root_      = 0;
+    free_list_ = NULL_NODE;
+}
+
+void Bvh::query_frustum(const Frustum& frustum, FunctionRef<void(u32)> func) const {
+    if (root_ == NULL_NODE) {
+        return;
+    }
+
+    // Each entry has a bit for every plane its subtree might still cross, planes that a box is entirely inside of don't
+    // need testing for anything below it. Once no bits are left the subtree is accepted without testing
+    constexpr u32 ALL_PLANES = (1u << Frustum::NUM_PLANES) - 1;
+
+    struct Entry {
+        u32 node;
+        u32 plane_mask;
+    };
+
+    Entry stack[MAX_QUERY_DEPTH];
+    u32   stack_size    = 0;
+    stack[stack_size++] = {root_, ALL_PLANES};
+
+    while (stack_size > 0) {
+        Entry       entry = stack[--stack_size];
+        const Node& node  = nodes_[entry.node];
+
+        // Test the box's corner furthest along each plane's normal, then the one furthest against it
+        bool is_outside = false;
+        for (u32 i = 0; i < Frustum::NUM_PLANES && !is_outside; ++i) {
+            if ((entry.plane_mask & (1u << i)) == 0) {
+                continue;
+            }
+
+            const glm::vec4& plane    = frustum.planes[i];
+            glm::vec3        normal   = glm::vec3(plane);
+            glm::bvec3       is_along = glm::greaterThanEqual(normal, glm::vec3(0));
+            glm::vec3        positive = glm::mix(node.bounds.min, node.bounds.max, is_along);
+            glm::vec3        negative = glm::mix(node.bounds.max, node.bounds.min, is_along);
+
+            is_outside = glm::dot(normal, positive) + plane.w < 0.0f;
+            if (glm::dot(normal, negative) + plane.w >= 0.0f) {
+                entry.plane_mask &= ~(1u << i);
+            }
+        }
+
+        if (is_outside) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            func(node.user_data);
+        } else {
+            stack[stack_size++] = {node.child1, entry.plane_mask};
+            stack[stack_size++] = {node.child2, entry.plane_mask};
+        }
+    }
+}
+
+void Bvh::query_box(const Aabb& bounds, FunctionRef<void(u32)> func) const {
+    if (root_ == NULL_NODE) {
+        return;
+    }
+
+    u32 stack[MAX_QUERY_DEPTH];
+    u32 stack_size      = 0;
+    stack[stack_size++] = root_;
+
+    while (stack_size > 0) {
+        const Node& node = nodes_[stack[--stack_size]];
+        if (!node.bounds.overlaps(bounds)) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            func(node.user_data);
+        } else {
+            stack[stack_size++] = node.child1;
+            stack[stack_size++] = node.child2;
+        }
+    }
+}
+
+void Bvh::query_ray(glm::vec3 origin, glm::vec3 direction, f32 max_t, FunctionRef<f32(u32, f32)> func) const {
+    if (root_ == NULL_NODE) {
+        return;
+    }
+
+    // Slab test, a zero direction component gives infinities that compare correctly unless the origin is on a slab
+    glm::vec3 inv_direction = 1.0f / direction;
+    auto      intersect     = [&](const Aabb& bounds) {
+        glm::vec3 t0    = (bounds.min - origin) * inv_direction;
+        glm::vec3 t1    = (bounds.max - origin) * inv_direction;
+        glm::vec3 t_min = glm::min(t0, t1);
+        glm::vec3 t_max = glm::max(t0, t1);
+        f32       enter = std::max(std::max(t_min.x, t_min.y), std::max(t_min.z, 0.0f));
+        f32       exit  = std::min(std::min(t_max.x, t_max.y), t_max.z);
+        return enter <= exit && enter <= max_t ? enter : -1.0f;
+    };
+
+    struct Entry {
+        u32 node;
+        f32 t; // where the ray enters the node's box
+    };
+
+    Entry stack[MAX_QUERY_DEPTH];
+    u32   stack_size = 0;
+    if (f32 t = intersect(nodes_[root_].bounds); t >= 0.0f) {
+        stack[stack_size++] = {root_, t};
+    }
+
+    while (stack_size > 0) {
+        Entry entry = stack[--stack_size];
+        if (entry.t > max_t) {
+            continue; // a closer hit was found since this was pushed
+        }
+
+        const Node& node = nodes_[entry.node];
+        if (node.is_leaf()) {
+            max_t = func(node.user_data, max_t);
+            if (max_t <= 0.0f) {
+                return;
+            }
+            continue;
+        }
+
+        // Push the further child first so the nearer one is visited first and can shorten the ray for the other
+        f32 t1 = intersect(nodes_[node.child1].bounds);
+        f32 t2 = intersect(nodes_[node.child2].bounds);
+        if (t1 >= 0.0f && t2 >= 0.0f) {
+            bool is_child1_nearer = t1 <= t2;
+            stack[stack_size++]   = is_child1_nearer ? Entry{node.child2, t2} : Entry{node.child1, t1};
+            stack[stack_size++]   = is_child1_nearer ? Entry{node.child1, t1} : Entry{node.child2, t2};
+        } else if (t1 >= 0.0f) {
+            stack[stack_size++] = {node.child1, t1};
+        } else if (t2 >= 0.0f) {
+            stack[stack_size++] = {node.child2, t2};
+        }
+    }
+}
+
+u32 Bvh::allocate_node() {
+    if (free_list_ == NULL_NODE) {
+        nodes_.emplace_back();
+        return nodes_.size() - 1;
+    }
+
+    u32 index     = free_list_;
+    free_list_    = nodes_[index].parent;
+    nodes_[index] = Node();
+    return index;
+}
+
+void Bvh::free_node(u32 index) {
+    nodes_[index].parent = free_list_;
+    nodes_[index].child1 = NULL_NODE;
+    nodes_[index].child2 = NULL_NODE;
+    free_list_           = index;
+}
+
+void Bvh::insert_leaf(u32 leaf) {
+    if (root_ == NULL_NODE) {
+        root_               = leaf;
+        nodes_[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Walk down to the best sibling for the leaf. Pairing the leaf with a node costs the area of their new parent,
+    // and every ancestor above it grows by however much the leaf makes it grow
+    Aabb leaf_bounds = nodes_[leaf].bounds;
+    u32  index       = root_;
+    while (!nodes_[index].is_leaf()) {
+        const Node& node          = nodes_[index];
+        f32         area          = node.bounds.get_surface_area();
+        f32         combined_area = node.bounds.merge(leaf_bounds).get_surface_area();
+
+        f32 pair_cost        = 2.0f * combined_area;
+        f32 inheritance_cost = 2.0f * (combined_area - area);
+
+        auto descend_cost = [&](u32 child_index) {
+            const Node& child  = nodes_[child_index];
+            f32         merged = child.bounds.merge(leaf_bounds).get_surface_area();
+            return child.is_leaf() ? merged + inheritance_cost
+                                   : merged - child.bounds.get_surface_area() + inheritance_cost;
+        };
+
+        f32 cost1 = descend_cost(node.child1);
+        f32 cost2 = descend_cost(node.child2);
+        if (pair_cost < cost1 && pair_cost < cost2) {
+            break;
+        }
+
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    u32 sibling    = index;
+    u32 old_parent = nodes_[sibling].parent;
+    u32 new_parent = allocate_node();
+
+    Node& parent  = nodes_[new_parent];
+    parent.parent = old_parent;
+    parent.bounds = nodes_[sibling].bounds.merge(leaf_bounds);
+    parent.height = nodes_[sibling].height + 1;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+
+    replace_child(old_parent, sibling, new_parent);
+    nodes_[sibling].parent = new_parent;
+    nodes_[leaf].parent    = new_parent;
+
+    refit_ancestors(old_parent);
+}
+
+void Bvh::remove_leaf(u32 leaf) {
+    if (leaf == root_) {
+        root_ = NULL_NODE;
+        return;
+    }
+
+    u32 parent       = nodes_[leaf].parent;
+    u32 grand_parent = nodes_[parent].parent;
+    u32 sibling      = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+    // The sibling takes the parent's place
+    replace_child(grand_parent, parent, sibling);
+    nodes_[sibling].parent = grand_parent;
+    free_node(parent);
+
+    refit_ancestors(grand_parent);
+}
+
+void Bvh::refit_ancestors(u32 index) {
+    while (index != NULL_NODE) {
+        index = balance(index);
+
+        Node&       node   = nodes_[index];
+        const Node& child1 = nodes_[node.child1];
+        const Node& child2 = nodes_[node.child2];
+        node.bounds        = child1.bounds.merge(child2.bounds);
+        node.height        = 1 + std::max(child1.height, child2.height);
+
+        index = node.parent;
+    }
+}
+
+u32 Bvh::balance(u32 index_a) {
+    Node& a = nodes_[index_a];
+    if (a.is_leaf()) {
+        return index_a;
+    }
+
+    u32 index_b = a.child1;
+    u32 index_c = a.child2;
+    i32 diff    = (i32)nodes_[index_c].height - (i32)nodes_[index_b].height;
+    if (diff >= -1 && diff <= 1) {
+        return index_a;
+    }
+
+    // Swap A with its taller child X. X keeps its taller child, and A keeps its other child and takes X's shorter one
+    bool  is_c_taller   = diff > 1;
+    u32   index_x       = is_c_taller ? index_c : index_b;
+    u32   index_other   = is_c_taller ? index_b : index_c;
+    Node& x             = nodes_[index_x];
+    u32   index_taller  = nodes_[x.child1].height > nodes_[x.child2].height ? x.child1 : x.child2;
+    u32   index_shorter = index_taller == x.child1 ? x.child2 : x.child1;
+
+    x.parent = a.parent;
+    replace_child(a.parent, index_a, index_x);
+    a.parent = index_x;
+
+    x.child1 = index_a;
+    x.child2 = index_taller;
+
+    if (is_c_taller) {
+        a.child2 = index_shorter;
+    } else {
+        a.child1 = index_shorter;
+    }
+    nodes_[index_shorter].parent = index_a;
+
+    const Node& other   = nodes_[index_other];
+    const Node& shorter = nodes_[index_shorter];
+    const Node& taller  = nodes_[index_taller];
+    a.bounds            = other.bounds.merge(shorter.bounds);
+    a.height            = 1 + std::max(other.height, shorter.height);
+    x.bounds            = a.bounds.merge(taller.bounds);
+    x.height            = 1 + std::max(a.height, taller.height);
+
+    return index_x;
+}
+
+void Bvh::replace_child(u32 parent, u32 old_child, u32 new_child) {
+    if (parent == NULL_NODE) {
+        root_ = new_child;
+    } else if (nodes_[parent].child1 == old_child) {
+        nodes_[parent].child1 = new_child;
+    } else {
+        nodes_[parent].child2 = new_child;
+    }
+}
+
+} // namespace rune
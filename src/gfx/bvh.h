@@ -0,0 +1,194 @@
+#ifndef RUNE_BVH_H
+#define RUNE_BVH_H
+
+#include "function_ref.h"
+#include "gfx/frustum.h"
+#include "types.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace rune {
+
+/**
+ * An axis aligned bounding box
+ */
+struct Aabb {
+    glm::vec3 min = glm::vec3(0);
+    glm::vec3 max = glm::vec3(0);
+
+    static Aabb from_sphere(glm::vec3 center, f32 radius) {
+        return Aabb{center - glm::vec3(radius), center + glm::vec3(radius)};
+    }
+
+    [[nodiscard]] Aabb merge(const Aabb& other) const {
+        return Aabb{glm::min(min, other.min), glm::max(max, other.max)};
+    }
+
+    [[nodiscard]] Aabb expand(f32 margin) const {
+        return Aabb{min - glm::vec3(margin), max + glm::vec3(margin)};
+    }
+
+    [[nodiscard]] bool contains(const Aabb& other) const {
+        return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+    }
+
+    [[nodiscard]] bool overlaps(const Aabb& other) const {
+        return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+    }
+
+    [[nodiscard]] f32 get_surface_area() const {
+        glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+/**
+ * A dynamic bounding volume hierarchy over boxes, for culling and scene queries that don't touch every object.
+ * Leaves are placed by a surface area heuristic on insert and the tree is kept balanced with rotations, see Catto's
+ * "Dynamic Bounding Volume Hierarchies" (GDC 2019).
+ * Leaves store their box enlarged by a margin, so objects that move a little don't change the tree at all
+ */
+class Bvh {
+  public:
+    static constexpr u32 NULL_NODE = ~0u;
+
+    /**
+     * @param margin How far each leaf's box is enlarged, in world units
+     */
+    explicit Bvh(f32 margin = 0.1f) : margin_(margin) {}
+
+    /**
+     * Add a box to the tree
+     * @param bounds The box
+     * @param user_data Passed to query callbacks when the box is hit
+     * @return A proxy for the box, valid until it's removed
+     */
+    u32 insert(const Aabb& bounds, u32 user_data);
+
+    /**
+     * Remove a box from the tree
+     * @param proxy The proxy returned by insert
+     */
+    void remove(u32 proxy);
+
+    /**
+     * Update the box of a moving object. Small moves stay inside the enlarged box and cost nothing, larger ones refit
+     * the box's ancestors and objects that jumped away from where they were are reinserted
+     * @param proxy The proxy returned by insert
+     * @param bounds The new box
+     * @return Whether the tree changed
+     */
+    bool move(u32 proxy, const Aabb& bounds);
+
+    /**
+     * Remove everything
+     */
+    void clear();
+
+    /**
+     * Reorder the nodes depth first so every subtree is contiguous in memory and queries read it mostly in order.
+     * Nodes added later go at the end, so this is worth calling again after many inserts, like after loading a level.
+     * Proxies stay valid
+     */
+    void optimize();
+
+    /**
+     * Call a function for every box that intersects a frustum. Subtrees that are entirely inside are accepted without
+     * testing their boxes, subtrees that are entirely outside are rejected without visiting them
+     * @param frustum The frustum
+     * @param func Called with the user data of each box
+     */
+    void query_frustum(const Frustum& frustum, FunctionRef<void(u32)> func) const;
+
+    /**
+     * Call a function for every box that overlaps a box
+     * @param bounds The box to test against
+     * @param func Called with the user data of each box
+     */
+    void query_box(const Aabb& bounds, FunctionRef<void(u32)> func) const;
+
+    /**
+     * Call a function for every box that a ray segment hits, nearest subtrees first. The callback does the exact test
+     * against its object and returns how far along the ray to keep looking, so a closest hit query returns the hit's
+     * distance and an any hit query returns 0
+     * @param origin The start of the ray
+     * @param direction The direction of the ray, doesn't need to be normalized
+     * @param max_t How far along the ray to look, in multiples of direction
+     * @param func Called with the user data of each box and the current max_t, returns the new max_t
+     */
+    void query_ray(glm::vec3 origin, glm::vec3 direction, f32 max_t, FunctionRef<f32(u32, f32)> func) const;
+
+    [[nodiscard]] const Aabb& get_fat_bounds(u32 proxy) const {
+        return nodes_[proxy_nodes_[proxy]].bounds;
+    }
+
+    [[nodiscard]] u32 get_user_data(u32 proxy) const {
+        return nodes_[proxy_nodes_[proxy]].user_data;
+    }
+
+    [[nodiscard]] u32 get_height() const {
+        return root_ == NULL_NODE ? 0 : nodes_[root_].height;
+    }
+
+    [[nodiscard]] u32 get_num_leaves() const {
+        return num_leaves_;
+    }
+
+  private:
+    // Queries walk the tree with a stack on the call stack so they never allocate. Balancing keeps the height under
+    // 1.44 log2 of the number of leaves, so this covers any tree that fits in memory
+    static constexpr u32 MAX_QUERY_DEPTH = 128;
+
+    struct Node {
+        Aabb bounds;
+        u32  parent    = NULL_NODE; // next free node when the node is free
+        u32  child1    = NULL_NODE;
+        u32  child2    = NULL_NODE;
+        u32  height    = 0; // 0 for leaves
+        u32  user_data = 0;
+        u32  proxy     = NULL_NODE; // the proxy of a leaf, so it can be found again when the node moves
+
+        [[nodiscard]] bool is_leaf() const {
+            return child1 == NULL_NODE;
+        }
+    };
+
+    u32  allocate_node();
+    void free_node(u32 index);
+
+    void insert_leaf(u32 leaf);
+    void remove_leaf(u32 leaf);
+
+    /**
+     * Recompute the bounds and heights from a node up to the root, rebalancing along the way
+     * @param index The first node to fix
+     */
+    void refit_ancestors(u32 index);
+
+    /**
+     * Rotate a node's taller grandchild up if its children's heights differ by more than one
+     * @param index The node
+     * @return The node that's now where the node was
+     */
+    u32 balance(u32 index);
+
+    /**
+     * Replace a child of a node's parent, or the root if the node has no parent
+     */
+    void replace_child(u32 parent, u32 old_child, u32 new_child);
+
+    std::vector<Node> nodes_;
+    u32               root_       = NULL_NODE;
+    u32               free_list_  = NULL_NODE;
+    u32               num_leaves_ = 0;
+    f32               margin_;
+
+    // proxies map to leaves indirectly so optimize can move nodes
+    std::vector<u32> proxy_nodes_;
+    std::vector<u32> free_proxies_;
+};
+
+} // namespace rune
+
+#endif // RUNE_BVH_H
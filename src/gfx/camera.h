@@ -2,6 +2,7 @@
 #define RUNE_CAMERA_H
 
 #include "constants.h"
+#include "gfx/frustum.h"
 #include "types.h"
 
 #include <glm/glm.hpp>
@@ -20,6 +21,22 @@ class Camera {
         return position_;
     }
 
+    [[nodiscard]] f32 get_fov_radians() const {
+        return fov_radians_;
+    }
+
+    [[nodiscard]] f32 get_aspect_ratio() const {
+        return aspect_ratio_;
+    }
+
+    [[nodiscard]] f32 get_near() const {
+        return near_;
+    }
+
+    [[nodiscard]] f32 get_far() const {
+        return far_;
+    }
+
     [[nodiscard]] glm::mat4 get_view_matrix() const {
         return glm::lookAt(position_, look_position_, consts::UP);
     }
@@ -32,6 +49,10 @@ class Camera {
         return get_projection_matrix() * get_view_matrix();
     }
 
+    [[nodiscard]] Frustum get_frustum() const {
+        return Frustum(get_view_projection_matrix());
+    }
+
     [[nodiscard]] glm::vec3 get_forward() const {
         return glm::normalize(look_position_ - position_);
     }
@@ -0,0 +1,36 @@
+#include "clustered_lighting.h"
+
+namespace rune::gfx {
+
+ClusteredLighting::ClusteredLighting(Core& core, GraphicsBackend& gfx, VkRect2D render_area)
+    : gfx_(gfx), render_area_(render_area), pass_(core, gfx, {"../data/shaders/light_clustering.comp.spv"}) {}
+
+void ClusteredLighting::assign_lights(VkCommandBuffer cmd, const Camera& camera) {
+    pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_lights", gfx_.get_light_data_buffer());
+        writes.set_buffer("u_light_clusters", gfx_.get_light_cluster_buffer());
+        pass_.set_descriptors(cmd, writes);
+
+        glm::mat4 projection = camera.get_projection_matrix();
+
+        ClusterData cluster_data = {};
+        cluster_data.view        = camera.get_view_matrix();
+        cluster_data.projection  = {1.0f / projection[0][0],
+                                    1.0f / projection[1][1],
+                                    projection[2][2],
+                                    projection[3][2]};
+        cluster_data.viewport    = {(f32)render_area_.offset.x,
+                                    (f32)render_area_.offset.y,
+                                    (f32)render_area_.extent.width,
+                                    (f32)render_area_.extent.height};
+        cluster_data.depth       = {camera.get_near(), camera.get_far(), 0.0f, 0.0f};
+        cluster_data.info        = {gfx_.get_num_lights(), 0, 0, 0};
+        pass_.set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, cluster_data);
+
+        // a workgroup per cluster
+        vkCmdDispatch(cmd, LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z);
+    });
+}
+
+} // namespace rune::gfx
@@ -0,0 +1,54 @@
+#ifndef RUNE_CLUSTERED_LIGHTING_H
+#define RUNE_CLUSTERED_LIGHTING_H
+
+#include "gfx/camera.h"
+#include "gfx/compute_pass.h"
+#include "gfx/graphics_backend.h"
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+/**
+ * Bins the frame's point lights into clusters of the view frustum for forward shading, see
+ * GraphicsBackend::get_light_cluster_buffer. Unlike TiledLighting it doesn't need depth, so geometry can be lit as it's
+ * drawn, which keeps msaa and blending possible. Each pixel only evaluates the lights of its cluster however many
+ * lights the scene has
+ */
+class ClusteredLighting {
+  public:
+    /**
+     * @param render_area The area the grid covers, the one the lit geometry is drawn to
+     */
+    explicit ClusteredLighting(Core& core, GraphicsBackend& gfx, VkRect2D render_area);
+
+    /**
+     * Record binning this frame's lights into GraphicsBackend::get_light_cluster_buffer(), the grid is fitted to the
+     * camera's field of view and near and far planes
+     * @note Must be recorded outside of a graphics pass. The passes that read the clusters have to wait for it
+     * @param cmd The command buffer to record to
+     * @param camera The camera the lit geometry is drawn with
+     */
+    void assign_lights(VkCommandBuffer cmd, const Camera& camera);
+
+  private:
+    // matches the push constants of light_clustering.comp
+    struct ClusterData {
+        glm::mat4  view;
+        glm::vec4  projection; // 1 / p[0][0], 1 / p[1][1], p[2][2] and p[3][2]
+        glm::vec4  viewport;   // offset in xy and extent in zw
+        glm::vec4  depth;      // the near and far planes
+        glm::uvec4 info;       // the number of lights
+    };
+
+    GraphicsBackend& gfx_;
+    VkRect2D         render_area_;
+
+    ComputePass pass_;
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_CLUSTERED_LIGHTING_H
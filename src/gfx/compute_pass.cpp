@@ -0,0 +1,23 @@
+#include "compute_pass.h"
+
+#include "core.h"
+#include "gfx/graphics_backend.h"
+
+namespace rune::gfx {
+
+ComputePass::ComputePass(Core& core, GraphicsBackend& gfx, const ComputePassDesc& desc)
+    : RenderPass(core, gfx, desc.get_shaders()), desc_(desc) {
+    pipeline_ = gfx_.create_compute_pipeline(desc_.get_shaders().front(), pipeline_layout_);
+}
+
+void ComputePass::run(VkCommandBuffer cmd, FunctionRef<void(VkCommandBuffer)> func) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+
+    func(cmd);
+}
+
+void ComputePass::set_descriptors(VkCommandBuffer cmd, const DescriptorWrites& writes) {
+    write_descriptors(cmd, writes, VK_PIPELINE_BIND_POINT_COMPUTE);
+}
+
+} // namespace rune::gfx
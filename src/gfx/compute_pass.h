@@ -0,0 +1,68 @@
+#ifndef RUNE_COMPUTE_PASS_H
+#define RUNE_COMPUTE_PASS_H
+
+#include "gfx/render_pass.h"
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+class GraphicsBackend;
+
+struct ComputePassDesc {
+    // temp shader path
+
+    const char* comp_shader_path = nullptr;
+
+    [[nodiscard]] std::vector<ShaderInfo> get_shaders() const {
+        return {{VK_SHADER_STAGE_COMPUTE_BIT, comp_shader_path}};
+    }
+};
+
+class ComputePass : public RenderPass {
+  public:
+    explicit ComputePass(Core& core, GraphicsBackend& gfx, const ComputePassDesc& desc);
+
+    /**
+     * Bind the compute pipeline and run func, which should set descriptors and dispatch
+     * @note Must be recorded outside of a graphics pass
+     * @param cmd The command buffer to be used
+     * @param func The function to run
+     */
+    void run(VkCommandBuffer cmd, FunctionRef<void(VkCommandBuffer)> func) override;
+
+    void set_descriptors(VkCommandBuffer cmd, const DescriptorWrites& writes) override;
+
+    /**
+     * Dispatch enough workgroups to cover a number of invocations
+     * @param cmd The command buffer to record to
+     * @param num_invocations The number of invocations needed along x
+     * @param workgroup_size The local_size_x of the shader
+     */
+    static void dispatch(VkCommandBuffer cmd, u32 num_invocations, u32 workgroup_size) {
+        vkCmdDispatch(cmd, (num_invocations + workgroup_size - 1) / workgroup_size, 1, 1);
+    }
+
+    /**
+     * Dispatch enough workgroups to cover a 2d grid of invocations
+     * @param cmd The command buffer to record to
+     * @param num_invocations The number of invocations needed along x and y
+     * @param workgroup_size The local_size_x and local_size_y of the shader
+     */
+    static void dispatch(VkCommandBuffer cmd, VkExtent2D num_invocations, VkExtent2D workgroup_size) {
+        vkCmdDispatch(cmd,
+                      (num_invocations.width + workgroup_size.width - 1) / workgroup_size.width,
+                      (num_invocations.height + workgroup_size.height - 1) / workgroup_size.height,
+                      1);
+    }
+
+  private:
+    ComputePassDesc desc_;
+    VkPipeline      pipeline_;
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_COMPUTE_PASS_H
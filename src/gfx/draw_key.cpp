@@ -0,0 +1,108 @@
+#include "draw_key.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace rune::gfx {
+
+u64 DrawKey::make(u32 pipeline, u32 material, u32 mesh_index, f32 depth) {
+    constexpr u64 max_depth = (1ull << DEPTH_BITS) - 1;
+
+    // also catches nan, which compares false
+    u64 quantized_depth = depth > 0.0f ? (u64)(std::min(depth, 1.0f) * (f32)max_depth) : 0;
+
+    u64 key = pipeline & ((1ull << PIPELINE_BITS) - 1);
+    key     = (key << MATERIAL_BITS) | (material & ((1ull << MATERIAL_BITS) - 1));
+    key     = (key << MESH_BITS) | (mesh_index & ((1ull << MESH_BITS) - 1));
+    key     = (key << DEPTH_BITS) | quantized_depth;
+    return key;
+}
+
+namespace {
+
+constexpr u32 MAX_RADIX_BITS      = 9;
+constexpr u32 INSERTION_SORT_SIZE = 32;
+
+void insertion_sort(std::span<SortItem> items) {
+    for (u32 i = 1; i < items.size(); ++i) {
+        SortItem item = items[i];
+        u32      j    = i;
+        for (; j > 0 && items[j - 1].key > item.key; --j) {
+            items[j] = items[j - 1];
+        }
+        items[j] = item;
+    }
+}
+
+/**
+ * Sort by the highest varying digit, then sort each bucket on its own by the bits below it. Every pass moves the items
+ * to the other buffer. Buckets of up to INSERTION_SORT_SIZE items are left for one insertion sort at the end
+ * @param items Where the items end up
+ * @param temp Scratch space, the same size as items
+ * @param varying_bits The bits that differ between the items and haven't been sorted by yet
+ * @param in_temp If the items are in temp rather than in items
+ */
+void radix_sort_digit(std::span<SortItem> items, std::span<SortItem> temp, u64 varying_bits, bool in_temp) {
+    std::span<SortItem> src = in_temp ? temp : items;
+    std::span<SortItem> dst = in_temp ? items : temp;
+
+    if (varying_bits == 0 || items.size() <= INSERTION_SORT_SIZE) {
+        if (in_temp) {
+            std::copy(temp.begin(), temp.end(), items.begin());
+        }
+        return;
+    }
+
+    // a digit about as wide as the buckets need, so the buckets below it are small enough to stay in cache
+    u32 top_bit  = std::bit_width(varying_bits);
+    u32 bits     = std::min({top_bit, MAX_RADIX_BITS, (u32)std::bit_width(items.size())});
+    u32 shift    = top_bit - bits;
+    u64 mask     = (1ull << bits) - 1;
+    u32 num_bins = 1u << bits;
+
+    std::array<u32, (1 << MAX_RADIX_BITS) + 1> bin_starts = {};
+    for (const SortItem& item : src) {
+        ++bin_starts[((item.key >> shift) & mask) + 1];
+    }
+
+    for (u32 bin = 0; bin < num_bins; ++bin) {
+        bin_starts[bin + 1] += bin_starts[bin];
+    }
+
+    std::array<u32, 1 << MAX_RADIX_BITS> offsets;
+    std::copy(bin_starts.begin(), bin_starts.begin() + num_bins, offsets.begin());
+    for (const SortItem& item : src) {
+        dst[offsets[(item.key >> shift) & mask]++] = item;
+    }
+
+    u64 lower_bits = varying_bits & ((1ull << shift) - 1);
+    for (u32 bin = 0; bin < num_bins; ++bin) {
+        u32 first = bin_starts[bin];
+        u32 count = bin_starts[bin + 1] - first;
+        if (count > INSERTION_SORT_SIZE) {
+            radix_sort_digit(items.subspan(first, count), temp.subspan(first, count), lower_bits, !in_temp);
+        } else if (!in_temp) {
+            std::copy(temp.begin() + first, temp.begin() + first + count, items.begin() + first);
+        }
+    }
+}
+
+} // namespace
+
+void radix_sort(std::span<SortItem> items, std::span<SortItem> temp) {
+    // bits that every key shares are already in order, a bit that's set in some keys but not others needs sorting by
+    u64 all_set = ~0ull;
+    u64 any_set = 0;
+    for (const SortItem& item : items) {
+        all_set &= item.key;
+        any_set |= item.key;
+    }
+
+    radix_sort_digit(items, temp, all_set ^ any_set, false);
+
+    // items only have to move within their small bucket, so this is close to a single pass
+    insertion_sort(items);
+}
+
+} // namespace rune::gfx
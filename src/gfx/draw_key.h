@@ -0,0 +1,61 @@
+#ifndef RUNE_DRAW_KEY_H
+#define RUNE_DRAW_KEY_H
+
+#include "types.h"
+
+#include <span>
+
+namespace rune::gfx {
+
+/**
+ * A 64 bit key that orders draws. Sorting by it groups draws by pipeline, then material, then mesh so state changes
+ * between them are as rare as possible, and orders the instances of each mesh front to back so early depth testing
+ * rejects more of what they cover.
+ * From the most significant bits: pipeline, material, mesh index, quantized depth
+ */
+struct DrawKey {
+    static constexpr u32 PIPELINE_BITS = 8;
+    static constexpr u32 MATERIAL_BITS = 16;
+    static constexpr u32 MESH_BITS     = 16;
+    static constexpr u32 DEPTH_BITS    = 24;
+
+    static_assert(PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64);
+
+    /**
+     * @param pipeline The pipeline, less than 2^PIPELINE_BITS
+     * @param material The material, less than 2^MATERIAL_BITS
+     * @param mesh_index The mesh's index in the mesh table, less than 2^MESH_BITS
+     * @param depth How far the draw is from the camera, 0 at the camera and 1 at the far plane. Clamped
+     * @return The key
+     */
+    static u64 make(u32 pipeline, u32 material, u32 mesh_index, f32 depth);
+
+    /**
+     * Get the part of a key that draws in the same batch share, everything but the depth
+     */
+    static constexpr u64 get_state(u64 key) {
+        return key >> DEPTH_BITS;
+    }
+};
+
+/**
+ * A key to sort by and the value that moves with it
+ */
+struct SortItem {
+    u64 key;
+    u32 value;
+};
+
+/**
+ * Sort items by key with a most significant digit radix sort. The first pass splits the items by the highest bits that
+ * differ between them, then each bucket is sorted on its own, so the depth of draw keys is only sorted within a run of
+ * draws that share state and bits that every key shares don't cost anything. Small buckets are insertion sorted. The
+ * sort is stable
+ * @param items The items, sorted in place
+ * @param temp Scratch space, the same size as items
+ */
+void radix_sort(std::span<SortItem> items, std::span<SortItem> temp);
+
+} // namespace rune::gfx
+
+#endif // RUNE_DRAW_KEY_H
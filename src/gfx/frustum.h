@@ -0,0 +1,86 @@
+#ifndef RUNE_FRUSTUM_H
+#define RUNE_FRUSTUM_H
+
+#include "types.h"
+
+#include <glm/glm.hpp>
+
+namespace rune {
+
+/**
+ * A view frustum as six inward facing planes, stored as (normal, distance) so that a point p is inside a plane when
+ * dot(normal, p) + distance >= 0
+ */
+struct Frustum {
+    enum Plane
+    {
+        LEFT,
+        RIGHT,
+        BOTTOM,
+        TOP,
+        NEAR_PLANE,
+        FAR_PLANE,
+        NUM_PLANES
+    };
+
+    Frustum() = default;
+
+    /**
+     * Extract the planes from a view projection matrix, see Gribb and Hartmann's "Fast Extraction of Viewing Frustum
+     * Planes from the World-View-Projection Matrix"
+     * @param view_projection A view projection matrix with a [-1, 1] clip space depth range
+     */
+    explicit Frustum(const glm::mat4& view_projection) {
+        // glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::mat4 rows = glm::transpose(view_projection);
+
+        planes[LEFT]       = rows[3] + rows[0];
+        planes[RIGHT]      = rows[3] - rows[0];
+        planes[BOTTOM]     = rows[3] + rows[1];
+        planes[TOP]        = rows[3] - rows[1];
+        planes[NEAR_PLANE] = rows[3] + rows[2];
+        planes[FAR_PLANE]  = rows[3] - rows[2];
+
+        for (glm::vec4& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    /**
+     * Test a bounding sphere against the frustum, conservatively: spheres near a corner can pass while being outside
+     * @param center The center of the sphere
+     * @param radius The radius of the sphere
+     * @return Whether the sphere might be visible
+     */
+    [[nodiscard]] bool intersects_sphere(glm::vec3 center, f32 radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    glm::vec4 planes[NUM_PLANES] = {};
+};
+
+/**
+ * Move a model space bounding sphere to world space. The largest axis scale keeps the sphere around the mesh under
+ * non-uniform scaling
+ * @param sphere The center and radius
+ * @param model_matrix The model matrix
+ * @return The world space center and radius
+ */
+inline glm::vec4 transform_bounding_sphere(const glm::vec4& sphere, const glm::mat4& model_matrix) {
+    const glm::mat4& m      = model_matrix;
+    glm::vec3        center = m * glm::vec4(glm::vec3(sphere), 1.0f);
+    f32              scale  = glm::max(glm::length(glm::vec3(m[0])),
+                                       glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+
+    return glm::vec4(center, sphere.w * scale);
+}
+
+} // namespace rune
+
+#endif // RUNE_FRUSTUM_H
@@ -0,0 +1,149 @@
+#include "frustum_culling.h"
+
+#include <bit>
+
+#ifdef RUNE_HAS_CULL_SSE
+#include <immintrin.h>
+#endif
+
+// gcc and clang only allow avx2 intrinsics in functions built for it, the rest of the build stays at the baseline and
+// cull_spheres checks the cpu before calling them. msvc allows them anywhere but only gets here when built with /arch
+#if defined(__GNUC__)
+#define RUNE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RUNE_TARGET_AVX2
+#endif
+
+namespace rune {
+
+u32 cull_spheres(const Frustum& frustum, const BoundingSpheres& spheres, u32* visible_indices) {
+#ifdef RUNE_HAS_CULL_AVX2
+    static const bool has_avx2 = detail::cpu_supports_avx2();
+    if (has_avx2) {
+        return detail::cull_spheres_avx2(frustum, spheres, visible_indices);
+    }
+#endif
+
+#ifdef RUNE_HAS_CULL_SSE
+    return detail::cull_spheres_sse(frustum, spheres, visible_indices);
+#else
+    return detail::cull_spheres_scalar(frustum, spheres, visible_indices);
+#endif
+}
+
+namespace detail {
+
+namespace {
+
+/**
+ * Test spheres one at a time, used by the SIMD versions for what's left over after their last full register
+ */
+u32 cull_spheres_range(const Frustum&        frustum,
+                       const BoundingSpheres& spheres,
+                       u32                    first,
+                       u32*                   visible_indices) {
+    u32 num_visible = 0;
+    for (u32 i = first; i < spheres.count; ++i) {
+        bool is_visible = true;
+        for (const glm::vec4& plane : frustum.planes) {
+            f32 distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+            is_visible &= distance >= -spheres.radius[i];
+        }
+
+        visible_indices[num_visible] = i;
+        num_visible += is_visible ? 1 : 0;
+    }
+
+    return num_visible;
+}
+
+} // namespace
+
+u32 cull_spheres_scalar(const Frustum& frustum, const BoundingSpheres& spheres, u32* visible_indices) {
+    return cull_spheres_range(frustum, spheres, 0, visible_indices);
+}
+
+#ifdef RUNE_HAS_CULL_SSE
+u32 cull_spheres_sse(const Frustum& frustum, const BoundingSpheres& spheres, u32* visible_indices) {
+    constexpr u32 WIDTH = 4;
+
+    __m128 planes[Frustum::NUM_PLANES][4];
+    for (u32 p = 0; p < Frustum::NUM_PLANES; ++p) {
+        for (u32 c = 0; c < 4; ++c) {
+            planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+        }
+    }
+
+    u32 num_visible = 0;
+    u32 i           = 0;
+    for (; i + WIDTH <= spheres.count; i += WIDTH) {
+        __m128 x          = _mm_loadu_ps(spheres.x + i);
+        __m128 y          = _mm_loadu_ps(spheres.y + i);
+        __m128 z          = _mm_loadu_ps(spheres.z + i);
+        __m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius + i));
+
+        __m128 is_visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const __m128* plane : planes) {
+            // same order of operations as the scalar test so they agree on spheres that touch a plane
+            __m128 distance = _mm_add_ps(_mm_mul_ps(plane[0], x), _mm_mul_ps(plane[1], y));
+            distance        = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(plane[2], z)), plane[3]);
+            is_visible      = _mm_and_ps(is_visible, _mm_cmpge_ps(distance, neg_radius));
+        }
+
+        for (u32 mask = _mm_movemask_ps(is_visible); mask != 0; mask &= mask - 1) {
+            visible_indices[num_visible++] = i + std::countr_zero(mask);
+        }
+    }
+
+    return num_visible + cull_spheres_range(frustum, spheres, i, visible_indices + num_visible);
+}
+#endif
+
+#ifdef RUNE_HAS_CULL_AVX2
+RUNE_TARGET_AVX2 u32 cull_spheres_avx2(const Frustum&         frustum,
+                                       const BoundingSpheres& spheres,
+                                       u32*                   visible_indices) {
+    constexpr u32 WIDTH = 8;
+
+    __m256 planes[Frustum::NUM_PLANES][4];
+    for (u32 p = 0; p < Frustum::NUM_PLANES; ++p) {
+        for (u32 c = 0; c < 4; ++c) {
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+        }
+    }
+
+    u32 num_visible = 0;
+    u32 i           = 0;
+    for (; i + WIDTH <= spheres.count; i += WIDTH) {
+        __m256 x          = _mm256_loadu_ps(spheres.x + i);
+        __m256 y          = _mm256_loadu_ps(spheres.y + i);
+        __m256 z          = _mm256_loadu_ps(spheres.z + i);
+        __m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius + i));
+
+        __m256 is_visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const __m256* plane : planes) {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(plane[0], x), _mm256_mul_ps(plane[1], y));
+            distance        = _mm256_add_ps(_mm256_add_ps(distance, _mm256_mul_ps(plane[2], z)), plane[3]);
+            is_visible      = _mm256_and_ps(is_visible, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+        }
+
+        for (u32 mask = _mm256_movemask_ps(is_visible); mask != 0; mask &= mask - 1) {
+            visible_indices[num_visible++] = i + std::countr_zero(mask);
+        }
+    }
+
+    return num_visible + cull_spheres_range(frustum, spheres, i, visible_indices + num_visible);
+}
+
+bool cpu_supports_avx2() {
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return true; // built with /arch:AVX2
+#endif
+}
+#endif
+
+} // namespace detail
+
+} // namespace rune
@@ -0,0 +1,52 @@
+#ifndef RUNE_FRUSTUM_CULLING_H
+#define RUNE_FRUSTUM_CULLING_H
+
+#include "gfx/frustum.h"
+#include "types.h"
+
+namespace rune {
+
+/**
+ * Bounding spheres laid out as one array per component, so a plane can be tested against several spheres with one
+ * instruction. Doesn't own the arrays
+ */
+struct BoundingSpheres {
+    const f32* x      = nullptr;
+    const f32* y      = nullptr;
+    const f32* z      = nullptr;
+    const f32* radius = nullptr;
+    u32        count  = 0;
+};
+
+/**
+ * Find the bounding spheres that intersect a frustum, with the widest SIMD the cpu supports. Uses the same test as
+ * Frustum::intersects_sphere
+ * @param frustum The frustum
+ * @param spheres The spheres, in the same space as the frustum
+ * @param visible_indices Filled with the indices of the visible spheres in increasing order, needs room for all of them
+ * @return The number of visible spheres
+ */
+u32 cull_spheres(const Frustum& frustum, const BoundingSpheres& spheres, u32* visible_indices);
+
+namespace detail {
+
+// The implementations cull_spheres picks from, exposed for benchmarking. Only call the SIMD ones if they're supported
+
+u32 cull_spheres_scalar(const Frustum& frustum, const BoundingSpheres& spheres, u32* visible_indices);
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RUNE_HAS_CULL_SSE
+u32 cull_spheres_sse(const Frustum& frustum, const BoundingSpheres& spheres, u32* visible_indices);
+#endif
+
+#if defined(RUNE_HAS_CULL_SSE) && (defined(__GNUC__) || defined(__AVX2__))
+#define RUNE_HAS_CULL_AVX2
+u32  cull_spheres_avx2(const Frustum& frustum, const BoundingSpheres& spheres, u32* visible_indices);
+bool cpu_supports_avx2();
+#endif
+
+} // namespace detail
+
+} // namespace rune
+
+#endif // RUNE_FRUSTUM_CULLING_H
@@ -0,0 +1,219 @@
+#include "gpu_culling.h"
+
+#include "core.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace rune::gfx {
+
+GpuCulling::GpuCulling(Core& core, GraphicsBackend& gfx)
+    : core_(core), gfx_(gfx), cull_instances_pass_(core, gfx, {"../data/shaders/cull_instances.comp.spv"}),
+      compact_draws_pass_(core, gfx, {"../data/shaders/compact_draws.comp.spv"}),
+      depth_pyramid_pass_(core, gfx, {"../data/shaders/depth_pyramid.comp.spv"}) {
+    VkExtent2D depth_extent   = gfx_.get_depth_image().extent;
+    VkExtent2D pyramid_extent = {std::max(depth_extent.width / 2, 1u), std::max(depth_extent.height / 2, 1u)};
+    u32        num_mips       = std::bit_width(std::max(pyramid_extent.width, pyramid_extent.height));
+
+    depth_pyramid_ = gfx_.create_image_gpu(pyramid_extent,
+                                           VK_FORMAT_R32_SFLOAT,
+                                           VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                           num_mips,
+                                           VK_IMAGE_ASPECT_COLOR_BIT);
+
+    depth_pyramid_mips_.resize(num_mips);
+    for (u32 mip = 0; mip < num_mips; ++mip) {
+        depth_pyramid_mips_[mip] = gfx_.create_image_view(depth_pyramid_, VK_IMAGE_ASPECT_COLOR_BIT, mip, 1);
+    }
+
+    // the shaders only use texelFetch, but a combined image sampler needs a sampler
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType               = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter           = VK_FILTER_NEAREST;
+    sampler_info.minFilter           = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.maxLod              = VK_LOD_CLAMP_NONE;
+    depth_pyramid_sampler_           = gfx_.create_sampler(sampler_info);
+}
+
+BatchGroup GpuCulling::cull(VkCommandBuffer   cmd,
+                            const BatchGroup& group,
+                            u32               num_objects,
+                            const Camera&     camera,
+                            u32               viewport_height,
+                            Phase             phase) {
+    rune_assert(core_, group.count_buffer == VK_NULL_HANDLE);
+
+    // every batch gets a draw for each lod
+    u32        num_lods     = gfx_.get_max_mesh_lods();
+    u32        num_buckets  = group.num_batches * num_lods;
+    BatchGroup culled_group = gfx_.reserve_batches(num_buckets);
+    if (culled_group.count_buffer == VK_NULL_HANDLE) {
+        // out of room, draw everything once rather than nothing
+        return phase == Phase::EARLY ? group : BatchGroup();
+    }
+
+    Buffer draws              = gfx_.get_draw_data_buffer();
+    Buffer visible_counts     = gfx_.get_visible_count_buffer();
+    Buffer culled_object_data = gfx_.get_culled_object_data_buffer();
+    u32    is_late_phase      = phase == Phase::LATE;
+    u32    lod_stride         = culled_object_data.range / sizeof(ObjectData) / MAX_MESH_LODS;
+
+    if (phase == Phase::EARLY) {
+        // counts for both phases
+        vkCmdFillBuffer(cmd, visible_counts.buffer, 0, 2 * num_buckets * sizeof(u32), 0);
+
+        if (!is_depth_pyramid_ready_) {
+            // the early phase doesn't read the pyramid, but it's bound and has to be in the layout we say it's in
+            gfx_.image_barrier(cmd,
+                               depth_pyramid_,
+                               VK_IMAGE_ASPECT_COLOR_BIT,
+                               VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               0,
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                               0,
+                               VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_GENERAL);
+            is_depth_pyramid_ready_ = true;
+        }
+    }
+    gfx_.clear_draw_count(cmd, culled_group);
+
+    // also waits for last frame's late phase to finish writing visibility
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    cull_instances_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_object_data", gfx_.get_object_data_buffer());
+        writes.set_buffer("u_mesh_table", gfx_.get_mesh_table_buffer());
+        writes.set_buffer("u_draws", draws);
+        writes.set_buffer("u_visible_counts", visible_counts);
+        writes.set_buffer("u_culled_object_data", culled_object_data);
+        writes.set_buffer("u_visibility", gfx_.get_visibility_buffer());
+        writes.set_combined_image_sampler("u_depth_pyramid",
+                                          depth_pyramid_.view,
+                                          depth_pyramid_sampler_,
+                                          VK_IMAGE_LAYOUT_GENERAL);
+        cull_instances_pass_.set_descriptors(cmd, writes);
+
+        struct CullData {
+            glm::mat4 vp;
+            glm::vec3 camera_position;
+            f32       lod_scale;
+            u32       num_objects;
+            u32       num_batches;
+            u32       first_batch;
+            u32       is_late_phase;
+            u32       num_lods;
+            u32       lod_stride;
+            f32       lod_error_threshold;
+        } cull_data                   = {};
+        cull_data.vp                  = camera.get_view_projection_matrix();
+        cull_data.camera_position     = camera.get_position();
+        cull_data.lod_scale           = (f32)viewport_height / (2.0f * std::tan(camera.get_fov_radians() * 0.5f));
+        cull_data.num_objects         = num_objects;
+        cull_data.num_batches         = group.num_batches;
+        cull_data.first_batch         = group.first_batch;
+        cull_data.is_late_phase       = is_late_phase;
+        cull_data.num_lods            = num_lods;
+        cull_data.lod_stride          = lod_stride;
+        cull_data.lod_error_threshold = LOD_ERROR_THRESHOLD;
+        cull_instances_pass_.set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, cull_data);
+
+        ComputePass::dispatch(cmd, num_objects, WORKGROUP_SIZE);
+    });
+
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT);
+
+    compact_draws_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_draws", draws);
+        writes.set_buffer("u_visible_counts", visible_counts);
+        writes.set_buffer("u_culled_draws", draws);
+        writes.set_buffer("u_draw_counts", gfx_.get_draw_count_buffer());
+        writes.set_buffer("u_culled_object_data", culled_object_data);
+        writes.set_buffer("u_mesh_table", gfx_.get_mesh_table_buffer());
+        compact_draws_pass_.set_descriptors(cmd, writes);
+
+        struct CompactData {
+            u32 num_batches;
+            u32 first_batch;
+            u32 first_culled_batch;
+            u32 draw_count_index;
+            u32 is_late_phase;
+            u32 num_lods;
+            u32 lod_stride;
+        } compact_data                  = {};
+        compact_data.num_batches        = group.num_batches;
+        compact_data.first_batch        = group.first_batch;
+        compact_data.first_culled_batch = culled_group.first_batch;
+        compact_data.draw_count_index   = culled_group.count_offset / sizeof(u32);
+        compact_data.is_late_phase      = is_late_phase;
+        compact_data.num_lods           = num_lods;
+        compact_data.lod_stride         = lod_stride;
+        compact_draws_pass_.set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, compact_data);
+
+        ComputePass::dispatch(cmd, group.num_batches, WORKGROUP_SIZE);
+    });
+
+    return culled_group;
+}
+
+void GpuCulling::build_depth_pyramid(VkCommandBuffer cmd, const Image& depth) {
+    // the old contents aren't needed, wait for the last late phase to stop reading them
+    gfx_.image_barrier(cmd,
+                       depth_pyramid_,
+                       VK_IMAGE_ASPECT_COLOR_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_IMAGE_LAYOUT_UNDEFINED,
+                       VK_IMAGE_LAYOUT_GENERAL);
+    is_depth_pyramid_ready_ = true;
+
+    depth_pyramid_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        VkExtent2D mip_extent = depth_pyramid_.extent;
+        for (u32 mip = 0; mip < depth_pyramid_.mip_levels; ++mip) {
+            // mip 0 is reduced from the depth buffer, the rest from the mip before them
+            DescriptorWrites writes;
+            if (mip == 0) {
+                writes.set_combined_image_sampler("u_src",
+                                                  depth.view,
+                                                  depth_pyramid_sampler_,
+                                                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+            } else {
+                writes.set_combined_image_sampler("u_src",
+                                                  depth_pyramid_mips_[mip - 1],
+                                                  depth_pyramid_sampler_,
+                                                  VK_IMAGE_LAYOUT_GENERAL);
+            }
+            writes.set_storage_image("u_dst", depth_pyramid_mips_[mip], VK_IMAGE_LAYOUT_GENERAL);
+            depth_pyramid_pass_.set_descriptors(cmd, writes);
+
+            ComputePass::dispatch(cmd, mip_extent, PYRAMID_WORKGROUP_SIZE);
+
+            gfx_.memory_barrier(cmd,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_ACCESS_SHADER_WRITE_BIT,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_ACCESS_SHADER_READ_BIT);
+
+            mip_extent = {std::max(mip_extent.width / 2, 1u), std::max(mip_extent.height / 2, 1u)};
+        }
+    });
+}
+
+} // namespace rune::gfx
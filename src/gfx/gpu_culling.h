@@ -0,0 +1,90 @@
+#ifndef RUNE_GPU_CULLING_H
+#define RUNE_GPU_CULLING_H
+
+#include "gfx/camera.h"
+#include "gfx/compute_pass.h"
+#include "gfx/graphics_backend.h"
+#include "gfx/image.h"
+
+#include <vector>
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+/**
+ * Frustum and occlusion culls the instances of a batch group on the gpu, picks a level of detail for each visible one
+ * and compacts them into an indirect draw per batch and lod, the cpu never reads the result back.
+ * Culling happens in two phases. The early phase keeps what was visible last frame, once that's drawn a depth pyramid
+ * is built from it, and the late phase keeps what's newly visible against the pyramid. Drawing both means nothing that
+ * was hidden last frame pops in late.
+ * @note Check GraphicsBackend::supports_gpu_culling before using
+ */
+class GpuCulling {
+  public:
+    enum class Phase
+    {
+        EARLY,
+        LATE
+    };
+
+    explicit GpuCulling(Core& core, GraphicsBackend& gfx);
+
+    /**
+     * Record culling a batch group's instances for a phase. The kept instances are written to
+     * GraphicsBackend::get_culled_object_data_buffer(), in the range the batch had in the object data buffer offset by
+     * MAX_OBJECTS for each lod
+     * @note Must be recorded outside of a graphics pass, after the frame's object data and the group were added.
+     * The late phase must come after build_depth_pyramid. The draws are written by compute shaders, the pass that reads
+     * them has to wait for them, see RenderGraph
+     * @param cmd The command buffer to record to
+     * @param group A batch group from GraphicsBackend::add_batches
+     * @param num_objects The number of objects in the group, they're expected to start at the first object
+     * @param camera The camera the group is drawn with
+     * @param viewport_height The height of the viewport in pixels, used to pick lods
+     * @param phase The culling phase
+     * @return A batch group with a gpu written draw count that draws the kept instances
+     */
+    BatchGroup cull(VkCommandBuffer   cmd,
+                    const BatchGroup& group,
+                    u32               num_objects,
+                    const Camera&     camera,
+                    u32               viewport_height,
+                    Phase             phase);
+
+    /**
+     * Record building the depth pyramid used by the late phase, after the early phase's draws
+     * @param cmd The command buffer to record to
+     * @param depth The depth buffer the early phase drew to, in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+     */
+    void build_depth_pyramid(VkCommandBuffer cmd, const Image& depth);
+
+  private:
+    // local_size_x of the culling shaders
+    static constexpr u32 WORKGROUP_SIZE = 64;
+
+    // a lod is used once its error covers less than this many pixels
+    static constexpr f32 LOD_ERROR_THRESHOLD = 1.0f;
+
+    // local_size_x and local_size_y of the depth pyramid shader
+    static constexpr VkExtent2D PYRAMID_WORKGROUP_SIZE = {8, 8};
+
+    Core&            core_;
+    GraphicsBackend& gfx_;
+
+    ComputePass cull_instances_pass_;
+    ComputePass compact_draws_pass_;
+    ComputePass depth_pyramid_pass_;
+
+    // max depth, mip 0 is half the size of the depth buffer. Kept in VK_IMAGE_LAYOUT_GENERAL
+    Image                    depth_pyramid_;
+    std::vector<VkImageView> depth_pyramid_mips_;
+    VkSampler                depth_pyramid_sampler_  = VK_NULL_HANDLE;
+    bool                     is_depth_pyramid_ready_ = false;
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_GPU_CULLING_H
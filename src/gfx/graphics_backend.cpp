@@ -1,9 +1,15 @@
 #include "graphics_backend.h"
 
 #include "core.h"
+#include "draw_key.h"
+#include "heap_tracker.h"
+#include "mesh_simplifier.h"
 #include "utils.h"
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <set>
 #include <spirv_reflect.h>
 
@@ -25,6 +31,16 @@ constexpr VkPhysicalDeviceFeatures g_possible_device_feature_sets[] = {
     // acceptable feature set
     VkPhysicalDeviceFeatures{.drawIndirectFirstInstance = VK_TRUE}};
 
+static VkDrawIndirectCommand get_draw_command(const MeshBatch& batch) {
+    VkDrawIndirectCommand draw = {};
+    draw.firstInstance         = batch.first_object_idx;
+    draw.instanceCount         = batch.num_objects;
+    draw.firstVertex           = batch.mesh.get_first_vertex();
+    draw.vertexCount           = batch.mesh.get_num_vertices();
+
+    return draw;
+}
+
 GraphicsBackend::GraphicsBackend(Core& core, GLFWwindow* window) : core_(core) {
     // create instance
     VkApplicationInfo app_info = {};
@@ -67,11 +83,17 @@ GraphicsBackend::GraphicsBackend(Core& core, GLFWwindow* window) : core_(core) {
     vk_check(vkCreateCommandPool(device_, &command_pool_create_info, nullptr, &command_pool_));
     cleanup_.emplace([=] { vkDestroyCommandPool(device_, command_pool_, nullptr); });
 
+    command_pool_create_info.queueFamilyIndex = compute_family_index_;
+    vk_check(vkCreateCommandPool(device_, &command_pool_create_info, nullptr, &compute_command_pool_));
+    cleanup_.emplace([=] { vkDestroyCommandPool(device_, compute_command_pool_, nullptr); });
+
     // create descriptor pool
-    VkDescriptorPoolSize       sizes[]                     = {{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4}};
+    VkDescriptorPoolSize sizes[] = {{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 128},
+                                    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 64},
+                                    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 64}};
     VkDescriptorPoolCreateInfo descriptor_pool_create_info = {};
     descriptor_pool_create_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptor_pool_create_info.maxSets                    = 4; // TODO
+    descriptor_pool_create_info.maxSets                    = 64; // TODO
     descriptor_pool_create_info.poolSizeCount              = std::size(sizes);
     descriptor_pool_create_info.pPoolSizes                 = sizes;
     vk_check(vkCreateDescriptorPool(device_, &descriptor_pool_create_info, nullptr, &descriptor_pool_));
@@ -90,15 +112,105 @@ GraphicsBackend::GraphicsBackend(Core& core, GLFWwindow* window) : core_(core) {
         frame.command_buffer_ = cmd_buf;
         cleanup_.emplace([=] { vkFreeCommandBuffers(device_, command_pool_, 1, &cmd_buf); });
 
+        VkCommandBuffer compute_cmd_buf;
+        cmd_buf_alloc_info.commandPool = compute_command_pool_;
+        vk_check(vkAllocateCommandBuffers(device_, &cmd_buf_alloc_info, &compute_cmd_buf));
+        frame.compute_command_buffer_ = compute_cmd_buf;
+        cleanup_.emplace([=] { vkFreeCommandBuffers(device_, compute_command_pool_, 1, &compute_cmd_buf); });
+
+        VkCommandBuffer upload_cmd_buf;
+        cmd_buf_alloc_info.commandPool = command_pool_;
+        vk_check(vkAllocateCommandBuffers(device_, &cmd_buf_alloc_info, &upload_cmd_buf));
+        frame.upload_command_buffer_ = upload_cmd_buf;
+        cleanup_.emplace([=] { vkFreeCommandBuffers(device_, command_pool_, 1, &upload_cmd_buf); });
+
+        // room for all of the frame's buffers that are written by the cpu to be uploaded in full
+        VkDeviceSize staging_size = sizeof(ObjectData) * MAX_OBJECTS + sizeof(VkDrawIndirectCommand) * MAX_DRAWS +
+                                    sizeof(u32) + sizeof(InstanceRange) * MAX_OBJECTS +
+                                    sizeof(PointLight) * MAX_LIGHTS + sizeof(DirectionalLightData) +
+                                    sizeof(glm::mat4) * MAX_FRAME_VIEWS;
+
+        VmaAllocationCreateInfo staging_alloc_ci = {};
+        staging_alloc_ci.usage                   = VMA_MEMORY_USAGE_CPU_ONLY;
+        staging_alloc_ci.flags                   = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        VkBufferCreateInfo staging_ci = {};
+        staging_ci.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        staging_ci.size               = staging_size;
+        staging_ci.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        staging_ci.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+        Buffer staging;
+        staging.range = staging_size;
+        vk_check(vmaCreateBuffer(allocator_,
+                                 &staging_ci,
+                                 &staging_alloc_ci,
+                                 &staging.buffer,
+                                 &staging.allocation,
+                                 &staging.allocation_info));
+        frame.staging_ = staging;
+        cleanup_.emplace([=] { destroy_buffer(staging); });
+        frame.staging_offset_ = 0;
+        frame.has_uploads_    = false;
+
         // TODO: experiment with different memory types
         frame.object_data_ = create_buffer_gpu(sizeof(ObjectData) * MAX_OBJECTS,
                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                                                BufferDestroyPolicy::AUTOMATIC_DESTROY);
-        frame.draw_data_ =
-            create_buffer_gpu(sizeof(VkDrawIndirectCommand) * MAX_DRAWS,
-                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT /*| VK_BUFFER_USAGE_STORAGE_BUFFER_BIT*/,
+
+        // storage so that the gpu can write draws and counts too
+        frame.draw_data_   = create_buffer_gpu(sizeof(VkDrawIndirectCommand) * MAX_DRAWS,
+                                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                               BufferDestroyPolicy::AUTOMATIC_DESTROY);
+        frame.draw_counts_ = create_buffer_gpu(sizeof(u32) * MAX_DRAW_COUNTS,
+                                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                               BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+        frame.uploaded_draws_.resize(MAX_DRAWS);
+
+        frame.instance_ranges_ = create_buffer_gpu(sizeof(u32) + sizeof(InstanceRange) * MAX_OBJECTS,
+                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                   BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+        // each lod gets its own MAX_OBJECTS sized range
+        frame.culled_object_data_ = create_buffer_gpu(sizeof(ObjectData) * MAX_OBJECTS * MAX_MESH_LODS,
+                                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                      BufferDestroyPolicy::AUTOMATIC_DESTROY);
+        frame.visible_counts_     = create_buffer_gpu(sizeof(u32) * MAX_DRAWS * 2,
+                                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                      BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+        // a draw followed by an (object index, meshlet index) pair for each instance
+        frame.visible_meshlets_ =
+            create_buffer_gpu(sizeof(VkDrawIndirectCommand) + sizeof(u32) * 2 * MAX_VISIBLE_MESHLETS,
+                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                               BufferDestroyPolicy::AUTOMATIC_DESTROY);
 
+        frame.light_data_ = create_buffer_gpu(sizeof(PointLight) * MAX_LIGHTS,
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                              BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+        // the swapchain doesn't resize yet, so the tiles are sized once
+        VkExtent2D   num_tiles = get_num_light_tiles();
+        VkDeviceSize tile_size = sizeof(u32) * (1 + MAX_LIGHTS_PER_TILE);
+        frame.light_tiles_     = create_buffer_gpu(tile_size * num_tiles.width * num_tiles.height,
+                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                   BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+        u32          num_clusters = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+        VkDeviceSize cluster_size = sizeof(u32) * (1 + MAX_LIGHTS_PER_CLUSTER);
+        frame.light_clusters_     = create_buffer_gpu(LIGHT_CLUSTER_HEADER_SIZE + cluster_size * num_clusters,
+                                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                      BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+        frame.directional_light_ = create_buffer_gpu(sizeof(DirectionalLightData),
+                                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                     BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+        frame.views_ = create_buffer_gpu(sizeof(glm::mat4) * MAX_FRAME_VIEWS,
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                         BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
         VkSemaphoreCreateInfo semaphore_create_info = {};
         semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
@@ -106,17 +218,23 @@ GraphicsBackend::GraphicsBackend(Core& core, GLFWwindow* window) : core_(core) {
         fence_create_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fence_create_info.flags             = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        VkSemaphore img_available, render_finished;
+        VkSemaphore img_available, render_finished, compute_finished, uploads_finished;
         VkFence     in_flight;
 
         vk_check(vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &img_available));
         vk_check(vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &render_finished));
+        vk_check(vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &compute_finished));
+        vk_check(vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &uploads_finished));
         vk_check(vkCreateFence(device_, &fence_create_info, nullptr, &in_flight));
-        frame.image_available_ = img_available;
-        frame.render_finished_ = render_finished;
-        frame.in_flight_       = in_flight;
+        frame.image_available_  = img_available;
+        frame.render_finished_  = render_finished;
+        frame.compute_finished_ = compute_finished;
+        frame.uploads_finished_ = uploads_finished;
+        frame.in_flight_        = in_flight;
         cleanup_.emplace([=] {
             vkDestroyFence(device_, in_flight, nullptr);
+            vkDestroySemaphore(device_, uploads_finished, nullptr);
+            vkDestroySemaphore(device_, compute_finished, nullptr);
             vkDestroySemaphore(device_, render_finished, nullptr);
             vkDestroySemaphore(device_, img_available, nullptr);
         });
@@ -126,6 +244,35 @@ GraphicsBackend::GraphicsBackend(Core& core, GLFWwindow* window) : core_(core) {
     unified_vertex_buffer_ = create_buffer_gpu(sizeof(Vertex) * MAX_UNIQUE_VERTICES,
                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                                                BufferDestroyPolicy::AUTOMATIC_DESTROY);
+    mesh_table_buffer_     = create_buffer_gpu(sizeof(MeshData) * MAX_MESHES,
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                               BufferDestroyPolicy::AUTOMATIC_DESTROY);
+    material_buffer_       = create_buffer_gpu(sizeof(MaterialData) * MAX_MATERIALS,
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                               BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+    // objects that aren't given a material are drawn with the first one
+    create_material(MaterialDesc{});
+
+    meshlet_buffer_          = create_buffer_gpu(sizeof(Meshlet) * MAX_MESHLETS,
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                 BufferDestroyPolicy::AUTOMATIC_DESTROY);
+    meshlet_vertex_buffer_   = create_buffer_gpu(sizeof(u32) * MAX_MESHLET_VERTEX_REFS,
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                 BufferDestroyPolicy::AUTOMATIC_DESTROY);
+    meshlet_triangle_buffer_ = create_buffer_gpu(sizeof(u32) * MAX_MESHLET_TRIANGLE_REFS,
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                 BufferDestroyPolicy::AUTOMATIC_DESTROY);
+
+    // nothing was visible before the first frame
+    visibility_buffer_ = create_buffer_gpu(sizeof(u32) * MAX_OBJECTS,
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                           BufferDestroyPolicy::AUTOMATIC_DESTROY);
+    one_time_submit(graphics_queue_, [&](VkCommandBuffer cmd) {
+        vkCmdFillBuffer(cmd, visibility_buffer_.buffer, 0, VK_WHOLE_SIZE, 0);
+    });
+
+    create_depth_images();
 
     // todo: swapchain resizing
 }
@@ -153,10 +300,25 @@ void GraphicsBackend::begin_frame() {
 
     // commands finished executing, can do things safely
     vk_check(vkResetCommandBuffer(get_current_frame().command_buffer_, 0));
+    if (get_current_frame().compute_wait_stages_ != 0) {
+        vk_check(vkResetCommandBuffer(get_current_frame().compute_command_buffer_, 0));
+        get_current_frame().compute_wait_stages_ = 0;
+    }
+    if (get_current_frame().has_uploads_) {
+        vk_check(vkResetCommandBuffer(get_current_frame().upload_command_buffer_, 0));
+        get_current_frame().has_uploads_ = false;
+    }
+    get_current_frame().staging_offset_ = 0;
+    frame_arena_.reset();
     for (auto& cache : get_current_frame().descriptor_set_caches_) {
         cache.second.reset();
     }
-    get_current_frame().num_draws_ = 0;
+    get_current_frame().num_draws_           = 0;
+    get_current_frame().num_instance_ranges_ = 0;
+    get_current_frame().num_flat_vertices_   = 0;
+    get_current_frame().num_batch_groups_    = 0;
+    get_current_frame().num_draw_counts_     = 0;
+    get_current_frame().num_views_           = 0;
 
     // get next image
     vk_check(vkAcquireNextImageKHR(device_,
@@ -170,22 +332,78 @@ void GraphicsBackend::begin_frame() {
     VkCommandBufferBeginInfo begin_info = {};
     begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     vk_check(vkBeginCommandBuffer(get_current_frame().command_buffer_, &begin_info));
+
+    // the frame's uploads are submitted ahead of it, so this covers uploads recorded at any point in the frame
+    memory_barrier(get_current_frame().command_buffer_,
+                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                   VK_ACCESS_TRANSFER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                   VK_ACCESS_MEMORY_READ_BIT);
+}
+
+VkCommandBuffer GraphicsBackend::get_async_compute_command_buffer(VkPipelineStageFlags graphics_wait_stages) {
+    rune_assert(core_, graphics_wait_stages != 0);
+
+    if (get_current_frame().compute_wait_stages_ == 0) {
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vk_check(vkBeginCommandBuffer(get_current_frame().compute_command_buffer_, &begin_info));
+    }
+    get_current_frame().compute_wait_stages_ |= graphics_wait_stages;
+
+    return get_current_frame().compute_command_buffer_;
 }
 
 void GraphicsBackend::end_frame() {
     vk_check(vkEndCommandBuffer(get_current_frame().command_buffer_));
 
-    // wait for image to be available, submit queue, signal render_finished_ when done
-    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    VkSubmitInfo         submit_info   = {};
-    submit_info.sType                  = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.waitSemaphoreCount     = 1;
-    submit_info.pWaitSemaphores        = &get_current_frame().image_available_;
-    submit_info.pWaitDstStageMask      = wait_stages;
-    submit_info.commandBufferCount     = 1;
-    submit_info.pCommandBuffers        = &get_current_frame().command_buffer_;
-    submit_info.signalSemaphoreCount   = 1;
-    submit_info.pSignalSemaphores      = &get_current_frame().render_finished_;
+    // the uploads go before everything else. The graphics work comes after them on the same queue, async compute
+    // waits for them with uploads_finished_
+    bool has_async_compute = get_current_frame().compute_wait_stages_ != 0;
+    bool has_uploads       = get_current_frame().has_uploads_;
+    if (has_uploads) {
+        vk_check(vkEndCommandBuffer(get_current_frame().upload_command_buffer_));
+
+        VkSubmitInfo upload_submit_info         = {};
+        upload_submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        upload_submit_info.commandBufferCount   = 1;
+        upload_submit_info.pCommandBuffers      = &get_current_frame().upload_command_buffer_;
+        upload_submit_info.signalSemaphoreCount = has_async_compute ? 1 : 0;
+        upload_submit_info.pSignalSemaphores    = &get_current_frame().uploads_finished_;
+        vk_check(vkQueueSubmit(graphics_queue_, 1, &upload_submit_info, VK_NULL_HANDLE));
+    }
+
+    // async compute goes next and signals compute_finished_, nothing waits on the compute queue itself
+    if (has_async_compute) {
+        vk_check(vkEndCommandBuffer(get_current_frame().compute_command_buffer_));
+
+        VkPipelineStageFlags upload_wait_stage   = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo         compute_submit_info = {};
+        compute_submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        compute_submit_info.waitSemaphoreCount   = has_uploads ? 1 : 0;
+        compute_submit_info.pWaitSemaphores      = &get_current_frame().uploads_finished_;
+        compute_submit_info.pWaitDstStageMask    = &upload_wait_stage;
+        compute_submit_info.commandBufferCount   = 1;
+        compute_submit_info.pCommandBuffers      = &get_current_frame().compute_command_buffer_;
+        compute_submit_info.signalSemaphoreCount = 1;
+        compute_submit_info.pSignalSemaphores    = &get_current_frame().compute_finished_;
+        vk_check(vkQueueSubmit(compute_queue_, 1, &compute_submit_info, VK_NULL_HANDLE));
+    }
+
+    // wait for image to be available and for async compute, submit queue, signal render_finished_ when done
+    VkSemaphore          wait_semaphores[] = {get_current_frame().image_available_,
+                                              get_current_frame().compute_finished_};
+    VkPipelineStageFlags wait_stages[]     = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                              get_current_frame().compute_wait_stages_};
+    VkSubmitInfo         submit_info       = {};
+    submit_info.sType                      = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount         = has_async_compute ? 2 : 1;
+    submit_info.pWaitSemaphores            = wait_semaphores;
+    submit_info.pWaitDstStageMask          = wait_stages;
+    submit_info.commandBufferCount         = 1;
+    submit_info.pCommandBuffers            = &get_current_frame().command_buffer_;
+    submit_info.signalSemaphoreCount       = 1;
+    submit_info.pSignalSemaphores          = &get_current_frame().render_finished_;
     vk_check(vkQueueSubmit(graphics_queue_, 1, &submit_info, get_current_frame().in_flight_));
 
     // wait for render_finished_ and queue for presentation
@@ -201,17 +419,141 @@ void GraphicsBackend::end_frame() {
     current_frame_ = (current_frame_ + 1) % NUM_FRAMES_IN_FLIGHT;
 }
 
-void GraphicsBackend::update_object_data(const ObjectData* data, u32 num_objects) {
-    if (num_objects > MAX_OBJECTS) {
-        core_.get_logger().warn("tried to render % objects, maximum allowed is %", num_objects, MAX_OBJECTS);
-        num_objects = MAX_OBJECTS;
+void GraphicsBackend::update_object_data(const ObjectData* data, u32 num_objects, u32 first_object) {
+    if (first_object + num_objects > MAX_OBJECTS) {
+        core_.get_logger().warn("tried to render % objects, maximum allowed is %",
+                                first_object + num_objects,
+                                MAX_OBJECTS);
+        num_objects = first_object < MAX_OBJECTS ? MAX_OBJECTS - first_object : 0;
+    }
+
+    if (num_objects == 0) {
+        return;
+    }
+
+    upload_to_buffer(data,
+                     num_objects * sizeof(ObjectData),
+                     get_object_data_buffer(),
+                     first_object * sizeof(ObjectData));
+}
+
+void GraphicsBackend::update_light_data(std::span<const PointLight> lights) {
+    u32 num_lights = lights.size();
+    if (num_lights > MAX_LIGHTS) {
+        core_.get_logger().warn("tried to render % lights, maximum allowed is %", num_lights, MAX_LIGHTS);
+        num_lights = MAX_LIGHTS;
+    }
+
+    get_current_frame().num_lights_ = num_lights;
+    if (num_lights == 0) {
+        return;
+    }
+
+    upload_to_buffer(lights.data(), num_lights * sizeof(PointLight), get_light_data_buffer(), 0);
+}
+
+void GraphicsBackend::update_directional_light(const DirectionalLightData& data) {
+    upload_to_buffer(&data, sizeof(data), get_directional_light_buffer(), 0);
+}
+
+u32 GraphicsBackend::add_views(std::span<const glm::mat4> view_projections) {
+    u32 first_view = get_current_frame().num_views_;
+    if (view_projections.size() > MAX_VIEWS || first_view + view_projections.size() > MAX_FRAME_VIEWS) {
+        core_.get_logger().warn("could not add % views. current: %, max: %",
+                                view_projections.size(),
+                                first_view,
+                                MAX_FRAME_VIEWS);
+        return ~0u;
+    }
+
+    get_current_frame().num_views_ += view_projections.size();
+    upload_to_buffer(view_projections.data(),
+                     view_projections.size_bytes(),
+                     get_view_buffer(),
+                     first_view * sizeof(glm::mat4));
+    return first_view;
+}
+
+void GraphicsBackend::update_object_data(std::span<const ObjectData> data, std::span<const u32> indices) {
+    rune_assert(core_, data.size() == indices.size());
+
+    // a region for each run of consecutive indices
+    FrameVector<VkBufferCopy> regions{FrameAllocator<VkBufferCopy>(frame_arena_)};
+    {
+        heap_tracker::Scope heap_scope;
+
+        for (u32 i = 0; i < indices.size(); ++i) {
+            if (indices[i] >= MAX_OBJECTS) {
+                core_.get_logger().warn("tried to update object %, maximum allowed is %", indices[i], MAX_OBJECTS);
+                break;
+            }
+
+            if (i > 0 && indices[i] == indices[i - 1] + 1) {
+                regions.back().size += sizeof(ObjectData);
+                continue;
+            }
+
+            VkBufferCopy region = {};
+            region.srcOffset    = i * sizeof(ObjectData);
+            region.dstOffset    = indices[i] * sizeof(ObjectData);
+            region.size         = sizeof(ObjectData);
+            regions.emplace_back(region);
+        }
+    }
+
+    if (regions.empty()) {
+        return;
+    }
+
+    // only the objects up to the first one that didn't fit are staged
+    upload_to_buffer(data.data(), regions.back().srcOffset + regions.back().size, get_object_data_buffer(), regions);
+}
+
+Mesh GraphicsBackend::load_mesh(const Vertex* data, u32 num_vertices, const char* baked_lods_path) {
+    std::vector<LodLevel> lod_chain;
+    if (baked_lods_path) {
+        lod_chain = load_lod_chain(baked_lods_path);
+
+        // the first level is the mesh itself, if it doesn't match the mesh changed since it was baked
+        bool is_current = !lod_chain.empty() && lod_chain.size() <= MAX_MESH_LODS &&
+                          lod_chain[0].vertices.size() == num_vertices &&
+                          std::memcmp(lod_chain[0].vertices.data(), data, num_vertices * sizeof(Vertex)) == 0;
+        if (!is_current) {
+            core_.get_logger().warn("no up to date lods baked at %, generating them", baked_lods_path);
+            lod_chain.clear();
+        }
+    }
+    if (lod_chain.empty()) {
+        lod_chain = build_lod_chain(data, num_vertices, MAX_MESH_LODS);
+    }
+
+    MeshLodDesc lods[MAX_MESH_LODS] = {};
+    for (u32 i = 0; i < lod_chain.size(); ++i) {
+        lods[i].vertices     = lod_chain[i].vertices.data();
+        lods[i].num_vertices = lod_chain[i].vertices.size();
+        lods[i].error        = lod_chain[i].error;
     }
 
-    copy_to_buffer((void*)data, num_objects * sizeof(ObjectData), get_object_data_buffer(), 0);
+    return load_mesh(std::span<const MeshLodDesc>(lods, lod_chain.size()));
 }
 
-Mesh GraphicsBackend::load_mesh(const Vertex* data, u32 num_vertices) {
+Mesh GraphicsBackend::load_mesh(std::span<const MeshLodDesc> lods) {
     // Make sure we have room
+    if (mesh_table_.size() >= MAX_MESHES) {
+        core_.get_logger().warn("could not load mesh, maximum number of meshes (%) reached", MAX_MESHES);
+        return Mesh();
+    }
+
+    if (lods.empty() || lods.size() > MAX_MESH_LODS) {
+        core_.get_logger().warn("could not load mesh with % lods, needs between 1 and %", lods.size(), MAX_MESH_LODS);
+        return Mesh();
+    }
+
+    u32 num_vertices = 0;
+    for (const MeshLodDesc& lod : lods) {
+        num_vertices += lod.num_vertices;
+    }
+
     if (num_vertices_in_buffer_ + num_vertices > MAX_UNIQUE_VERTICES) {
         core_.get_logger().warn("could not load mesh with % vertices. current: %, max: %",
                                 num_vertices,
@@ -220,15 +562,100 @@ Mesh GraphicsBackend::load_mesh(const Vertex* data, u32 num_vertices) {
         return Mesh();
     }
 
-    // Add vertices for mesh
-    u32 first_vertex_idx = num_vertices_in_buffer_;
-    copy_to_buffer(data,
-                   num_vertices * sizeof(Vertex),
-                   unified_vertex_buffer_,
-                   num_vertices_in_buffer_ * sizeof(Vertex));
-    num_vertices_in_buffer_ += num_vertices;
+    // Add vertices for each lod
+    MeshData mesh_data = {};
+    mesh_data.num_lods = lods.size();
+    for (u32 i = 0; i < lods.size(); ++i) {
+        MeshLod& lod     = mesh_data.lods[i];
+        lod.first_vertex = num_vertices_in_buffer_;
+        lod.num_vertices = lods[i].num_vertices;
+        lod.error        = lods[i].error;
+
+        copy_to_buffer(lods[i].vertices,
+                       lods[i].num_vertices * sizeof(Vertex),
+                       unified_vertex_buffer_,
+                       num_vertices_in_buffer_ * sizeof(Vertex));
+        num_vertices_in_buffer_ += lods[i].num_vertices;
+    }
+
+    // split the full detail lod into meshlets, their vertex indices point into its range of the vertex buffer
+    MeshletMesh meshlet_mesh = build_meshlets(lods[0].vertices, lods[0].num_vertices);
+    for (u32& vertex : meshlet_mesh.vertices) {
+        vertex += mesh_data.lods[0].first_vertex;
+    }
+    for (Meshlet& meshlet : meshlet_mesh.meshlets) {
+        meshlet.vertex_offset += num_meshlet_vertices_in_buffer_;
+        meshlet.triangle_offset += num_meshlet_triangles_in_buffer_;
+    }
+
+    mesh_data.first_meshlet = num_meshlets_in_buffer_;
+    mesh_data.num_meshlets  = meshlet_mesh.meshlets.size();
+    if (!meshlet_mesh.meshlets.empty()) {
+        copy_to_buffer(meshlet_mesh.meshlets.data(),
+                       meshlet_mesh.meshlets.size() * sizeof(Meshlet),
+                       meshlet_buffer_,
+                       num_meshlets_in_buffer_ * sizeof(Meshlet));
+        copy_to_buffer(meshlet_mesh.vertices.data(),
+                       meshlet_mesh.vertices.size() * sizeof(u32),
+                       meshlet_vertex_buffer_,
+                       num_meshlet_vertices_in_buffer_ * sizeof(u32));
+        copy_to_buffer(meshlet_mesh.triangles.data(),
+                       meshlet_mesh.triangles.size() * sizeof(u32),
+                       meshlet_triangle_buffer_,
+                       num_meshlet_triangles_in_buffer_ * sizeof(u32));
+    }
+    num_meshlets_in_buffer_ += meshlet_mesh.meshlets.size();
+    num_meshlet_vertices_in_buffer_ += meshlet_mesh.vertices.size();
+    num_meshlet_triangles_in_buffer_ += meshlet_mesh.triangles.size();
+
+    // Bounding sphere around the center of the aabb of every lod, simplified lods can stick out of the full detail one.
+    // Not the tightest fit but cheap and good enough for culling
+    glm::vec3 min_position = glm::vec3(std::numeric_limits<f32>::max());
+    glm::vec3 max_position = glm::vec3(std::numeric_limits<f32>::lowest());
+    for (const MeshLodDesc& lod : lods) {
+        for (u32 i = 0; i < lod.num_vertices; ++i) {
+            glm::vec3 position = {lod.vertices[i].x, lod.vertices[i].y, lod.vertices[i].z};
+            min_position       = glm::min(min_position, position);
+            max_position       = glm::max(max_position, position);
+        }
+    }
+
+    glm::vec3 center = num_vertices > 0 ? (min_position + max_position) * 0.5f : glm::vec3(0);
+    f32       radius = 0.0f;
+    for (const MeshLodDesc& lod : lods) {
+        for (u32 i = 0; i < lod.num_vertices; ++i) {
+            glm::vec3 position = {lod.vertices[i].x, lod.vertices[i].y, lod.vertices[i].z};
+            radius             = glm::max(radius, glm::distance(center, position));
+        }
+    }
+    mesh_data.bounding_sphere = glm::vec4(center, radius);
+
+    // Add entry to mesh table
+    u32 mesh_idx = mesh_table_.size();
+    mesh_table_.emplace_back(mesh_data);
+    copy_to_buffer(&mesh_data, sizeof(MeshData), mesh_table_buffer_, mesh_idx * sizeof(MeshData));
+    max_mesh_lods_ = std::max<u32>(max_mesh_lods_, lods.size());
+
+    return Mesh(mesh_idx, mesh_data.lods[0].first_vertex, mesh_data.lods[0].num_vertices);
+}
+
+Material GraphicsBackend::create_material(const MaterialDesc& desc) {
+    if (num_materials_ >= MAX_MATERIALS) {
+        core_.get_logger().warn("could not create material, maximum number of materials (%) reached", MAX_MATERIALS);
+        return Material();
+    }
+
+    if (desc.pipeline >= (1u << DrawKey::PIPELINE_BITS)) {
+        core_.get_logger().warn("could not create material with pipeline %, it has to be less than %",
+                                desc.pipeline,
+                                1u << DrawKey::PIPELINE_BITS);
+        return Material();
+    }
+
+    u32 material_idx = num_materials_++;
+    copy_to_buffer(&desc.data, sizeof(MaterialData), material_buffer_, material_idx * sizeof(MaterialData));
 
-    return Mesh(first_vertex_idx, num_vertices);
+    return Material(material_idx, desc.pipeline);
 }
 
 BatchGroup GraphicsBackend::add_batches(const std::vector<gfx::MeshBatch>& batches) {
@@ -247,30 +674,222 @@ BatchGroup GraphicsBackend::add_batches(const std::vector<gfx::MeshBatch>& batch
         return batch_group;
     }
 
-    std::vector<VkDrawIndirectCommand> draws;
+    PerFrame& frame = get_current_frame();
+
+    batch_group.first_batch = frame.num_draws_;
+    batch_group.num_batches = batches.size();
+
+    // the commands only depend on the batches and where they're placed, so if this frame's buffer already holds the
+    // same group from the last time around we can keep it
+    u64 group_hash = utils::hash_combine(0, batch_group.first_batch);
     for (const gfx::MeshBatch& batch : batches) {
-        VkDrawIndirectCommand draw = {};
-        draw.firstInstance         = batch.first_object_idx;
-        draw.instanceCount         = batch.num_objects;
-        draw.firstVertex           = batch.mesh.get_first_vertex();
-        draw.vertexCount           = batch.mesh.get_num_vertices();
+        group_hash = utils::hash_combine(group_hash, batch.mesh.get_id());
+        group_hash = utils::hash_combine(group_hash, batch.first_object_idx);
+        group_hash = utils::hash_combine(group_hash, batch.num_objects);
+    }
+
+    u32  group_idx = frame.num_batch_groups_++;
+    bool is_uploaded =
+        group_idx < frame.batch_group_hashes_.size() && frame.batch_group_hashes_[group_idx] == group_hash;
 
-        draws.emplace_back(draw);
+    // a matching hash could still be a collision, so the commands are compared with the ones that were uploaded
+    VkDrawIndirectCommand* uploaded_draws = frame.uploaded_draws_.data() + batch_group.first_batch;
+    for (u32 i = 0; is_uploaded && i < batches.size(); ++i) {
+        VkDrawIndirectCommand draw = get_draw_command(batches[i]);
+        is_uploaded                = std::memcmp(&draw, &uploaded_draws[i], sizeof(draw)) == 0;
     }
 
-    batch_group.first_batch = get_current_frame().num_draws_;
-    batch_group.num_batches = batches.size();
+    if (!is_uploaded) {
+        for (u32 i = 0; i < batches.size(); ++i) {
+            uploaded_draws[i] = get_draw_command(batches[i]);
+        }
+
+        upload_to_buffer(uploaded_draws,
+                         batches.size() * sizeof(VkDrawIndirectCommand),
+                         frame.draw_data_,
+                         frame.num_draws_ * sizeof(VkDrawIndirectCommand));
+
+        // groups after this one were placed relative to the old contents, so they're stale now
+        frame.batch_group_hashes_.resize(group_idx);
+        frame.batch_group_hashes_.emplace_back(group_hash);
+    }
+    frame.num_draws_ += batches.size();
+
+    if (!supports_multi_draw_indirect()) {
+        add_instance_ranges(batches, batch_group, !is_uploaded);
+    }
+
+    return batch_group;
+}
+
+BatchGroup GraphicsBackend::reserve_batches(u32 max_batches) {
+    BatchGroup batch_group;
+    PerFrame&  frame = get_current_frame();
+
+    if (frame.num_draws_ + max_batches > MAX_DRAWS || frame.num_draw_counts_ >= MAX_DRAW_COUNTS) {
+        core_.get_logger().warn("could not reserve % draws. current draws: %, max draws: %, current counts: %",
+                                max_batches,
+                                frame.num_draws_,
+                                MAX_DRAWS,
+                                frame.num_draw_counts_);
+        return batch_group;
+    }
+
+    // the gpu writes over the draws of any group that was uploaded here before, and over the commands they were
+    // compared with
+    frame.batch_group_hashes_.resize(std::min<size_t>(frame.batch_group_hashes_.size(), frame.num_batch_groups_));
+
+    batch_group.first_batch  = frame.num_draws_;
+    batch_group.num_batches  = max_batches;
+    batch_group.count_buffer = frame.draw_counts_.buffer;
+    batch_group.count_offset = frame.num_draw_counts_ * sizeof(u32);
 
-    copy_to_buffer(draws.data(),
-                   draws.size() * sizeof(draws[0]),
-                   get_current_frame().draw_data_,
-                   get_current_frame().num_draws_);
-    get_current_frame().num_draws_ += draws.size();
+    frame.num_draws_ += max_batches;
+    frame.num_draw_counts_ += 1;
 
     return batch_group;
 }
 
+// sync1 masks are the low 32 bits of the sync2 ones
+static VkFlags to_sync1_flags(Core& core, VkFlags64 flags) {
+    rune_assert(core, (flags >> 32) == 0);
+    return static_cast<VkFlags>(flags);
+}
+
+void GraphicsBackend::pipeline_barrier(VkCommandBuffer cmd, const VkDependencyInfoKHR& dependency) {
+    if (supports_synchronization2()) {
+        cmd_pipeline_barrier_2_(cmd, &dependency);
+        return;
+    }
+
+    rune_assert(core_, dependency.bufferMemoryBarrierCount == 0);
+
+    // sync1 has one pair of stage masks for the whole barrier
+    VkPipelineStageFlags2KHR src_stages = 0;
+    VkPipelineStageFlags2KHR dst_stages = 0;
+
+    FrameVector<VkMemoryBarrier> memory_barriers{FrameAllocator<VkMemoryBarrier>(frame_arena_)};
+    memory_barriers.reserve(dependency.memoryBarrierCount);
+    for (u32 i = 0; i < dependency.memoryBarrierCount; ++i) {
+        const VkMemoryBarrier2KHR& memory_barrier = dependency.pMemoryBarriers[i];
+
+        VkMemoryBarrier barrier = {};
+        barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask   = to_sync1_flags(core_, memory_barrier.srcAccessMask);
+        barrier.dstAccessMask   = to_sync1_flags(core_, memory_barrier.dstAccessMask);
+        memory_barriers.emplace_back(barrier);
+
+        src_stages |= memory_barrier.srcStageMask;
+        dst_stages |= memory_barrier.dstStageMask;
+    }
+
+    FrameVector<VkImageMemoryBarrier> image_barriers{FrameAllocator<VkImageMemoryBarrier>(frame_arena_)};
+    image_barriers.reserve(dependency.imageMemoryBarrierCount);
+    for (u32 i = 0; i < dependency.imageMemoryBarrierCount; ++i) {
+        const VkImageMemoryBarrier2KHR& image_barrier = dependency.pImageMemoryBarriers[i];
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask        = to_sync1_flags(core_, image_barrier.srcAccessMask);
+        barrier.dstAccessMask        = to_sync1_flags(core_, image_barrier.dstAccessMask);
+        barrier.oldLayout            = image_barrier.oldLayout;
+        barrier.newLayout            = image_barrier.newLayout;
+        barrier.srcQueueFamilyIndex  = image_barrier.srcQueueFamilyIndex;
+        barrier.dstQueueFamilyIndex  = image_barrier.dstQueueFamilyIndex;
+        barrier.image                = image_barrier.image;
+        barrier.subresourceRange     = image_barrier.subresourceRange;
+        image_barriers.emplace_back(barrier);
+
+        src_stages |= image_barrier.srcStageMask;
+        dst_stages |= image_barrier.dstStageMask;
+    }
+
+    // sync2 allows empty stage masks, sync1 needs the stages that wait on or block nothing
+    vkCmdPipelineBarrier(cmd,
+                         src_stages != 0 ? to_sync1_flags(core_, src_stages) : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         dst_stages != 0 ? to_sync1_flags(core_, dst_stages) : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         dependency.dependencyFlags,
+                         memory_barriers.size(),
+                         memory_barriers.data(),
+                         0,
+                         nullptr,
+                         image_barriers.size(),
+                         image_barriers.data());
+}
+
+void GraphicsBackend::memory_barrier(VkCommandBuffer          cmd,
+                                     VkPipelineStageFlags2KHR src_stage,
+                                     VkAccessFlags2KHR        src_access,
+                                     VkPipelineStageFlags2KHR dst_stage,
+                                     VkAccessFlags2KHR        dst_access) {
+    VkMemoryBarrier2KHR barrier = {};
+    barrier.sType               = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+    barrier.srcStageMask        = src_stage;
+    barrier.srcAccessMask       = src_access;
+    barrier.dstStageMask        = dst_stage;
+    barrier.dstAccessMask       = dst_access;
+
+    VkDependencyInfoKHR dependency = {};
+    dependency.sType               = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependency.memoryBarrierCount  = 1;
+    dependency.pMemoryBarriers     = &barrier;
+    pipeline_barrier(cmd, dependency);
+}
+
+void GraphicsBackend::image_barrier(VkCommandBuffer          cmd,
+                                    const Image&             image,
+                                    VkImageAspectFlags       aspect,
+                                    VkPipelineStageFlags2KHR src_stage,
+                                    VkAccessFlags2KHR        src_access,
+                                    VkPipelineStageFlags2KHR dst_stage,
+                                    VkAccessFlags2KHR        dst_access,
+                                    VkImageLayout            old_layout,
+                                    VkImageLayout            new_layout) {
+    VkImageMemoryBarrier2KHR barrier    = {};
+    barrier.sType                       = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+    barrier.srcStageMask                = src_stage;
+    barrier.srcAccessMask               = src_access;
+    barrier.dstStageMask                = dst_stage;
+    barrier.dstAccessMask               = dst_access;
+    barrier.oldLayout                   = old_layout;
+    barrier.newLayout                   = new_layout;
+    barrier.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                       = image.image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.levelCount = image.mip_levels;
+    barrier.subresourceRange.layerCount = image.num_layers;
+
+    VkDependencyInfoKHR dependency     = {};
+    dependency.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependency.imageMemoryBarrierCount = 1;
+    dependency.pImageMemoryBarriers    = &barrier;
+    pipeline_barrier(cmd, dependency);
+}
+
+void GraphicsBackend::clear_draw_count(VkCommandBuffer cmd, const BatchGroup& group) {
+    if (group.count_buffer == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkCmdFillBuffer(cmd, group.count_buffer, group.count_offset, sizeof(u32), 0);
+
+    if (!supports_draw_indirect_count()) {
+        // the fallback draws every reserved slot, so the ones the gpu doesn't write need to be empty
+        vkCmdFillBuffer(cmd,
+                        get_current_frame().draw_data_.buffer,
+                        group.first_batch * sizeof(VkDrawIndirectCommand),
+                        group.num_batches * sizeof(VkDrawIndirectCommand),
+                        0);
+    }
+}
+
 void GraphicsBackend::draw_batch_group(VkCommandBuffer cmd, const BatchGroup& group) {
+    if (group.count_buffer != VK_NULL_HANDLE) {
+        draw_batch_group_gpu_count(cmd, group);
+        return;
+    }
+
     if (device_features_.multiDrawIndirect) {
         vkCmdDrawIndirect(cmd,
                           get_current_frame().draw_data_.buffer,
@@ -278,16 +897,96 @@ void GraphicsBackend::draw_batch_group(VkCommandBuffer cmd, const BatchGroup& gr
                           group.num_batches,
                           sizeof(VkDrawIndirectCommand));
     } else {
+        // one draw over every instance of every batch, the vertex shader resolves the mesh and instance
+        vkCmdDraw(cmd, group.num_vertices, 1, group.first_vertex, group.first_instance_range);
+    }
+}
+
+void GraphicsBackend::draw_batch_group_gpu_count(VkCommandBuffer cmd, const BatchGroup& group) {
+    VkBuffer     draw_buffer = get_current_frame().draw_data_.buffer;
+    VkDeviceSize draw_offset = group.first_batch * sizeof(VkDrawIndirectCommand);
+
+    if (supports_draw_indirect_count() && device_features_.multiDrawIndirect) {
+        vkCmdDrawIndirectCount(cmd,
+                               draw_buffer,
+                               draw_offset,
+                               group.count_buffer,
+                               group.count_offset,
+                               group.num_batches,
+                               sizeof(VkDrawIndirectCommand));
+    } else if (device_features_.multiDrawIndirect) {
+        // draw every reserved slot, unwritten slots were cleared to empty draws by clear_draw_count
+        vkCmdDrawIndirect(cmd, draw_buffer, draw_offset, group.num_batches, sizeof(VkDrawIndirectCommand));
+    } else {
+        // the cpu doesn't know the draws, so they can't be flattened into a single draw
         for (u32 i = 0; i < group.num_batches; ++i) {
             vkCmdDrawIndirect(cmd,
-                              get_current_frame().draw_data_.buffer,
-                              (group.first_batch + i) * sizeof(VkDrawIndirectCommand),
+                              draw_buffer,
+                              draw_offset + i * sizeof(VkDrawIndirectCommand),
                               1,
                               sizeof(VkDrawIndirectCommand));
         }
     }
 }
 
+void GraphicsBackend::add_instance_ranges(const std::vector<gfx::MeshBatch>& batches, BatchGroup& group, bool upload) {
+    PerFrame& frame = get_current_frame();
+
+    u32 num_instances = 0;
+    u32 num_vertices  = 0;
+    for (const gfx::MeshBatch& batch : batches) {
+        num_instances += batch.num_objects;
+        num_vertices += batch.num_objects * batch.mesh.get_num_vertices();
+    }
+
+    if (frame.num_instance_ranges_ + num_instances > MAX_OBJECTS) {
+        core_.get_logger().warn("could not add % instance ranges. current: %, max: %",
+                                num_instances,
+                                frame.num_instance_ranges_,
+                                MAX_OBJECTS);
+        group.num_vertices = 0;
+        return;
+    }
+
+    group.first_instance_range = frame.num_instance_ranges_;
+    group.first_vertex         = frame.num_flat_vertices_;
+    group.num_vertices         = num_vertices;
+
+    frame.num_instance_ranges_ += num_instances;
+    frame.num_flat_vertices_ += num_vertices;
+
+    if (!upload) {
+        return;
+    }
+
+    // staged like the buffer starts, the count followed by the group's ranges, so one copy writes both. The count
+    // bounds the vertex shader's search through the ranges
+    VkDeviceSize staged_size = sizeof(u32) + num_instances * sizeof(InstanceRange);
+    void*        staged      = frame_arena_.allocate(staged_size, alignof(InstanceRange));
+    std::memcpy(staged, &frame.num_instance_ranges_, sizeof(u32));
+
+    // prefix sum of vertex counts over all instances in the group
+    InstanceRange* ranges      = reinterpret_cast<InstanceRange*>(static_cast<char*>(staged) + sizeof(u32));
+    u32            flat_vertex = group.first_vertex;
+    for (const gfx::MeshBatch& batch : batches) {
+        for (u32 i = 0; i < batch.num_objects; ++i) {
+            InstanceRange& range = *ranges++;
+            range.object_index   = batch.first_object_idx + i;
+            range.mesh_index     = batch.mesh.get_index();
+            range.first_vertex   = flat_vertex;
+
+            flat_vertex += batch.mesh.get_num_vertices();
+        }
+    }
+
+    VkBufferCopy regions[2] = {};
+    regions[0].size         = sizeof(u32);
+    regions[1].srcOffset    = sizeof(u32);
+    regions[1].dstOffset    = sizeof(u32) + group.first_instance_range * sizeof(InstanceRange);
+    regions[1].size         = num_instances * sizeof(InstanceRange);
+    upload_to_buffer(staged, staged_size, frame.instance_ranges_, regions);
+}
+
 void GraphicsBackend::choose_physical_device() {
     // get physical devices
     u32 num_physical_devices;
@@ -359,7 +1058,10 @@ void GraphicsBackend::choose_physical_device() {
 
         for (u32 i = 0; i < num_queue_families; ++i) {
             if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                possible_graphics = i;
+                // prefer a graphics family that can run compute too, so compute passes can share its command buffer
+                if (!possible_graphics || (queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                    possible_graphics = i;
+                }
             }
 
             if (queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
@@ -383,9 +1085,10 @@ void GraphicsBackend::choose_physical_device() {
         }
 
         physical_device_       = possible_device;
-        graphics_family_index_ = *possible_graphics;
-        compute_family_index_  = *possible_compute;
-        present_family_index_  = *possible_present;
+        graphics_family_index_     = *possible_graphics;
+        compute_family_index_      = *possible_compute;
+        present_family_index_      = *possible_present;
+        graphics_supports_compute_ = queue_families[graphics_family_index_].queueFlags & VK_QUEUE_COMPUTE_BIT;
         break;
     }
 
@@ -410,15 +1113,104 @@ void GraphicsBackend::create_logical_device() {
         queue_infos[num_queue_infos++] = queue_info;
     }
 
+    // Vulkan 1.2 features are optional, enable the ones the device has
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device_, &properties);
+
+    // mesh shaders need SPIR-V 1.4, which is core in 1.2
+    std::vector<const char*> device_extensions(std::begin(g_required_device_extensions),
+                                               std::end(g_required_device_extensions));
+    bool has_mesh_shader_extension = false;
+    bool has_sync2_extension       = false;
+    if (properties.apiVersion >= VK_API_VERSION_1_2) {
+        u32 num_extensions;
+        vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &num_extensions, nullptr);
+        std::vector<VkExtensionProperties> extensions(num_extensions);
+        vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &num_extensions, extensions.data());
+
+        for (const VkExtensionProperties& extension : extensions) {
+            if (std::string_view(extension.extensionName) == VK_EXT_MESH_SHADER_EXTENSION_NAME) {
+                has_mesh_shader_extension = true;
+            } else if (std::string_view(extension.extensionName) == VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) {
+                has_sync2_extension = true;
+            }
+        }
+    }
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features = {};
+    mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {};
+    sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+    VkPhysicalDeviceVulkan11Features features_11 = {};
+    features_11.sType                            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+
+    VkPhysicalDeviceVulkan12Features features_12 = {};
+    features_12.sType                            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features_12.pNext                            = &features_11;
+    if (properties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceMeshShaderFeaturesEXT supported_mesh_shader_features = {};
+        supported_mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+        VkPhysicalDeviceSynchronization2FeaturesKHR supported_sync2_features = {};
+        supported_sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+        VkPhysicalDeviceVulkan11Features supported_features_11 = {};
+        supported_features_11.sType                            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+
+        VkPhysicalDeviceVulkan12Features supported_features_12 = {};
+        supported_features_12.sType                            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        supported_features_12.pNext                            = &supported_features_11;
+
+        // extension features can only be queried if the extension is there
+        void** supported_next = &supported_features_11.pNext;
+        if (has_mesh_shader_extension) {
+            *supported_next = &supported_mesh_shader_features;
+            supported_next  = &supported_mesh_shader_features.pNext;
+        }
+        if (has_sync2_extension) {
+            *supported_next = &supported_sync2_features;
+        }
+
+        VkPhysicalDeviceFeatures2 supported_features = {};
+        supported_features.sType                     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features.pNext                     = &supported_features_12;
+        vkGetPhysicalDeviceFeatures2(physical_device_, &supported_features);
+
+        features_12.drawIndirectCount = supported_features_12.drawIndirectCount;
+        features_11.multiview         = supported_features_11.multiview;
+
+        // only task and mesh shaders are used, the rest of the extension's features stay off
+        void** next = &features_11.pNext;
+        if (supported_mesh_shader_features.taskShader && supported_mesh_shader_features.meshShader) {
+            mesh_shader_features.taskShader = VK_TRUE;
+            mesh_shader_features.meshShader = VK_TRUE;
+            *next                           = &mesh_shader_features;
+            next                            = &mesh_shader_features.pNext;
+            device_extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        }
+        if (supported_sync2_features.synchronization2) {
+            sync2_features.synchronization2 = VK_TRUE;
+            *next                           = &sync2_features;
+            device_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        }
+    }
+    core_.get_logger().info("draw indirect count supported: %", features_12.drawIndirectCount ? "true" : "false");
+    core_.get_logger().info("mesh shaders supported: %", mesh_shader_features.meshShader ? "true" : "false");
+    core_.get_logger().info("multiview supported: %", features_11.multiview ? "true" : "false");
+    core_.get_logger().info("synchronization2 supported: %", sync2_features.synchronization2 ? "true" : "false");
+
     // Try to make device while going through supported feature sets from most optimal to least optimal
     for (const VkPhysicalDeviceFeatures& feature_set : g_possible_device_feature_sets) {
         VkDeviceCreateInfo device_info      = {};
         device_info.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        device_info.pNext                   = properties.apiVersion >= VK_API_VERSION_1_2 ? &features_12 : nullptr;
         device_info.pQueueCreateInfos       = queue_infos.data();
         device_info.queueCreateInfoCount    = num_queue_infos;
         device_info.pEnabledFeatures        = &feature_set;
-        device_info.enabledExtensionCount   = std::size(g_required_device_extensions);
-        device_info.ppEnabledExtensionNames = g_required_device_extensions;
+        device_info.enabledExtensionCount   = device_extensions.size();
+        device_info.ppEnabledExtensionNames = device_extensions.data();
 
         VkResult create_device_result = vkCreateDevice(physical_device_, &device_info, nullptr, &device_);
         if (create_device_result == VK_ERROR_FEATURE_NOT_PRESENT) {
@@ -426,7 +1218,9 @@ void GraphicsBackend::create_logical_device() {
             continue;
         } else {
             vk_check(create_device_result);
-            device_features_ = feature_set;
+            device_features_    = feature_set;
+            device_features_11_ = features_11;
+            device_features_12_ = features_12;
             cleanup_.emplace([=]() { vkDestroyDevice(device_, nullptr); });
             break;
         }
@@ -437,6 +1231,15 @@ void GraphicsBackend::create_logical_device() {
         core_.get_logger().fatal("could not create device: missing required features");
     }
 
+    if (mesh_shader_features.meshShader) {
+        cmd_draw_mesh_tasks_ =
+            reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device_, "vkCmdDrawMeshTasksEXT"));
+    }
+    if (sync2_features.synchronization2) {
+        cmd_pipeline_barrier_2_ =
+            reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(device_, "vkCmdPipelineBarrier2KHR"));
+    }
+
     vkGetDeviceQueue(device_, graphics_family_index_, 0, &graphics_queue_);
     vkGetDeviceQueue(device_, compute_family_index_, 0, &compute_queue_);
     vkGetDeviceQueue(device_, present_family_index_, 0, &present_queue_);
@@ -564,7 +1367,61 @@ void GraphicsBackend::create_swapchain() {
     }
 }
 
-void GraphicsBackend::one_time_submit(VkQueue queue, const std::function<void(VkCommandBuffer)>& cmd_recording_func) {
+void GraphicsBackend::create_depth_images() {
+    // depth has to be sampled for depth pyramids, use the first format that allows it
+    constexpr VkFormat possible_formats[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM};
+    constexpr VkFormatFeatureFlags required_features =
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+    VkFormat depth_format = VK_FORMAT_UNDEFINED;
+    for (VkFormat format : possible_formats) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device_, format, &properties);
+        if ((properties.optimalTilingFeatures & required_features) == required_features) {
+            depth_format = format;
+            break;
+        }
+    }
+
+    if (depth_format == VK_FORMAT_UNDEFINED) {
+        core_.get_logger().fatal("could not find a sampleable depth format");
+    }
+
+    depth_images_.resize(swapchain_images_.size());
+    for (Image& depth_image : depth_images_) {
+        depth_image = create_image_gpu(swapchain_extent_,
+                                       depth_format,
+                                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                       1,
+                                       VK_IMAGE_ASPECT_DEPTH_BIT);
+    }
+}
+
+void GraphicsBackend::create_visibility_id_images() {
+    visibility_id_images_.resize(swapchain_images_.size());
+    for (Image& visibility_id_image : visibility_id_images_) {
+        visibility_id_image = create_image_gpu(swapchain_extent_,
+                                               VISIBILITY_ID_FORMAT,
+                                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                               1,
+                                               VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+}
+
+void GraphicsBackend::create_gbuffer_images() {
+    gbuffer_images_.resize(swapchain_images_.size());
+    for (std::array<Image, MAX_COLOR_ATTACHMENTS>& images : gbuffer_images_) {
+        for (u32 i = 0; i < images.size(); ++i) {
+            images[i] = create_image_gpu(swapchain_extent_,
+                                         GBUFFER_FORMATS[i],
+                                         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                         1,
+                                         VK_IMAGE_ASPECT_COLOR_BIT);
+        }
+    }
+}
+
+void GraphicsBackend::one_time_submit(VkQueue queue, FunctionRef<void(VkCommandBuffer)> cmd_recording_func) {
     // todo: command pool for short-lived command buffers ?
 
     VkCommandBufferAllocateInfo alloc_info = {};
@@ -606,6 +1463,14 @@ GraphicsBackend::create_buffer_gpu(VkDeviceSize size, VkBufferUsageFlags buffer_
     buffer_ci.usage              = buffer_usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     buffer_ci.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
 
+    // async compute shares buffers with the graphics queue without transferring ownership back and forth
+    u32 queue_families[] = {graphics_family_index_, compute_family_index_};
+    if (graphics_family_index_ != compute_family_index_) {
+        buffer_ci.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+        buffer_ci.queueFamilyIndexCount = std::size(queue_families);
+        buffer_ci.pQueueFamilyIndices   = queue_families;
+    }
+
     Buffer buffer;
     buffer.range = size;
     vk_check(vmaCreateBuffer(allocator_,
@@ -626,13 +1491,28 @@ void GraphicsBackend::copy_to_buffer(const void*   src_data,
                                      VkDeviceSize  src_size,
                                      const Buffer& dst_buffer,
                                      VkDeviceSize  offset) {
+    VkBufferCopy region = {};
+    region.size         = src_size;
+    region.dstOffset    = offset;
+
+    copy_to_buffer(src_data, src_size, dst_buffer, std::span(&region, 1));
+}
+
+void GraphicsBackend::copy_to_buffer(const void*                   src_data,
+                                     VkDeviceSize                  src_size,
+                                     const Buffer&                 dst_buffer,
+                                     std::span<const VkBufferCopy> regions) {
     VkMemoryPropertyFlags mem_flags;
     vmaGetMemoryTypeProperties(allocator_, dst_buffer.allocation_info.memoryType, &mem_flags);
     if ((mem_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
         // we can just map memory
         void* dst_data;
         vmaMapMemory(allocator_, dst_buffer.allocation, &dst_data);
-        std::memcpy(static_cast<char*>(dst_data) + offset, src_data, src_size);
+        for (const VkBufferCopy& region : regions) {
+            std::memcpy(static_cast<char*>(dst_data) + region.dstOffset,
+                        static_cast<const char*>(src_data) + region.srcOffset,
+                        region.size);
+        }
         vmaUnmapMemory(allocator_, dst_buffer.allocation);
     } else {
         // we need a staging buffer
@@ -658,59 +1538,235 @@ void GraphicsBackend::copy_to_buffer(const void*   src_data,
         std::memcpy(staging_buffer.allocation_info.pMappedData, src_data, src_size);
 
         // copy data from staging buffer to buffer
-        one_time_submit(graphics_queue_, [=](VkCommandBuffer cmd) {
-            VkBufferCopy region = {};
-            region.size         = src_size;
-            region.dstOffset    = offset;
-
-            vkCmdCopyBuffer(cmd, staging_buffer.buffer, dst_buffer.buffer, 1, &region);
+        one_time_submit(graphics_queue_, [&](VkCommandBuffer cmd) {
+            vkCmdCopyBuffer(cmd, staging_buffer.buffer, dst_buffer.buffer, regions.size(), regions.data());
         });
 
         destroy_buffer(staging_buffer);
     }
 }
 
+void GraphicsBackend::upload_to_buffer(const void*   src_data,
+                                       VkDeviceSize  src_size,
+                                       const Buffer& dst_buffer,
+                                       VkDeviceSize  offset) {
+    VkBufferCopy region = {};
+    region.size         = src_size;
+    region.dstOffset    = offset;
+
+    upload_to_buffer(src_data, src_size, dst_buffer, std::span(&region, 1));
+}
+
+void GraphicsBackend::upload_to_buffer(const void*                   src_data,
+                                       VkDeviceSize                  src_size,
+                                       const Buffer&                 dst_buffer,
+                                       std::span<const VkBufferCopy> regions) {
+    PerFrame& frame = get_current_frame();
+    if (frame.staging_offset_ + src_size > frame.staging_.range) {
+        core_.get_logger().warn("could not upload % bytes. current: %, max: %",
+                                src_size,
+                                frame.staging_offset_,
+                                frame.staging_.range);
+        return;
+    }
+
+    std::memcpy(static_cast<char*>(frame.staging_.allocation_info.pMappedData) + frame.staging_offset_,
+                src_data,
+                src_size);
+
+    FrameVector<VkBufferCopy> staged_regions{FrameAllocator<VkBufferCopy>(frame_arena_)};
+    staged_regions.reserve(regions.size());
+    for (VkBufferCopy region : regions) {
+        region.srcOffset += frame.staging_offset_;
+        staged_regions.emplace_back(region);
+    }
+    frame.staging_offset_ += src_size;
+
+    if (!frame.has_uploads_) {
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vk_check(vkBeginCommandBuffer(frame.upload_command_buffer_, &begin_info));
+        frame.has_uploads_ = true;
+    }
+
+    vkCmdCopyBuffer(frame.upload_command_buffer_,
+                    frame.staging_.buffer,
+                    dst_buffer.buffer,
+                    staged_regions.size(),
+                    staged_regions.data());
+}
+
 void GraphicsBackend::destroy_buffer(const Buffer& buffer) {
     vmaDestroyBuffer(allocator_, buffer.buffer, buffer.allocation);
 }
 
-VkRenderPass GraphicsBackend::create_render_pass() {
-    VkAttachmentDescription color_attachment = {};
-    color_attachment.format                  = swapchain_format_.format;
-    color_attachment.samples                 = VK_SAMPLE_COUNT_1_BIT;
-    color_attachment.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    color_attachment.storeOp                 = VK_ATTACHMENT_STORE_OP_STORE;
-    color_attachment.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    color_attachment.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    color_attachment.initialLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout             = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+VkRenderPass GraphicsBackend::create_render_pass(ColorAttachment    color_attachment_type,
+                                                 VkAttachmentLoadOp load_op,
+                                                 bool               is_present_pass,
+                                                 u32                num_views) {
+    if (num_views > 1 && !supports_multiview()) {
+        core_.get_logger().fatal("could not create render pass with % views, multiview isn't supported", num_views);
+    }
+    if (num_views == 0 || num_views > MAX_VIEWS) {
+        core_.get_logger().fatal("could not create render pass with % views, needs between 1 and %",
+                                 num_views,
+                                 MAX_VIEWS);
+    }
 
-    VkAttachmentReference color_attachment_ref = {};
-    color_attachment_ref.attachment            = 0;
-    color_attachment_ref.layout                = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    // when loading, the previous pass left the attachments in the layouts it finished with below
+    bool is_loading = load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+
+    // the visibility buffer and g-buffer aren't presented, the last pass to draw to them leaves them to be shaded from.
+    // Neither are the layers of a multiview pass
+    bool          is_swapchain = color_attachment_type == ColorAttachment::SWAPCHAIN && num_views == 1;
+    VkImageLayout last_layout =
+        is_swapchain ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    // the color attachments followed by depth
+    u32 num_color_attachments = get_num_color_attachments(color_attachment_type);
+
+    VkAttachmentDescription attachments[MAX_COLOR_ATTACHMENTS + 1]       = {};
+    VkAttachmentReference   color_attachment_refs[MAX_COLOR_ATTACHMENTS] = {};
+
+    for (u32 i = 0; i < num_color_attachments; ++i) {
+        VkAttachmentDescription& color_attachment = attachments[i];
+        color_attachment.format                   = get_color_attachment_format(color_attachment_type, i);
+        color_attachment.samples                  = VK_SAMPLE_COUNT_1_BIT;
+        color_attachment.loadOp                   = load_op;
+        color_attachment.storeOp                  = VK_ATTACHMENT_STORE_OP_STORE;
+        color_attachment.stencilLoadOp            = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        color_attachment.stencilStoreOp           = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        color_attachment.initialLayout =
+            is_loading ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        color_attachment.finalLayout = is_present_pass ? last_layout : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        color_attachment_refs[i].attachment = i;
+        color_attachment_refs[i].layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
 
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments    = &color_attachment_ref;
+    // depth is always left readable by shaders, so that it can be used to build a depth pyramid
+    VkAttachmentDescription& depth_attachment = attachments[num_color_attachments];
+    depth_attachment.format                   = depth_images_.front().format;
+    depth_attachment.samples                  = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp                   = load_op;
+    depth_attachment.storeOp                  = VK_ATTACHMENT_STORE_OP_STORE;
+    depth_attachment.stencilLoadOp            = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp           = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout =
+        is_loading ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference depth_attachment_ref = {};
+    depth_attachment_ref.attachment            = num_color_attachments;
+    depth_attachment_ref.layout                = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass    = {};
+    subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount    = num_color_attachments;
+    subpass.pColorAttachments       = color_attachment_refs;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+    // depth is read by compute between passes and by earlier frames using the same swapchain image, the visibility
+    // buffer and g-buffer by the fragment shader that shades them
+    VkSubpassDependency dependencies[3] = {};
+    dependencies[0].srcSubpass          = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass          = 0;
+    dependencies[0].srcStageMask =
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask  = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass    = 0;
+    dependencies[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask  = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+    dependencies[2].srcSubpass    = 0;
+    dependencies[2].dstSubpass    = VK_SUBPASS_EXTERNAL;
+    dependencies[2].srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
     VkRenderPassCreateInfo render_pass_create_info = {};
     render_pass_create_info.sType                  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_create_info.pAttachments           = &color_attachment;
-    render_pass_create_info.attachmentCount        = 1;
+    render_pass_create_info.pAttachments           = attachments;
+    render_pass_create_info.attachmentCount        = num_color_attachments + 1;
     render_pass_create_info.pSubpasses             = &subpass;
     render_pass_create_info.subpassCount           = 1;
+    render_pass_create_info.pDependencies          = dependencies;
+    render_pass_create_info.dependencyCount        = std::size(dependencies);
+
+    // each view is drawn to its own layer of every attachment. The views are expected to see mostly the same things,
+    // like cascades or the eyes of a stereo pair, which the correlation mask tells the implementation
+    u32                             view_mask      = (1u << num_views) - 1;
+    VkRenderPassMultiviewCreateInfo multiview_info = {};
+    multiview_info.sType                           = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+    multiview_info.subpassCount                    = 1;
+    multiview_info.pViewMasks                      = &view_mask;
+    multiview_info.correlationMaskCount            = 1;
+    multiview_info.pCorrelationMasks               = &view_mask;
+    if (num_views > 1) {
+        render_pass_create_info.pNext = &multiview_info;
+    }
 
     VkRenderPass render_pass;
     vk_check(vkCreateRenderPass(device_, &render_pass_create_info, nullptr, &render_pass));
     return render_pass;
 }
 
-void GraphicsBackend::create_framebuffers(VkRenderPass render_pass, VkRect2D render_area) {
+void GraphicsBackend::create_framebuffers(VkRenderPass    render_pass,
+                                          ColorAttachment color_attachment,
+                                          VkRect2D        render_area,
+                                          u32             num_views) {
+    bool is_multiview = num_views > 1;
+    if (!is_multiview && color_attachment == ColorAttachment::VISIBILITY_ID && visibility_id_images_.empty()) {
+        create_visibility_id_images();
+    }
+    if (!is_multiview && color_attachment == ColorAttachment::GBUFFER && gbuffer_images_.empty()) {
+        create_gbuffer_images();
+    }
+
+    u32 num_color_attachments = get_num_color_attachments(color_attachment);
+
+    // a multiview pass gets its own attachments with a layer per view, in the formats the single view ones have
+    if (is_multiview) {
+        std::vector<std::array<Image, MAX_COLOR_ATTACHMENTS + 1>>& images = layered_images_[render_pass];
+        images.resize(swapchain_image_views_.size());
+        for (std::array<Image, MAX_COLOR_ATTACHMENTS + 1>& layered_images : images) {
+            for (u32 j = 0; j < num_color_attachments; ++j) {
+                layered_images[j] = create_image_gpu(render_area.extent,
+                                                     get_color_attachment_format(color_attachment, j),
+                                                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                     1,
+                                                     VK_IMAGE_ASPECT_COLOR_BIT,
+                                                     num_views);
+            }
+            // depth can be copied to and from, like the cached layers of shadow maps
+            layered_images[num_color_attachments] =
+                create_image_gpu(render_area.extent,
+                                 depth_images_.front().format,
+                                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                 1,
+                                 VK_IMAGE_ASPECT_DEPTH_BIT,
+                                 num_views);
+        }
+    }
+
     VkFramebufferCreateInfo framebuffer_create_info = {};
     framebuffer_create_info.sType                   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebuffer_create_info.renderPass              = render_pass;
-    framebuffer_create_info.attachmentCount         = 1;
+    framebuffer_create_info.attachmentCount         = num_color_attachments + 1;
     framebuffer_create_info.width                   = render_area.extent.width;
     framebuffer_create_info.height                  = render_area.extent.height;
     framebuffer_create_info.layers                  = 1;
@@ -720,11 +1776,48 @@ void GraphicsBackend::create_framebuffers(VkRenderPass render_pass, VkRect2D ren
     framebuffers = std::vector<VkFramebuffer>(swapchain_image_views_.size());
 
     for (u32 i = 0; i < swapchain_image_views_.size(); ++i) {
-        framebuffer_create_info.pAttachments = &swapchain_image_views_[i];
+        VkImageView attachments[MAX_COLOR_ATTACHMENTS + 1] = {};
+        if (is_multiview) {
+            for (u32 j = 0; j <= num_color_attachments; ++j) {
+                attachments[j] = layered_images_[render_pass][i][j].view;
+            }
+
+            framebuffer_create_info.pAttachments = attachments;
+            vk_check(vkCreateFramebuffer(device_, &framebuffer_create_info, nullptr, &framebuffers[i]));
+            continue;
+        }
+
+        for (u32 j = 0; j < num_color_attachments; ++j) {
+            switch (color_attachment) {
+            case ColorAttachment::SWAPCHAIN:
+                attachments[j] = swapchain_image_views_[i];
+                break;
+            case ColorAttachment::VISIBILITY_ID:
+                attachments[j] = visibility_id_images_[i].view;
+                break;
+            case ColorAttachment::GBUFFER:
+                attachments[j] = gbuffer_images_[i][j].view;
+                break;
+            }
+        }
+        attachments[num_color_attachments] = depth_images_[i].view;
+
+        framebuffer_create_info.pAttachments = attachments;
         vk_check(vkCreateFramebuffer(device_, &framebuffer_create_info, nullptr, &framebuffers[i]));
     }
 }
 
+VkFormat GraphicsBackend::get_color_attachment_format(ColorAttachment color_attachment, u32 index) const {
+    switch (color_attachment) {
+    case ColorAttachment::VISIBILITY_ID:
+        return VISIBILITY_ID_FORMAT;
+    case ColorAttachment::GBUFFER:
+        return GBUFFER_FORMATS[index];
+    default:
+        return swapchain_format_.format;
+    }
+}
+
 VkFramebuffer GraphicsBackend::get_framebuffer(VkRenderPass render_pass) {
     return framebuffers_.at(render_pass).at(swap_image_index_);
 }
@@ -743,10 +1836,17 @@ VkPipelineLayout GraphicsBackend::create_pipeline_layout(const VkPipelineLayoutC
 }
 
 VkPipeline GraphicsBackend::create_graphics_pipeline(const std::vector<ShaderInfo>& shaders,
+                                                     const DepthState&              depth_state,
+                                                     bool                           is_blended,
                                                      VkPipelineLayout               pipeline_layout,
-                                                     VkRenderPass                   render_pass) {
+                                                     VkRenderPass                   render_pass,
+                                                     u32                            num_color_attachments) {
+    bool has_fragment_shader = false;
+
     std::vector<VkPipelineShaderStageCreateInfo> stages(shaders.size());
     for (u32 i = 0; i < shaders.size(); ++i) {
+        has_fragment_shader |= shaders[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT;
+
         stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         stages[i].pName = "main";
         stages[i].stage = shaders[i].stage;
@@ -787,6 +1887,8 @@ VkPipeline GraphicsBackend::create_graphics_pipeline(const std::vector<ShaderInf
     viewport_state.scissorCount                      = 1;
     viewport_state.pScissors                         = &scissor;
 
+    bool has_depth_bias = depth_state.constant_bias != 0.0f || depth_state.slope_bias != 0.0f;
+
     VkPipelineRasterizationStateCreateInfo rasterization = {};
     rasterization.sType                                  = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterization.depthClampEnable                       = VK_FALSE;
@@ -795,28 +1897,43 @@ VkPipeline GraphicsBackend::create_graphics_pipeline(const std::vector<ShaderInf
     rasterization.lineWidth                              = 1.0f;
     rasterization.cullMode                               = VK_CULL_MODE_BACK_BIT;
     rasterization.frontFace                              = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterization.depthBiasEnable                        = VK_FALSE;
+    rasterization.depthBiasEnable                        = has_depth_bias;
+    rasterization.depthBiasConstantFactor                = depth_state.constant_bias;
+    rasterization.depthBiasSlopeFactor                   = depth_state.slope_bias;
 
     VkPipelineMultisampleStateCreateInfo multisample = {};
     multisample.sType                                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisample.rasterizationSamples                 = VK_SAMPLE_COUNT_1_BIT;
     multisample.minSampleShading                     = 1.0f;
 
-    VkPipelineColorBlendAttachmentState blend_attachment = {};
-    blend_attachment.colorWriteMask =
-        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    blend_attachment.blendEnable         = VK_TRUE;
-    blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blend_attachment.colorBlendOp        = VK_BLEND_OP_ADD;
-    blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blend_attachment.alphaBlendOp        = VK_BLEND_OP_ADD;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType                                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable                       = depth_state.test;
+    depth_stencil.depthWriteEnable                      = depth_state.write;
+    depth_stencil.depthCompareOp                        = depth_state.compare_op;
+
+    VkPipelineColorBlendAttachmentState blend_attachments[MAX_COLOR_ATTACHMENTS] = {};
+    for (VkPipelineColorBlendAttachmentState& blend_attachment : blend_attachments) {
+        blend_attachment.colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        if (!has_fragment_shader) {
+            blend_attachment.colorWriteMask = 0; // depth only, there's no color to write
+        }
+        blend_attachment.blendEnable = is_blended;
+
+        // the color is blended by its alpha, the alpha is kept as coverage
+        blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend_attachment.colorBlendOp        = VK_BLEND_OP_ADD;
+        blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blend_attachment.alphaBlendOp        = VK_BLEND_OP_ADD;
+    }
 
     VkPipelineColorBlendStateCreateInfo color_blend_state = {};
     color_blend_state.sType                               = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    color_blend_state.attachmentCount                     = 1;
-    color_blend_state.pAttachments                        = &blend_attachment;
+    color_blend_state.attachmentCount                     = num_color_attachments;
+    color_blend_state.pAttachments                        = blend_attachments;
 
     VkDynamicState                   dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
     VkPipelineDynamicStateCreateInfo dynamic_state    = {};
@@ -833,7 +1950,7 @@ VkPipeline GraphicsBackend::create_graphics_pipeline(const std::vector<ShaderInf
     graphics_pipeline_ci.pViewportState               = &viewport_state;
     graphics_pipeline_ci.pRasterizationState          = &rasterization;
     graphics_pipeline_ci.pMultisampleState            = &multisample;
-    graphics_pipeline_ci.pDepthStencilState           = nullptr;
+    graphics_pipeline_ci.pDepthStencilState           = &depth_stencil;
     graphics_pipeline_ci.pColorBlendState             = &color_blend_state;
     graphics_pipeline_ci.pDynamicState                = &dynamic_state;
     graphics_pipeline_ci.layout                       = pipeline_layout;
@@ -853,6 +1970,152 @@ VkPipeline GraphicsBackend::create_graphics_pipeline(const std::vector<ShaderInf
     return pipeline;
 }
 
+VkPipeline GraphicsBackend::create_compute_pipeline(const ShaderInfo& shader, VkPipelineLayout pipeline_layout) {
+    std::vector<char> code = utils::load_binary_file(shader.path);
+
+    VkShaderModuleCreateInfo shader_module_create_info = {};
+    shader_module_create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_module_create_info.codeSize                 = code.size();
+    shader_module_create_info.pCode                    = reinterpret_cast<const uint32_t*>(code.data());
+
+    VkShaderModule module;
+    vk_check(vkCreateShaderModule(device_, &shader_module_create_info, nullptr, &module));
+
+    VkComputePipelineCreateInfo compute_pipeline_ci = {};
+    compute_pipeline_ci.sType                       = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    compute_pipeline_ci.stage.sType                 = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    compute_pipeline_ci.stage.stage                 = shader.stage;
+    compute_pipeline_ci.stage.module                = module;
+    compute_pipeline_ci.stage.pName                 = "main";
+    compute_pipeline_ci.layout                      = pipeline_layout;
+    compute_pipeline_ci.basePipelineHandle          = VK_NULL_HANDLE;
+    compute_pipeline_ci.basePipelineIndex           = -1;
+
+    VkPipeline pipeline;
+    vk_check(vkCreateComputePipelines(device_, VK_NULL_HANDLE, 1, &compute_pipeline_ci, nullptr, &pipeline));
+    cleanup_.emplace([=] { vkDestroyPipeline(device_, pipeline, nullptr); });
+
+    vkDestroyShaderModule(device_, module, nullptr);
+
+    return pipeline;
+}
+
+VkSampler GraphicsBackend::create_sampler(const VkSamplerCreateInfo& sampler_info) {
+    VkSampler sampler;
+    vk_check(vkCreateSampler(device_, &sampler_info, nullptr, &sampler));
+    cleanup_.emplace([=] { vkDestroySampler(device_, sampler, nullptr); });
+    return sampler;
+}
+
+Buffer GraphicsBackend::create_storage_buffer_gpu(VkDeviceSize size, VkBufferUsageFlags usage) {
+    return create_buffer_gpu(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage, BufferDestroyPolicy::AUTOMATIC_DESTROY);
+}
+
+Image GraphicsBackend::create_image_gpu(VkExtent2D         extent,
+                                        VkFormat           format,
+                                        VkImageUsageFlags  usage,
+                                        u32                mip_levels,
+                                        VkImageAspectFlags aspect,
+                                        u32                num_layers) {
+    VmaAllocationCreateInfo alloc_ci = {};
+    alloc_ci.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    VkImageCreateInfo image_ci = {};
+    image_ci.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_ci.imageType         = VK_IMAGE_TYPE_2D;
+    image_ci.format            = format;
+    image_ci.extent            = {extent.width, extent.height, 1};
+    image_ci.mipLevels         = mip_levels;
+    image_ci.arrayLayers       = num_layers;
+    image_ci.samples           = VK_SAMPLE_COUNT_1_BIT;
+    image_ci.tiling            = VK_IMAGE_TILING_OPTIMAL;
+    image_ci.usage             = usage;
+    image_ci.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+    image_ci.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    Image image;
+    image.format     = format;
+    image.extent     = extent;
+    image.mip_levels = mip_levels;
+    image.num_layers = num_layers;
+    vk_check(vmaCreateImage(allocator_, &image_ci, &alloc_ci, &image.image, &image.allocation, nullptr));
+    cleanup_.emplace([=] { vmaDestroyImage(allocator_, image.image, image.allocation); });
+
+    image.view = create_image_view(image, aspect, 0, mip_levels);
+
+    return image;
+}
+
+Image GraphicsBackend::create_image_unbound(VkExtent2D            extent,
+                                            VkFormat              format,
+                                            VkImageUsageFlags     usage,
+                                            u32                   mip_levels,
+                                            VkMemoryRequirements& requirements) {
+    VkImageCreateInfo image_ci = {};
+    image_ci.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_ci.imageType         = VK_IMAGE_TYPE_2D;
+    image_ci.format            = format;
+    image_ci.extent            = {extent.width, extent.height, 1};
+    image_ci.mipLevels         = mip_levels;
+    image_ci.arrayLayers       = 1;
+    image_ci.samples           = VK_SAMPLE_COUNT_1_BIT;
+    image_ci.tiling            = VK_IMAGE_TILING_OPTIMAL;
+    image_ci.usage             = usage;
+    image_ci.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+    image_ci.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    Image image;
+    image.format     = format;
+    image.extent     = extent;
+    image.mip_levels = mip_levels;
+    vk_check(vkCreateImage(device_, &image_ci, nullptr, &image.image));
+    cleanup_.emplace([=] { vkDestroyImage(device_, image.image, nullptr); });
+
+    vkGetImageMemoryRequirements(device_, image.image, &requirements);
+
+    return image;
+}
+
+VmaAllocation GraphicsBackend::allocate_image_memory(const VkMemoryRequirements& requirements) {
+    VmaAllocationCreateInfo alloc_ci = {};
+    alloc_ci.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    VmaAllocation allocation;
+    vk_check(vmaAllocateMemory(allocator_, &requirements, &alloc_ci, &allocation, nullptr));
+    cleanup_.emplace([=] { vmaFreeMemory(allocator_, allocation); });
+
+    return allocation;
+}
+
+void GraphicsBackend::bind_image_memory(Image&             image,
+                                        VmaAllocation      allocation,
+                                        VkDeviceSize       offset,
+                                        VkImageAspectFlags aspect) {
+    vk_check(vmaBindImageMemory2(allocator_, allocation, offset, image.image, nullptr));
+    image.view = create_image_view(image, aspect, 0, image.mip_levels);
+}
+
+VkImageView
+GraphicsBackend::create_image_view(const Image& image, VkImageAspectFlags aspect, u32 base_mip, u32 num_mips) {
+    VkImageViewType view_type = image.num_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+
+    VkImageViewCreateInfo image_view_create_info           = {};
+    image_view_create_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    image_view_create_info.image                           = image.image;
+    image_view_create_info.viewType                        = view_type;
+    image_view_create_info.format                          = image.format;
+    image_view_create_info.subresourceRange.aspectMask     = aspect;
+    image_view_create_info.subresourceRange.baseMipLevel   = base_mip;
+    image_view_create_info.subresourceRange.levelCount     = num_mips;
+    image_view_create_info.subresourceRange.baseArrayLayer = 0;
+    image_view_create_info.subresourceRange.layerCount     = image.num_layers;
+
+    VkImageView view;
+    vk_check(vkCreateImageView(device_, &image_view_create_info, nullptr, &view));
+    cleanup_.emplace([=] { vkDestroyImageView(device_, view, nullptr); });
+    return view;
+}
+
 VkDescriptorSet GraphicsBackend::get_descriptor_set(VkDescriptorSetLayout layout) {
     VkDescriptorSet set = VK_NULL_HANDLE;
 
@@ -876,8 +2139,8 @@ VkDescriptorSet GraphicsBackend::get_descriptor_set(VkDescriptorSetLayout layout
     return set;
 }
 
-void GraphicsBackend::update_descriptor_sets(const std::vector<VkWriteDescriptorSet>& writes) {
-    vkUpdateDescriptorSets(device_, writes.size(), writes.data(), 0, nullptr);
+void GraphicsBackend::update_descriptor_sets(const VkWriteDescriptorSet* writes, u32 num_writes) {
+    vkUpdateDescriptorSets(device_, num_writes, writes, 0, nullptr);
 }
 
 } // namespace rune::gfx
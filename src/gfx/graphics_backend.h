@@ -1,12 +1,18 @@
 #ifndef RUNE_GRAPHICS_BACKEND_H
 #define RUNE_GRAPHICS_BACKEND_H
 
+#include "frame_arena.h"
+#include "gfx/image.h"
+#include "gfx/mesh_simplifier.h"
+#include "gfx/meshlet_builder.h"
 #include "gfx/render_pass.h"
 #include "types.h"
 #include "vertex.h"
 
+#include <array>
 #include <functional>
 #include <glm/glm.hpp>
+#include <span>
 #include <stack>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.h>
@@ -21,13 +27,167 @@ class Core;
 
 namespace rune::gfx {
 
+// matches ObjectData in object_data.glsl, std430
 struct ObjectData {
     glm::mat4 model_matrix;
+    u32       mesh_index;
+    u32       batch_index; // index of the object's batch within its batch group
+    u32       material_index;
+    u32       visibility_index; // the object's entry in the visibility buffer, the same every frame the object is drawn
+};
+
+// a material texture index that refers to no texture
+constexpr u32 NO_TEXTURE = ~0u;
+
+// matches MaterialData in material.glsl, std430
+struct MaterialData {
+    glm::vec4 base_color      = glm::vec4(1.0f);
+    f32       roughness       = 1.0f;
+    f32       metallic        = 0.0f;
+
+    // indices into a texture table for when there is one, the shaders don't sample them yet
+    u32 diffuse_texture = NO_TEXTURE;
+    u32 normal_texture  = NO_TEXTURE;
+};
+
+/**
+ * How a material's surfaces are drawn and shaded
+ */
+struct MaterialDesc {
+    // the pipeline state the material is drawn with, draws are grouped by it before anything else so each pipeline is
+    // bound once. Less than 256, see DrawKey
+    u32          pipeline = 0;
+    MaterialData data;
+};
+
+/**
+ * Refers to a material in the GPU material buffer. Default constructed it's the default material, which every
+ * RenderObject starts out with
+ */
+struct Material {
+    static constexpr u32 DEFAULT_INDEX = 0;
+
+    Material() = default;
+    Material(u32 index, u32 pipeline) : index_(index), pipeline_(pipeline) {}
+
+    [[nodiscard]] u32 get_index() const {
+        return index_;
+    }
+
+    [[nodiscard]] u32 get_pipeline() const {
+        return pipeline_;
+    }
+
+    bool operator==(const Material& rhs) const {
+        return index_ == rhs.index_;
+    }
+    bool operator!=(const Material& rhs) const {
+        return !(rhs == *this);
+    }
+
+  private:
+    u32 index_    = DEFAULT_INDEX;
+    u32 pipeline_ = 0;
+};
+
+// matches PointLight in lights.glsl, std430
+struct PointLight {
+    glm::vec3 position;
+    f32       radius; // the light has no effect past this distance
+    glm::vec3 color;
+    f32       intensity;
+};
+
+// matches DirectionalLight in lights.glsl, std430
+struct DirectionalLight {
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f); // the way the light travels, like the sun's
+    f32       intensity = 0.0f;                         // off until it's set
+    glm::vec3 color     = glm::vec3(1.0f);
+    f32       padding_  = 0.0f;
+};
+
+// the most cascades a directional light's shadow map has, keep in sync with lights.glsl
+constexpr u32 MAX_SHADOW_CASCADES = 4;
+
+// matches DirectionalLightData in lights.glsl, std430
+struct DirectionalLightData {
+    DirectionalLight light;
+    glm::mat4        cascades[MAX_SHADOW_CASCADES]; // world space to the shadow map of each cascade, smallest first
+    u32              num_cascades;                  // 0 if the light casts no shadows
+    u32              padding_[3];
+};
+
+// lights are binned into screen tiles of this many pixels on a side, keep in sync with lights.glsl
+constexpr u32 LIGHT_TILE_SIZE = 16;
+// the lights a tile can hold, more than that are dropped. Keep in sync with lights.glsl
+constexpr u32 MAX_LIGHTS_PER_TILE = 255;
+
+// lights are also binned into a grid of clusters over the view frustum, split evenly on screen and exponentially in
+// depth between the camera's near and far planes. Keep in sync with lights.glsl
+constexpr u32 LIGHT_CLUSTERS_X          = 16;
+constexpr u32 LIGHT_CLUSTERS_Y          = 9;
+constexpr u32 LIGHT_CLUSTERS_Z          = 24;
+constexpr u32 MAX_LIGHTS_PER_CLUSTER    = 127;
+constexpr u32 LIGHT_CLUSTER_HEADER_SIZE = 32; // the grid's parameters, in bytes before the clusters
+
+// the most views a multiview pass can draw at once, maxMultiviewViewCount is at least this on every device that
+// supports multiview
+constexpr u32 MAX_VIEWS = 6;
+
+// a visibility buffer id packs an object index above the triangle's index in the unified vertex buffer, keep in sync
+// with visibility.glsl
+constexpr u32 VISIBILITY_TRIANGLE_BITS = 20;
+
+/**
+ * One level of detail of a mesh, a vertex range that's used once its error is small enough on screen
+ */
+struct MeshLod {
+    u32 first_vertex;
+    u32 num_vertices;
+    f32 error; // how far this lod's surface is from the full detail mesh, in model space
+    u32 padding_;
+};
+
+/**
+ * An entry in the GPU mesh table, indexed by Mesh::get_index(). Matches MeshData in mesh_table.glsl, std430
+ */
+struct MeshData {
+    glm::vec4 bounding_sphere; // xyz is the center, w is the radius, in model space
+    u32       num_lods;
+    u32       first_meshlet; // the meshlets of lods[0] in the meshlet buffer
+    u32       num_meshlets;
+    u32       padding_;
+    MeshLod   lods[MAX_MESH_LODS]; // from most to least detailed, lods[0] is the full detail mesh
+};
+
+/**
+ * Vertices for one level of detail of a mesh being loaded
+ */
+struct MeshLodDesc {
+    const Vertex* vertices     = nullptr;
+    u32           num_vertices = 0;
+    f32           error        = 0.0f; // see MeshLod::error
+};
+
+/**
+ * Maps an instance to its mesh and its position in the flattened vertex range of a single-draw batch group
+ */
+struct InstanceRange {
+    u32 object_index;
+    u32 mesh_index;
+    u32 first_vertex;
 };
 
 struct Mesh {
-    Mesh() : Mesh(0, 0) {}
-    Mesh(u32 first_vertex, u32 num_vertices) : first_vertex_(first_vertex), num_vertices_(num_vertices) {}
+    static constexpr u32 INVALID_INDEX = UINT32_MAX;
+
+    Mesh() : Mesh(INVALID_INDEX, 0, 0) {}
+    Mesh(u32 index, u32 first_vertex, u32 num_vertices)
+        : first_vertex_(first_vertex), num_vertices_(num_vertices), index_(index) {}
+
+    [[nodiscard]] u32 get_index() const {
+        return index_;
+    }
 
     [[nodiscard]] u32 get_first_vertex() const {
         return first_vertex_;
@@ -56,17 +216,28 @@ struct Mesh {
         };
         u64 id_;
     };
+    u32 index_;
 };
 
 struct MeshBatch {
-    u32  first_object_idx = 0;
-    u32  num_objects      = 0;
-    Mesh mesh;
+    u32      first_object_idx = 0;
+    u32      num_objects      = 0;
+    Mesh     mesh;
+    Material material;
 };
 
 struct BatchGroup {
     u32 first_batch = 0;
     u32 num_batches = 0;
+
+    // flattened vertex range used when drawing without multiDrawIndirect
+    u32 first_instance_range = 0;
+    u32 first_vertex         = 0;
+    u32 num_vertices         = 0;
+
+    // if set, the number of draws is read from this buffer on the gpu and num_batches is the maximum
+    VkBuffer     count_buffer = VK_NULL_HANDLE;
+    VkDeviceSize count_offset = 0;
 };
 
 class GraphicsBackend {
@@ -94,6 +265,24 @@ class GraphicsBackend {
         return get_current_frame().command_buffer_;
     }
 
+    /**
+     * Get the current frame's command buffer for the compute queue. It's submitted before the graphics work in
+     * end_frame, so it can run alongside the tail of the previous frame's graphics work, and the graphics work waits
+     * for it at the given stages
+     * @note Buffers can be used from both queues, images can't
+     * @param graphics_wait_stages The stages of this frame's graphics work that use its results
+     * @return The compute command buffer, begun on its first use in a frame
+     */
+    VkCommandBuffer get_async_compute_command_buffer(VkPipelineStageFlags graphics_wait_stages);
+
+    /**
+     * Get the arena for temporaries during the current frame, it's reset in begin_frame
+     * @return The frame arena
+     */
+    FrameArena& get_frame_arena() {
+        return frame_arena_;
+    }
+
     Buffer get_unified_vertex_buffer() {
         return unified_vertex_buffer_;
     }
@@ -102,31 +291,482 @@ class GraphicsBackend {
         return get_current_frame().object_data_;
     }
 
+    Buffer get_draw_data_buffer() {
+        return get_current_frame().draw_data_;
+    }
+
+    Buffer get_draw_count_buffer() {
+        return get_current_frame().draw_counts_;
+    }
+
+    Buffer get_mesh_table_buffer() {
+        return mesh_table_buffer_;
+    }
+
+    /**
+     * Get the mesh table entry of a loaded mesh, for work on the cpu that needs its bounds or lods
+     * @param mesh_index The index of the mesh, see Mesh::get_index
+     */
+    [[nodiscard]] const MeshData& get_mesh_data(u32 mesh_index) const {
+        return mesh_table_[mesh_index];
+    }
+
+    /**
+     * Get the parameters of every material, indexed by Material::get_index()
+     */
+    Buffer get_material_buffer() {
+        return material_buffer_;
+    }
+
+    Buffer get_instance_range_buffer() {
+        return get_current_frame().instance_ranges_;
+    }
+
+    Buffer get_culled_object_data_buffer() {
+        return get_current_frame().culled_object_data_;
+    }
+
+    Buffer get_visible_count_buffer() {
+        return get_current_frame().visible_counts_;
+    }
+
+    /**
+     * Get this frame's lights, see update_light_data
+     */
+    Buffer get_light_data_buffer() {
+        return get_current_frame().light_data_;
+    }
+
+    /**
+     * Get this frame's view-projection matrices for multiview passes, see add_views
+     */
+    Buffer get_view_buffer() {
+        return get_current_frame().views_;
+    }
+
+    /**
+     * Get this frame's directional light and its shadow cascades, see update_directional_light
+     */
+    Buffer get_directional_light_buffer() {
+        return get_current_frame().directional_light_;
+    }
+
+    [[nodiscard]] u32 get_num_lights() {
+        return get_current_frame().num_lights_;
+    }
+
+    /**
+     * Get this frame's light lists of the screen tiles, written on the gpu. Tiles are LIGHT_TILE_SIZE pixels on a side
+     * and stored in rows of get_num_light_tiles().width, each is a light count followed by MAX_LIGHTS_PER_TILE indices
+     * into the light data
+     */
+    Buffer get_light_tile_buffer() {
+        return get_current_frame().light_tiles_;
+    }
+
+    /**
+     * Get this frame's light lists of the clusters, written on the gpu. The grid's parameters come first, then each
+     * cluster in x, y, z order is a light count followed by MAX_LIGHTS_PER_CLUSTER indices into the light data.
+     * See LightClusterBuffer in lights.glsl
+     */
+    Buffer get_light_cluster_buffer() {
+        return get_current_frame().light_clusters_;
+    }
+
+    /**
+     * Get the number of light tiles along each side of the swapchain image
+     */
+    [[nodiscard]] VkExtent2D get_num_light_tiles() const {
+        return {(swapchain_extent_.width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE,
+                (swapchain_extent_.height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE};
+    }
+
+    /**
+     * Get the meshlets of every loaded mesh, see MeshData::first_meshlet
+     */
+    Buffer get_meshlet_buffer() {
+        return meshlet_buffer_;
+    }
+
+    /**
+     * Get the vertex indices the meshlets refer to, they index the unified vertex buffer
+     */
+    Buffer get_meshlet_vertex_buffer() {
+        return meshlet_vertex_buffer_;
+    }
+
+    /**
+     * Get the triangles of the meshlets, see MeshletMesh::triangles
+     */
+    Buffer get_meshlet_triangle_buffer() {
+        return meshlet_triangle_buffer_;
+    }
+
+    /**
+     * Get this frame's list of meshlets that passed culling on the gpu, for drawing meshlets without mesh shaders.
+     * It's a VkDrawIndirectCommand that draws the list followed by an object index and meshlet index for each entry
+     */
+    Buffer get_visible_meshlet_buffer() {
+        return get_current_frame().visible_meshlets_;
+    }
+
+    /**
+     * Get the buffer that remembers which objects were visible, it's kept between frames
+     */
+    Buffer get_visibility_buffer() {
+        return visibility_buffer_;
+    }
+
+    /**
+     * Get the depth attachment used with the current swapchain image
+     */
+    const Image& get_depth_image() {
+        return depth_images_[swap_image_index_];
+    }
+
+    /**
+     * Get the visibility buffer used with the current swapchain image, a triangle id per pixel written by passes
+     * drawing to ColorAttachment::VISIBILITY_ID. Left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL by the last of them
+     */
+    const Image& get_visibility_id_image() {
+        return visibility_id_images_[swap_image_index_];
+    }
+
+    /**
+     * Get an image of the g-buffer used with the current swapchain image, written by passes drawing to
+     * ColorAttachment::GBUFFER. Left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL by the last of them
+     * @param attachment Which of the images
+     */
+    const Image& get_gbuffer_image(GBufferAttachment attachment) {
+        return gbuffer_images_[swap_image_index_][(u32)attachment];
+    }
+
+    /**
+     * Whether vkCmdDrawIndirectCount is available. If not, batch groups with a gpu count fall back to drawing every
+     * reserved slot
+     */
+    [[nodiscard]] bool supports_draw_indirect_count() const {
+        return device_features_12_.drawIndirectCount;
+    }
+
+    /**
+     * Whether batch groups are drawn with a single multi-draw indirect call. If not, they are drawn as one
+     * non-indexed draw over a flattened vertex range and need a vertex shader that reads the mesh table and instance
+     * ranges, see triangle_single_draw.vert
+     */
+    [[nodiscard]] bool supports_multi_draw_indirect() const {
+        return device_features_.multiDrawIndirect;
+    }
+
+    /**
+     * Whether batch groups can be culled on the gpu, see GpuCulling. Needs multiDrawIndirect to draw the compacted
+     * draws and compute on the graphics queue to record the culling in the frame's command buffer
+     */
+    [[nodiscard]] bool supports_gpu_culling() const {
+        return supports_multi_draw_indirect() && graphics_supports_compute_;
+    }
+
+    /**
+     * Whether work from get_async_compute_command_buffer runs on its own queue. If not, it still works but runs on the
+     * graphics queue ahead of the frame's graphics work
+     */
+    [[nodiscard]] bool supports_async_compute() const {
+        return compute_queue_ != graphics_queue_;
+    }
+
+    /**
+     * Whether VK_EXT_mesh_shader's task and mesh shaders are available, see draw_mesh_tasks
+     */
+    [[nodiscard]] bool supports_mesh_shaders() const {
+        return cmd_draw_mesh_tasks_ != nullptr;
+    }
+
+    /**
+     * Whether VK_KHR_synchronization2 is enabled, see pipeline_barrier
+     */
+    [[nodiscard]] bool supports_synchronization2() const {
+        return cmd_pipeline_barrier_2_ != nullptr;
+    }
+
+    /**
+     * Whether meshes can be drawn as meshlets, see MeshletPass. Without mesh shaders the meshlets are culled by
+     * compute on the graphics queue
+     */
+    [[nodiscard]] bool supports_meshlets() const {
+        return supports_mesh_shaders() || graphics_supports_compute_;
+    }
+
+    /**
+     * Whether graphics passes can draw several views at once, see GraphicsPassDesc::num_views
+     */
+    [[nodiscard]] bool supports_multiview() const {
+        return device_features_11_.multiview;
+    }
+
+    /**
+     * Record launching task shader workgroups, or mesh shader workgroups if the pipeline has no task shader
+     * @note Check supports_mesh_shaders before using
+     * @param cmd The command buffer to record to
+     * @param x The number of workgroups along x
+     * @param y The number of workgroups along y
+     */
+    void draw_mesh_tasks(VkCommandBuffer cmd, u32 x, u32 y) {
+        cmd_draw_mesh_tasks_(cmd, x, y, 1);
+    }
+
     void update_object_data(const std::vector<ObjectData>& data) {
         update_object_data(data.data(), data.size());
     }
 
-    void update_object_data(const ObjectData* data, u32 num_objects);
+    /**
+     * Update a range of this frame's object data
+     * @param data The objects
+     * @param num_objects The number of objects
+     * @param first_object Where the range starts in the object data
+     */
+    void update_object_data(const ObjectData* data, u32 num_objects, u32 first_object = 0);
+
+    /**
+     * Update scattered objects of this frame's object data, in a single copy
+     * @param data The objects, one for each index
+     * @param indices Where each object goes in the object data, in increasing order
+     */
+    void update_object_data(std::span<const ObjectData> data, std::span<const u32> indices);
+
+    /**
+     * Replace this frame's lights
+     * @param lights The lights, only the first MAX_LIGHTS are kept
+     */
+    void update_light_data(std::span<const PointLight> lights);
 
-    Mesh load_mesh(const std::vector<Vertex>& vertices) {
-        return load_mesh(vertices.data(), vertices.size());
+    /**
+     * Replace this frame's directional light
+     * @param data The light, with the shadow cascades it's tested against if it casts shadows
+     */
+    void update_directional_light(const DirectionalLightData& data);
+
+    /**
+     * Add the views of a multiview pass to this frame's view buffer, its shaders read a view's matrix at the returned
+     * index plus gl_ViewIndex
+     * @param view_projections A view-projection matrix per view, at most MAX_VIEWS
+     * @return The index of the first view in get_view_buffer(), or ~0u if the buffer is full
+     */
+    u32 add_views(std::span<const glm::mat4> view_projections);
+
+    /**
+     * Get the number of frames that can be in flight, each has its own copy of the per frame buffers like the object
+     * data
+     */
+    [[nodiscard]] static constexpr u32 get_num_frames_in_flight() {
+        return NUM_FRAMES_IN_FLIGHT;
+    }
+
+    /**
+     * Get the number of draws every batch group of a frame shares, see add_batches and reserve_batches
+     */
+    [[nodiscard]] static constexpr u32 get_max_draws() {
+        return MAX_DRAWS;
+    }
+
+    /**
+     * Get the number of objects a frame's object data has room for, see update_object_data
+     */
+    [[nodiscard]] static constexpr u32 get_max_objects() {
+        return MAX_OBJECTS;
     }
 
-    Mesh load_mesh(const Vertex* data, u32 num_vertices);
+    /**
+     * Get which of the frames in flight is the current one, less than get_num_frames_in_flight
+     */
+    [[nodiscard]] u32 get_frame_index() const {
+        return current_frame_;
+    }
+
+    Mesh load_mesh(const std::vector<Vertex>& vertices, const char* baked_lods_path = nullptr) {
+        return load_mesh(vertices.data(), vertices.size(), baked_lods_path);
+    }
+
+    /**
+     * Load a mesh with its levels of detail. They're read from the file mesh_lod_baker wrote for it if there is one
+     * and it was baked from the same vertices, otherwise they're generated with build_lod_chain. Small meshes only get
+     * the one level
+     * @param data A triangle list
+     * @param num_vertices The number of vertices
+     * @param baked_lods_path The .lods file baked for the mesh, see load_lod_chain. nullptr to always generate them
+     * @return The mesh, or an invalid mesh if it couldn't be loaded
+     */
+    Mesh load_mesh(const Vertex* data, u32 num_vertices, const char* baked_lods_path = nullptr);
+
+    /**
+     * Load a mesh with a chain of levels of detail, gpu culling picks one per instance from its size on screen.
+     * The first lod is also split into meshlets
+     * @note The returned Mesh refers to the first lod, which is what's drawn without gpu culling
+     * @param lods The levels of detail from most to least detailed, with increasing errors. At most MAX_MESH_LODS
+     * @return The mesh, or an invalid mesh if it couldn't be loaded
+     */
+    Mesh load_mesh(std::span<const MeshLodDesc> lods);
+
+    /**
+     * Get the largest number of levels of detail of any loaded mesh
+     */
+    [[nodiscard]] u32 get_max_mesh_lods() const {
+        return max_mesh_lods_;
+    }
+
+    /**
+     * Create a material, materials live until the backend is destroyed
+     * @param desc The material
+     * @return The material, or the default material if there's no room for it
+     */
+    Material create_material(const MaterialDesc& desc);
 
     BatchGroup add_batches(const std::vector<gfx::MeshBatch>& batches);
 
+    /**
+     * Reserve draws in this frame's draw buffer to be written on the gpu, along with a draw count
+     * @note The reserved range starts at get_draw_data_buffer() + first_batch, the count is at count_offset in
+     * get_draw_count_buffer()
+     * @param max_batches The maximum number of draws the gpu can write
+     * @return A batch group that reads its draw count from the gpu
+     */
+    BatchGroup reserve_batches(u32 max_batches);
+
+    /**
+     * Record clearing the draw count of a reserved batch group, should be done before the gpu writes its draws
+     * @param cmd The command buffer to record to
+     * @param group A batch group from reserve_batches
+     */
+    void clear_draw_count(VkCommandBuffer cmd, const BatchGroup& group);
+
     void draw_batch_group(VkCommandBuffer cmd, const BatchGroup& group);
 
+    /**
+     * Record a barrier with VK_KHR_synchronization2, or as a sync1 barrier if it isn't supported. The sync1 barrier
+     * has one set of stages, every barrier in it waits on all of their source stages
+     * @param cmd The command buffer to record to
+     * @param dependency The barriers, without buffer barriers. Only sync1 stage and access bits can be used
+     */
+    void pipeline_barrier(VkCommandBuffer cmd, const VkDependencyInfoKHR& dependency);
+
+    /**
+     * Record a barrier over all memory, for buffers and images that stay in their layout
+     * @param cmd The command buffer to record to
+     */
+    void memory_barrier(VkCommandBuffer          cmd,
+                        VkPipelineStageFlags2KHR src_stage,
+                        VkAccessFlags2KHR        src_access,
+                        VkPipelineStageFlags2KHR dst_stage,
+                        VkAccessFlags2KHR        dst_access);
+
+    /**
+     * Record a barrier over every mip level and layer of an image, moving it to another layout
+     * @param cmd The command buffer to record to
+     * @param aspect The aspect of the image's format, color or depth
+     * @param old_layout The layout it's in, VK_IMAGE_LAYOUT_UNDEFINED if its contents aren't needed
+     */
+    void image_barrier(VkCommandBuffer          cmd,
+                       const Image&             image,
+                       VkImageAspectFlags       aspect,
+                       VkPipelineStageFlags2KHR src_stage,
+                       VkAccessFlags2KHR        src_access,
+                       VkPipelineStageFlags2KHR dst_stage,
+                       VkAccessFlags2KHR        dst_access,
+                       VkImageLayout            old_layout,
+                       VkImageLayout            new_layout);
+
     // temp
-    VkRenderPass          create_render_pass();
-    void                  create_framebuffers(VkRenderPass render_pass, VkRect2D render_area);
+    VkRenderPass          create_render_pass(ColorAttachment    color_attachment,
+                                             VkAttachmentLoadOp load_op,
+                                             bool               is_present_pass,
+                                             u32                num_views = 1);
+    void                  create_framebuffers(VkRenderPass    render_pass,
+                                              ColorAttachment color_attachment,
+                                              VkRect2D        render_area,
+                                              u32             num_views = 1);
     VkFramebuffer         get_framebuffer(VkRenderPass render_pass);
+
+    /**
+     * Get an attachment of a multiview pass for the current swapchain image. Multiview passes draw to images of their
+     * own with a layer per view instead of the swapchain's
+     * @param render_pass The render pass, with more than one view
+     * @param attachment The color attachments are first, followed by depth
+     */
+    const Image& get_layered_image(VkRenderPass render_pass, u32 attachment) {
+        return layered_images_.at(render_pass).at(swap_image_index_)[attachment];
+    }
+
     VkDescriptorSetLayout create_descriptor_set_layout(const VkDescriptorSetLayoutCreateInfo& info);
     VkPipelineLayout      create_pipeline_layout(const VkPipelineLayoutCreateInfo& pipeline_layout_info);
     VkPipeline            create_graphics_pipeline(const std::vector<ShaderInfo>& shaders,
+                                                   const DepthState&              depth_state,
+                                                   bool                           is_blended,
                                                    VkPipelineLayout               pipeline_layout,
-                                                   VkRenderPass                   render_pass);
+                                                   VkRenderPass                   render_pass,
+                                                   u32                            num_color_attachments);
+    VkPipeline            create_compute_pipeline(const ShaderInfo& shader, VkPipelineLayout pipeline_layout);
+    VkSampler             create_sampler(const VkSamplerCreateInfo& sampler_info);
+
+    /**
+     * Create a storage buffer in gpu memory, for state that lives on the gpu between frames. It can be filled with
+     * vkCmdFillBuffer and is destroyed at application end
+     * @param size The size in bytes
+     * @param usage What else the buffer is used for, like VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+     * @return The buffer
+     */
+    Buffer create_storage_buffer_gpu(VkDeviceSize size, VkBufferUsageFlags usage = 0);
+
+    /**
+     * Create an image in gpu memory along with a view of all its mip levels, it's destroyed at application end
+     * @param extent The size of the first mip level
+     * @param format The format of the image
+     * @param usage How the image will be used
+     * @param mip_levels The number of mip levels
+     * @param aspect The aspects of the image the view covers
+     * @param num_layers The number of array layers
+     * @return The image
+     */
+    Image create_image_gpu(VkExtent2D         extent,
+                           VkFormat           format,
+                           VkImageUsageFlags  usage,
+                           u32                mip_levels,
+                           VkImageAspectFlags aspect,
+                           u32                num_layers = 1);
+
+    /**
+     * Create an image without memory, for images that share memory. Bind it with bind_image_memory before using it
+     * @param requirements Filled with the memory the image needs
+     * @return The image, without a view until it's bound
+     */
+    Image create_image_unbound(VkExtent2D            extent,
+                               VkFormat              format,
+                               VkImageUsageFlags     usage,
+                               u32                   mip_levels,
+                               VkMemoryRequirements& requirements);
+
+    /**
+     * Allocate gpu memory for images to share, it's freed at application end
+     * @param requirements The size, alignment and memory types the memory has to satisfy
+     */
+    VmaAllocation allocate_image_memory(const VkMemoryRequirements& requirements);
+
+    /**
+     * Bind an image from create_image_unbound to memory and create its view
+     * @param image The image
+     * @param allocation Memory from allocate_image_memory
+     * @param offset Where the image starts in the memory, aligned to its requirements
+     * @param aspect The aspects of the image the view covers
+     */
+    void bind_image_memory(Image& image, VmaAllocation allocation, VkDeviceSize offset, VkImageAspectFlags aspect);
+
+    /**
+     * Create a view of some of an image's mip levels and all of its layers, it's destroyed at application end
+     * @param image The image to view
+     * @param aspect The aspects of the image the view covers
+     * @param base_mip The first mip level in the view
+     * @param num_mips The number of mip levels in the view
+     * @return The image view
+     */
+    VkImageView create_image_view(const Image& image, VkImageAspectFlags aspect, u32 base_mip, u32 num_mips);
 
     /**
      * Get a descriptor set with the given layout, if none are available, allocate a new one
@@ -141,14 +781,42 @@ class GraphicsBackend {
      * Just a simple wrapper around vkUpdateDescriptorSets
      * @param writes A vector of VkWriteDescriptorSet
      */
-    void update_descriptor_sets(const std::vector<VkWriteDescriptorSet>& writes);
+    void update_descriptor_sets(const std::vector<VkWriteDescriptorSet>& writes) {
+        update_descriptor_sets(writes.data(), writes.size());
+    }
+
+    void update_descriptor_sets(const VkWriteDescriptorSet* writes, u32 num_writes);
 
   private:
     // TODO: config option?
     static constexpr u32 NUM_FRAMES_IN_FLIGHT = 2;
-    static constexpr u32 MAX_UNIQUE_VERTICES  = 1000;
+    static constexpr u32 MAX_UNIQUE_VERTICES  = 1 << 21; // of every mesh's lods together, 40 MiB of vertices
     static constexpr u32 MAX_OBJECTS          = 1000;
-    static constexpr u32 MAX_DRAWS            = 1000;
+    static constexpr u32 MAX_DRAWS            = 4096;
+    static constexpr u32 MAX_MESHES           = 1000;
+    static constexpr u32 MAX_DRAW_COUNTS      = 64;
+    static constexpr u32 MAX_LIGHTS           = 4096;
+    static constexpr u32 MAX_MATERIALS        = 256;
+    static constexpr u32 MAX_FRAME_VIEWS      = 64;
+
+    // meshlets only cover the first lod of each mesh and every meshlet has at least one triangle, so these can't run
+    // out before the vertex buffer does
+    static constexpr u32 MAX_MESHLETS              = MAX_UNIQUE_VERTICES / 3;
+    static constexpr u32 MAX_MESHLET_VERTEX_REFS   = MAX_UNIQUE_VERTICES;
+    static constexpr u32 MAX_MESHLET_TRIANGLE_REFS = MAX_UNIQUE_VERTICES / 3;
+    static constexpr u32 MAX_VISIBLE_MESHLETS      = 64 * 1024;
+
+    static constexpr VkFormat VISIBILITY_ID_FORMAT = VK_FORMAT_R32_UINT;
+
+    // by GBufferAttachment, normals get more precision than 8 bits
+    static constexpr VkFormat GBUFFER_FORMATS[MAX_COLOR_ATTACHMENTS] = {VK_FORMAT_R8G8B8A8_UNORM,
+                                                                        VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+                                                                        VK_FORMAT_R8G8B8A8_UNORM};
+
+    // every object slot of the culled object data and every triangle of the vertex buffer must fit in a visibility id.
+    // The object slots take the top 12 bits, the vertex buffer can grow to 3 << VISIBILITY_TRIANGLE_BITS vertices
+    static_assert(MAX_OBJECTS * MAX_MESH_LODS <= (1u << (32 - VISIBILITY_TRIANGLE_BITS)));
+    static_assert(MAX_UNIQUE_VERTICES / 3 <= (1u << VISIBILITY_TRIANGLE_BITS));
 
     struct DescriptorSetCache {
         [[nodiscard]] bool empty() const {
@@ -178,8 +846,9 @@ class GraphicsBackend {
         }
 
       private:
-        std::stack<VkDescriptorSet> in_use_;
-        std::stack<VkDescriptorSet> available_;
+        // vector backed so moving sets between the stacks every frame doesn't allocate
+        std::stack<VkDescriptorSet, std::vector<VkDescriptorSet>> in_use_;
+        std::stack<VkDescriptorSet, std::vector<VkDescriptorSet>> available_;
     };
 
     struct PerFrame {
@@ -187,9 +856,53 @@ class GraphicsBackend {
         VkSemaphore     image_available_;
         VkSemaphore     render_finished_;
         VkFence         in_flight_;
+
+        // async compute, the graphics submission waits on compute_finished_ so in_flight_ covers both
+        VkCommandBuffer      compute_command_buffer_;
+        VkSemaphore          compute_finished_;
+        VkPipelineStageFlags compute_wait_stages_; // 0 if nothing was recorded to it this frame
+
+        // uploads to the frame's buffers are staged in staging_ and copied by upload_command_buffer_, which is
+        // submitted ahead of the rest of the frame. See upload_to_buffer
+        VkCommandBuffer upload_command_buffer_;
+        VkSemaphore     uploads_finished_; // waited on by async compute
+        Buffer          staging_;          // persistently mapped
+        VkDeviceSize    staging_offset_;
+        bool            has_uploads_;
+
         Buffer          object_data_;
         Buffer          draw_data_; // holds VkDrawIndirectCommands
         u32             num_draws_; // aka num_batches
+        Buffer          instance_ranges_; // u32 count followed by InstanceRanges, for single-draw batch groups
+        u32             num_instance_ranges_;
+        u32             num_flat_vertices_;
+
+        // hashes of the batch groups held in draw_data_, lets unchanged groups skip the upload
+        std::vector<u64> batch_group_hashes_;
+        u32              num_batch_groups_;
+
+        // what was last uploaded to each of draw_data_'s draws, tells apart groups whose hashes collide
+        std::vector<VkDrawIndirectCommand> uploaded_draws_;
+
+        Buffer draw_counts_; // gpu written draw counts for batch groups from reserve_batches
+        u32    num_draw_counts_;
+
+        // gpu culling output, ObjectData of visible instances placed by their lod and their batch's firstInstance
+        Buffer culled_object_data_;
+        Buffer visible_counts_; // visible instance counters per draw, one set for each culling phase
+
+        // meshlet culling output when drawing meshlets without mesh shaders, see get_visible_meshlet_buffer
+        Buffer visible_meshlets_;
+
+        Buffer light_data_; // PointLights
+        u32    num_lights_;
+        Buffer light_tiles_;    // see get_light_tile_buffer
+        Buffer light_clusters_; // see get_light_cluster_buffer
+
+        Buffer directional_light_; // a DirectionalLightData
+
+        Buffer views_; // view-projection matrices of multiview passes, see add_views
+        u32    num_views_;
 
         std::unordered_map<VkDescriptorSetLayout, DescriptorSetCache> descriptor_set_caches_;
 
@@ -201,8 +914,27 @@ class GraphicsBackend {
     void choose_physical_device();
     void create_logical_device();
     void create_swapchain();
+    void create_depth_images();
+    void create_visibility_id_images();
+    void create_gbuffer_images();
 
-    void one_time_submit(VkQueue queue, const std::function<void(VkCommandBuffer)>& cmd_recording_func);
+    /**
+     * Get the format of one of the color attachments a pass draws to
+     * @param index The attachment, less than get_num_color_attachments(color_attachment)
+     */
+    [[nodiscard]] VkFormat get_color_attachment_format(ColorAttachment color_attachment, u32 index) const;
+
+    void draw_batch_group_gpu_count(VkCommandBuffer cmd, const BatchGroup& group);
+
+    /**
+     * Flatten the instances of a batch group into one vertex range and upload the instance ranges for it
+     * @param batches The batches of the group
+     * @param group The batch group to fill the flattened range of
+     * @param upload Whether the ranges need to be uploaded, false if the buffer already holds them
+     */
+    void add_instance_ranges(const std::vector<gfx::MeshBatch>& batches, BatchGroup& group, bool upload);
+
+    void one_time_submit(VkQueue queue, FunctionRef<void(VkCommandBuffer)> cmd_recording_func);
 
     enum class BufferDestroyPolicy
     {
@@ -212,6 +944,30 @@ class GraphicsBackend {
 
     Buffer create_buffer_gpu(VkDeviceSize size, VkBufferUsageFlags buffer_usage, BufferDestroyPolicy policy);
     void   copy_to_buffer(const void* src_data, VkDeviceSize src_size, const Buffer& dst_buffer, VkDeviceSize offset);
+
+    /**
+     * Copy regions of some data to a buffer, with one staging buffer and one submission for all of them. Waits for
+     * the copy to finish, so it's for data loaded outside of frames, see upload_to_buffer for the frame's buffers
+     * @param src_data The data, the regions' source offsets are into it
+     * @param src_size The size of the data in bytes
+     */
+    void   copy_to_buffer(const void*                   src_data,
+                          VkDeviceSize                  src_size,
+                          const Buffer&                 dst_buffer,
+                          std::span<const VkBufferCopy> regions);
+    void   upload_to_buffer(const void* src_data, VkDeviceSize src_size, const Buffer& dst_buffer, VkDeviceSize offset);
+
+    /**
+     * Stage regions of some data in this frame's staging buffer and record copying them to a buffer, ahead of the
+     * frame's other work. Nothing waits or allocates, so it's for this frame's own buffers, which the gpu is done with
+     * once begin_frame returns. The data is dropped if the staging buffer is full
+     * @param src_data The data, the regions' source offsets are into it
+     * @param src_size The size of the data in bytes
+     */
+    void   upload_to_buffer(const void*                   src_data,
+                            VkDeviceSize                  src_size,
+                            const Buffer&                 dst_buffer,
+                            std::span<const VkBufferCopy> regions);
     void   destroy_buffer(const Buffer& buffer);
 
     PerFrame& get_current_frame() {
@@ -221,28 +977,41 @@ class GraphicsBackend {
     Core&                             core_;
     std::stack<std::function<void()>> cleanup_;
 
-    VkInstance               instance_              = VK_NULL_HANDLE;
-    VkSurfaceKHR             surface_               = VK_NULL_HANDLE;
-    VkPhysicalDevice         physical_device_       = VK_NULL_HANDLE;
-    VkPhysicalDeviceFeatures device_features_       = {};
-    VkDevice                 device_                = VK_NULL_HANDLE;
-    u32                      graphics_family_index_ = 0;
-    u32                      compute_family_index_  = 0;
-    u32                      present_family_index_  = 0;
-    VkQueue                  graphics_queue_        = VK_NULL_HANDLE;
-    VkQueue                  compute_queue_         = VK_NULL_HANDLE;
-    VkQueue                  present_queue_         = VK_NULL_HANDLE;
+    VkInstance                       instance_                  = VK_NULL_HANDLE;
+    VkSurfaceKHR                     surface_                   = VK_NULL_HANDLE;
+    VkPhysicalDevice                 physical_device_           = VK_NULL_HANDLE;
+    VkPhysicalDeviceFeatures         device_features_           = {};
+    VkPhysicalDeviceVulkan11Features device_features_11_        = {};
+    VkPhysicalDeviceVulkan12Features device_features_12_        = {};
+    VkDevice                         device_                    = VK_NULL_HANDLE;
+    u32                              graphics_family_index_     = 0;
+    u32                              compute_family_index_      = 0;
+    u32                              present_family_index_      = 0;
+    bool                             graphics_supports_compute_ = false;
+    VkQueue                          graphics_queue_            = VK_NULL_HANDLE;
+    VkQueue                          compute_queue_             = VK_NULL_HANDLE;
+    VkQueue                          present_queue_             = VK_NULL_HANDLE;
+
+    // loaded from VK_EXT_mesh_shader and VK_KHR_synchronization2, null if they aren't enabled
+    PFN_vkCmdDrawMeshTasksEXT    cmd_draw_mesh_tasks_    = nullptr;
+    PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier_2_ = nullptr;
 
     VkSwapchainKHR           swapchain_        = VK_NULL_HANDLE;
     VkExtent2D               swapchain_extent_ = {};
     VkSurfaceFormatKHR       swapchain_format_ = {};
     std::vector<VkImage>     swapchain_images_;
     std::vector<VkImageView> swapchain_image_views_;
+    std::vector<Image>       depth_images_;         // one per swapchain image
+    std::vector<Image>       visibility_id_images_; // one per swapchain image, created when first drawn to
+
+    // one set per swapchain image, by GBufferAttachment. Created when first drawn to
+    std::vector<std::array<Image, MAX_COLOR_ATTACHMENTS>> gbuffer_images_;
 
     VmaAllocator allocator_ = VK_NULL_HANDLE;
 
     // need a command pool per-thread
-    VkCommandPool command_pool_ = VK_NULL_HANDLE;
+    VkCommandPool command_pool_         = VK_NULL_HANDLE;
+    VkCommandPool compute_command_pool_ = VK_NULL_HANDLE;
 
     VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
 
@@ -250,11 +1019,37 @@ class GraphicsBackend {
     u32      current_frame_                = 0;
     u32      swap_image_index_             = 0;
 
+    // cpu temporaries, only live until the next begin_frame
+    FrameArena frame_arena_;
+
     std::unordered_map<VkRenderPass, std::vector<VkFramebuffer>> framebuffers_;
 
+    // the attachments of multiview passes, one set per swapchain image. The color attachments followed by depth
+    std::unordered_map<VkRenderPass, std::vector<std::array<Image, MAX_COLOR_ATTACHMENTS + 1>>> layered_images_;
+
     // unified buffers
     Buffer unified_vertex_buffer_;
     u32    num_vertices_in_buffer_ = 0;
+
+    // which objects passed culling last frame, indexed like the object data
+    Buffer visibility_buffer_;
+
+    // mesh table, indexed by Mesh::get_index()
+    Buffer                mesh_table_buffer_;
+    std::vector<MeshData> mesh_table_;
+    u32                   max_mesh_lods_ = 1;
+
+    // material parameters, indexed by Material::get_index()
+    Buffer material_buffer_;
+    u32    num_materials_ = 0;
+
+    // meshlets of every mesh, with the vertex indices and triangles they point into
+    Buffer meshlet_buffer_;
+    Buffer meshlet_vertex_buffer_;
+    Buffer meshlet_triangle_buffer_;
+    u32    num_meshlets_in_buffer_          = 0;
+    u32    num_meshlet_vertices_in_buffer_  = 0;
+    u32    num_meshlet_triangles_in_buffer_ = 0;
 };
 
 } // namespace rune::gfx
@@ -1,6 +1,7 @@
 #ifndef RUNE_GRAPHICS_PASS_H
 #define RUNE_GRAPHICS_PASS_H
 
+#include "gfx/image.h"
 #include "gfx/render_pass.h"
 
 namespace rune {
@@ -14,13 +15,52 @@ class GraphicsBackend;
 struct GraphicsPassDesc {
     VkRect2D render_area = {0, 0};
 
+    // clear the color and depth attachments, or load to keep drawing on top of an earlier pass in the frame
+    VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+    // whether this is the last pass to draw to the color attachment in a frame. The swapchain image is presented
+    // after it, the visibility buffer is left to be shaded from
+    bool is_present_pass = true;
+
+    ColorAttachment color_attachment = ColorAttachment::SWAPCHAIN;
+
+    // draw this many views at once, each to its own layer of attachments the pass creates instead of the swapchain's,
+    // see get_layered_image. The shaders pick each view's matrix with gl_ViewIndex, see shadow.vert.
+    // Check GraphicsBackend::supports_multiview before using more than one
+    u32 num_views = 1;
+
+    // after a depth prepass, test with EQUAL and don't write so only the closest surface is shaded
+    DepthState depth;
+
+    // blend the fragment shader's color over the attachment by its alpha, for transparent draws sorted back to front.
+    // Integer attachments like the visibility buffer can't be blended
+    bool is_blended = false;
+
     // temp shader paths
 
     const char* vert_shader_path = nullptr;
-    const char* frag_shader_path = nullptr;
+    const char* frag_shader_path = nullptr; // null for depth only passes, they don't write color
+
+    // if a mesh shader is set it replaces the vertex shader, the task shader is optional.
+    // Check GraphicsBackend::supports_mesh_shaders before using
+    const char* task_shader_path = nullptr;
+    const char* mesh_shader_path = nullptr;
 
     [[nodiscard]] std::vector<ShaderInfo> get_shaders() const {
-        return {{VK_SHADER_STAGE_VERTEX_BIT, vert_shader_path}, {VK_SHADER_STAGE_FRAGMENT_BIT, frag_shader_path}};
+        std::vector<ShaderInfo> shaders;
+        if (!mesh_shader_path) {
+            shaders.push_back({VK_SHADER_STAGE_VERTEX_BIT, vert_shader_path});
+        } else {
+            if (task_shader_path) {
+                shaders.push_back({VK_SHADER_STAGE_TASK_BIT_EXT, task_shader_path});
+            }
+            shaders.push_back({VK_SHADER_STAGE_MESH_BIT_EXT, mesh_shader_path});
+        }
+
+        if (frag_shader_path) {
+            shaders.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, frag_shader_path});
+        }
+        return shaders;
     }
 };
 
@@ -28,10 +68,17 @@ class GraphicsPass : public RenderPass {
   public:
     explicit GraphicsPass(Core& core, GraphicsBackend& gfx, const GraphicsPassDesc& desc);
 
-    void run(VkCommandBuffer cmd, const std::function<void(VkCommandBuffer)>& func) override;
+    void run(VkCommandBuffer cmd, FunctionRef<void(VkCommandBuffer)> func) override;
 
     void set_descriptors(VkCommandBuffer cmd, const DescriptorWrites& writes) override;
 
+    /**
+     * Get an attachment of a multiview pass for the current swapchain image, with a layer per view. It's left in the
+     * layouts of the last pass like the single view attachments
+     * @param attachment The color attachments are first, followed by depth
+     */
+    [[nodiscard]] const Image& get_layered_image(u32 attachment) const;
+
   private:
     GraphicsPassDesc desc_;
     VkPipeline       pipeline_;
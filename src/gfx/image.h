@@ -0,0 +1,24 @@
+#ifndef RUNE_IMAGE_H
+#define RUNE_IMAGE_H
+
+#include "types.h"
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+namespace rune::gfx {
+
+struct Image {
+    VkImage     image      = VK_NULL_HANDLE;
+    VkImageView view       = VK_NULL_HANDLE; // covers every mip level and layer
+    VkFormat    format     = VK_FORMAT_UNDEFINED;
+    VkExtent2D  extent     = {};
+    u32         mip_levels = 1;
+    u32         num_layers = 1; // viewed as an array if there's more than one
+
+    VmaAllocation allocation = VK_NULL_HANDLE;
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_IMAGE_H
@@ -0,0 +1,542 @@
+#include "mesh_simplifier.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <glm/glm.hpp>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+namespace rune::gfx {
+
+namespace {
+
+// Below this many triangles another lod isn't worth a level in the mesh table
+constexpr u32 MIN_LOD_TRIANGLES = 16;
+
+// A lod has to remove at least this fraction of the triangles of the one before it
+constexpr f32 MIN_LOD_REDUCTION = 0.2f;
+
+// Borders have nothing on the other side to hold them in place, weight their quadrics so they stay put
+constexpr f64 BORDER_WEIGHT = 10.0;
+
+// Reject collapses that turn a triangle's normal by more than about 80 degrees
+constexpr f64 MIN_NORMAL_DOT = 0.2;
+
+constexpr char LOD_FILE_MAGIC[4] = {'R', 'L', 'O', 'D'};
+constexpr u32  LOD_FILE_VERSION  = 1;
+
+/**
+ * The symmetric 4x4 matrix of the summed squared distances to a set of planes, along with the area of those planes
+ */
+struct Quadric {
+    f64 a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    f64 a11 = 0, a12 = 0, a13 = 0;
+    f64 a22 = 0, a23 = 0;
+    f64 a33    = 0;
+    f64 weight = 0;
+
+    static Quadric from_plane(const glm::dvec3& normal, f64 d, f64 weight) {
+        Quadric q;
+        q.a00    = normal.x * normal.x * weight;
+        q.a01    = normal.x * normal.y * weight;
+        q.a02    = normal.x * normal.z * weight;
+        q.a03    = normal.x * d * weight;
+        q.a11    = normal.y * normal.y * weight;
+        q.a12    = normal.y * normal.z * weight;
+        q.a13    = normal.y * d * weight;
+        q.a22    = normal.z * normal.z * weight;
+        q.a23    = normal.z * d * weight;
+        q.a33    = d * d * weight;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& rhs) {
+        a00 += rhs.a00;
+        a01 += rhs.a01;
+        a02 += rhs.a02;
+        a03 += rhs.a03;
+        a11 += rhs.a11;
+        a12 += rhs.a12;
+        a13 += rhs.a13;
+        a22 += rhs.a22;
+        a23 += rhs.a23;
+        a33 += rhs.a33;
+        weight += rhs.weight;
+        return *this;
+    }
+
+    [[nodiscard]] f64 evaluate(const glm::dvec3& p) const {
+        f64 error = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x //
+                  + a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y                       //
+                  + a22 * p.z * p.z + 2 * a23 * p.z                                             //
+                  + a33;
+        return std::max(error, 0.0);
+    }
+
+    /**
+     * Find the position with the lowest error
+     * @param result Set to the position if there is a single one
+     * @return False if the planes don't meet in a point, like when they're all parallel
+     */
+    bool find_minimum(glm::dvec3& result) const {
+        // Cramer's rule on the upper 3x3, the rows are the planes' normals summed
+        f64 det = a00 * (a11 * a22 - a12 * a12) - a01 * (a01 * a22 - a12 * a02) + a02 * (a01 * a12 - a11 * a02);
+        if (std::abs(det) < 1e-12) {
+            return false;
+        }
+
+        glm::dvec3 b = -glm::dvec3(a03, a13, a23);
+        result.x     = (b.x * (a11 * a22 - a12 * a12) - a01 * (b.y * a22 - a12 * b.z) + a02 * (b.y * a12 - a11 * b.z));
+        result.y     = (a00 * (b.y * a22 - a12 * b.z) - b.x * (a01 * a22 - a12 * a02) + a02 * (a01 * b.z - b.y * a02));
+        result.z     = (a00 * (a11 * b.z - b.y * a12) - a01 * (a01 * b.z - b.y * a02) + b.x * (a01 * a12 - a11 * a02));
+        result /= det;
+        return true;
+    }
+};
+
+struct SimplifyVertex {
+    glm::dvec3 position;
+    f64        u, v;
+    Quadric    quadric;
+    u32        version   = 0;
+    bool       is_border = false;
+};
+
+struct Collapse {
+    f64        cost;
+    u32        v0, v1; // v1 is merged into v0
+    u32        version0, version1;
+    glm::dvec3 position;
+    f64        u, v;
+
+    bool operator>(const Collapse& rhs) const {
+        return cost > rhs.cost;
+    }
+};
+
+class Simplifier {
+  public:
+    Simplifier(const Vertex* vertices, u32 num_vertices) {
+        weld(vertices, num_vertices);
+        build_quadrics();
+    }
+
+    LodLevel run(u32 target_triangles) {
+        for (u32 i = 0; i < vertices_.size(); ++i) {
+            for (u32 neighbor : get_neighbors(i)) {
+                if (i < neighbor) {
+                    push_collapse(i, neighbor);
+                }
+            }
+        }
+
+        f64 max_error = 0.0;
+        while (num_live_triangles_ > target_triangles && !collapses_.empty()) {
+            Collapse collapse = collapses_.top();
+            collapses_.pop();
+
+            if (vertices_[collapse.v0].version != collapse.version0 ||
+                vertices_[collapse.v1].version != collapse.version1) {
+                continue; // an endpoint changed since this was queued, there's a newer entry for it
+            }
+
+            if (!is_valid_collapse(collapse)) {
+                continue;
+            }
+
+            apply_collapse(collapse);
+
+            f64 weight = vertices_[collapse.v0].quadric.weight;
+            max_error  = std::max(max_error, weight > 0.0 ? std::sqrt(collapse.cost / weight) : 0.0);
+        }
+
+        LodLevel result;
+        result.error = (f32)max_error;
+        result.vertices.reserve(num_live_triangles_ * 3);
+        for (const std::array<u32, 3>& triangle : triangles_) {
+            if (triangle[0] == DEAD_TRIANGLE) {
+                continue;
+            }
+
+            for (u32 index : triangle) {
+                const SimplifyVertex& v = vertices_[index];
+                result.vertices.push_back(
+                    Vertex{(f32)v.position.x, (f32)v.position.y, (f32)v.position.z, (f32)v.u, (f32)v.v});
+            }
+        }
+
+        return result;
+    }
+
+  private:
+    static constexpr u32 DEAD_TRIANGLE = ~0u;
+
+    void weld(const Vertex* vertices, u32 num_vertices) {
+        std::unordered_map<VertexKey, u32, VertexKeyHash> unique_vertices;
+        unique_vertices.reserve(num_vertices);
+
+        std::vector<u32> indices(num_vertices);
+        for (u32 i = 0; i < num_vertices; ++i) {
+            auto [it, inserted] = unique_vertices.try_emplace(VertexKey{vertices[i]}, (u32)vertices_.size());
+            if (inserted) {
+                SimplifyVertex& v = vertices_.emplace_back();
+                v.position        = glm::dvec3(vertices[i].x, vertices[i].y, vertices[i].z);
+                v.u               = vertices[i].u;
+                v.v               = vertices[i].v;
+            }
+            indices[i] = it->second;
+        }
+
+        vertex_triangles_.resize(vertices_.size());
+        for (u32 i = 0; i + 2 < num_vertices; i += 3) {
+            std::array<u32, 3> triangle = {indices[i], indices[i + 1], indices[i + 2]};
+            if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) {
+                continue; // degenerate, or two corners only differ in an attribute we don't keep
+            }
+
+            u32 triangle_index = triangles_.size();
+            triangles_.push_back(triangle);
+            for (u32 index : triangle) {
+                vertex_triangles_[index].push_back(triangle_index);
+            }
+        }
+        num_live_triangles_ = triangles_.size();
+    }
+
+    void build_quadrics() {
+        // Edges used by only one triangle are borders, they get a plane through the edge that's perpendicular to the
+        // triangle so moving along the surface away from the border is penalized as well
+        std::unordered_map<u64, u32> edge_counts;
+        for (const std::array<u32, 3>& triangle : triangles_) {
+            for (u32 i = 0; i < 3; ++i) {
+                ++edge_counts[edge_key(triangle[i], triangle[(i + 1) % 3])];
+            }
+        }
+
+        for (const std::array<u32, 3>& triangle : triangles_) {
+            glm::dvec3 p0     = vertices_[triangle[0]].position;
+            glm::dvec3 p1     = vertices_[triangle[1]].position;
+            glm::dvec3 p2     = vertices_[triangle[2]].position;
+            glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+            f64        length = glm::length(normal);
+            if (length <= 0.0) {
+                continue;
+            }
+
+            normal /= length;
+            f64     area  = length * 0.5;
+            Quadric plane = Quadric::from_plane(normal, -glm::dot(normal, p0), area);
+            for (u32 index : triangle) {
+                vertices_[index].quadric += plane;
+            }
+
+            for (u32 i = 0; i < 3; ++i) {
+                u32 a = triangle[i];
+                u32 b = triangle[(i + 1) % 3];
+                if (edge_counts[edge_key(a, b)] != 1) {
+                    continue;
+                }
+
+                glm::dvec3 edge        = vertices_[b].position - vertices_[a].position;
+                glm::dvec3 edge_normal = glm::cross(edge, normal);
+                f64        edge_length = glm::length(edge_normal);
+                if (edge_length <= 0.0) {
+                    continue;
+                }
+
+                edge_normal /= edge_length;
+                Quadric border = Quadric::from_plane(edge_normal,
+                                                     -glm::dot(edge_normal, vertices_[a].position),
+                                                     edge_length * edge_length * BORDER_WEIGHT);
+                vertices_[a].quadric += border;
+                vertices_[b].quadric += border;
+                vertices_[a].is_border = true;
+                vertices_[b].is_border = true;
+            }
+        }
+    }
+
+    static u64 edge_key(u32 a, u32 b) {
+        return a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+    }
+
+    std::vector<u32> get_neighbors(u32 vertex) const {
+        std::vector<u32> neighbors;
+        for (u32 triangle_index : vertex_triangles_[vertex]) {
+            const std::array<u32, 3>& triangle = triangles_[triangle_index];
+            if (triangle[0] == DEAD_TRIANGLE) {
+                continue;
+            }
+
+            for (u32 index : triangle) {
+                if (index != vertex) {
+                    neighbors.push_back(index);
+                }
+            }
+        }
+
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        return neighbors;
+    }
+
+    void push_collapse(u32 v0, u32 v1) {
+        const SimplifyVertex& a = vertices_[v0];
+        const SimplifyVertex& b = vertices_[v1];
+
+        Quadric quadric = a.quadric;
+        quadric += b.quadric;
+
+        Collapse collapse = {};
+        collapse.cost     = std::numeric_limits<f64>::max();
+        collapse.v0       = v0;
+        collapse.v1       = v1;
+        collapse.version0 = a.version;
+        collapse.version1 = b.version;
+
+        // Attributes are interpolated along the edge, so the position picks where along it they're taken from
+        auto try_position = [&](const glm::dvec3& position, f64 t) {
+            f64 cost = quadric.evaluate(position);
+            if (cost < collapse.cost) {
+                collapse.cost     = cost;
+                collapse.position = position;
+                collapse.u        = a.u + (b.u - a.u) * t;
+                collapse.v        = a.v + (b.v - a.v) * t;
+            }
+        };
+
+        // A border vertex can only move along the border, keep it where it is when it meets an interior one
+        if (a.is_border != b.is_border) {
+            if (a.is_border) {
+                try_position(a.position, 0.0);
+            } else {
+                try_position(b.position, 1.0);
+            }
+        } else {
+            try_position(a.position, 0.0);
+            try_position(b.position, 1.0);
+            try_position((a.position + b.position) * 0.5, 0.5);
+
+            glm::dvec3 optimal;
+            if (quadric.find_minimum(optimal)) {
+                glm::dvec3 edge        = b.position - a.position;
+                f64        edge_length = glm::dot(edge, edge);
+                f64 t = edge_length > 0.0 ? std::clamp(glm::dot(optimal - a.position, edge) / edge_length, 0.0, 1.0)
+                                          : 0.0;
+                try_position(optimal, t);
+            }
+        }
+
+        // Merge into whichever vertex is kept as is, so its attributes don't need to be interpolated twice
+        if (a.is_border || !b.is_border) {
+            collapses_.push(collapse);
+        } else {
+            std::swap(collapse.v0, collapse.v1);
+            std::swap(collapse.version0, collapse.version1);
+            collapses_.push(collapse);
+        }
+    }
+
+    bool is_valid_collapse(const Collapse& collapse) const {
+        u32 num_shared_triangles = 0;
+        for (u32 vertex : {collapse.v0, collapse.v1}) {
+            for (u32 triangle_index : vertex_triangles_[vertex]) {
+                const std::array<u32, 3>& triangle = triangles_[triangle_index];
+                if (triangle[0] == DEAD_TRIANGLE) {
+                    continue;
+                }
+
+                bool has_v0 = triangle[0] == collapse.v0 || triangle[1] == collapse.v0 || triangle[2] == collapse.v0;
+                bool has_v1 = triangle[0] == collapse.v1 || triangle[1] == collapse.v1 || triangle[2] == collapse.v1;
+                if (has_v0 && has_v1) {
+                    num_shared_triangles += vertex == collapse.v0 ? 1 : 0;
+                    continue; // removed by the collapse
+                }
+
+                // The triangle keeps its shape apart from the moved corner, make sure it doesn't fold over
+                glm::dvec3 before[3];
+                glm::dvec3 after[3];
+                for (u32 i = 0; i < 3; ++i) {
+                    before[i] = vertices_[triangle[i]].position;
+                    after[i]  = triangle[i] == vertex ? collapse.position : before[i];
+                }
+
+                glm::dvec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::dvec3 normal_after  = glm::cross(after[1] - after[0], after[2] - after[0]);
+                f64        length_before = glm::length(normal_before);
+                f64        length_after  = glm::length(normal_after);
+                if (length_after <= 1e-12 * std::max(length_before, 1e-12)) {
+                    return false;
+                }
+
+                if (length_before > 0.0 &&
+                    glm::dot(normal_before, normal_after) < MIN_NORMAL_DOT * length_before * length_after) {
+                    return false;
+                }
+            }
+        }
+
+        // An edge between two border vertices that isn't a border itself would pinch the mesh into two
+        bool is_border_edge = num_shared_triangles == 1;
+        return !(vertices_[collapse.v0].is_border && vertices_[collapse.v1].is_border && !is_border_edge);
+    }
+
+    void apply_collapse(const Collapse& collapse) {
+        SimplifyVertex& kept    = vertices_[collapse.v0];
+        SimplifyVertex& removed = vertices_[collapse.v1];
+
+        for (u32 triangle_index : vertex_triangles_[collapse.v1]) {
+            std::array<u32, 3>& triangle = triangles_[triangle_index];
+            if (triangle[0] == DEAD_TRIANGLE) {
+                continue;
+            }
+
+            if (triangle[0] == collapse.v0 || triangle[1] == collapse.v0 || triangle[2] == collapse.v0) {
+                triangle[0] = DEAD_TRIANGLE;
+                --num_live_triangles_;
+                continue;
+            }
+
+            for (u32& index : triangle) {
+                if (index == collapse.v1) {
+                    index = collapse.v0;
+                }
+            }
+            vertex_triangles_[collapse.v0].push_back(triangle_index);
+        }
+
+        // Drop triangles that died so the lists don't keep growing
+        std::vector<u32>& triangles = vertex_triangles_[collapse.v0];
+        triangles.erase(std::remove_if(triangles.begin(),
+                                       triangles.end(),
+                                       [&](u32 triangle_index) {
+                                           return triangles_[triangle_index][0] == DEAD_TRIANGLE;
+                                       }),
+                        triangles.end());
+        vertex_triangles_[collapse.v1].clear();
+
+        kept.position = collapse.position;
+        kept.u        = collapse.u;
+        kept.v        = collapse.v;
+        kept.quadric += removed.quadric;
+        kept.is_border = kept.is_border || removed.is_border;
+        ++kept.version;
+
+        ++removed.version;
+
+        for (u32 neighbor : get_neighbors(collapse.v0)) {
+            push_collapse(collapse.v0, neighbor);
+        }
+    }
+
+    std::vector<SimplifyVertex>                                                   vertices_;
+    std::vector<std::array<u32, 3>>                                               triangles_;
+    std::vector<std::vector<u32>>                                                 vertex_triangles_;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses_;
+    u32                                                                           num_live_triangles_ = 0;
+};
+
+} // namespace
+
+LodLevel simplify_mesh(const Vertex* vertices, u32 num_vertices, u32 target_triangles) {
+    Simplifier simplifier(vertices, num_vertices);
+    return simplifier.run(target_triangles);
+}
+
+std::vector<LodLevel> build_lod_chain(const Vertex* vertices, u32 num_vertices, u32 max_lods) {
+    std::vector<LodLevel> lods;
+    if (max_lods == 0) {
+        return lods;
+    }
+
+    LodLevel& base = lods.emplace_back();
+    base.vertices.assign(vertices, vertices + num_vertices);
+    base.error = 0.0f;
+
+    u32 num_triangles = num_vertices / 3;
+    for (u32 i = 1; i < max_lods; ++i) {
+        u32 target_triangles = num_triangles >> i;
+        if (target_triangles < MIN_LOD_TRIANGLES) {
+            break;
+        }
+
+        // Simplify from the full mesh every time rather than from the previous lod, so errors don't compound
+        LodLevel lod           = simplify_mesh(vertices, num_vertices, target_triangles);
+        u32      lod_triangles = lod.vertices.size() / 3;
+        u32      prev_triangles = lods.back().vertices.size() / 3;
+        if (lod_triangles == 0 || (f32)lod_triangles > (f32)prev_triangles * (1.0f - MIN_LOD_REDUCTION)) {
+            break;
+        }
+
+        lod.error = std::max(lod.error, lods.back().error);
+        lods.push_back(std::move(lod));
+    }
+
+    return lods;
+}
+
+bool save_lod_chain(const char* path, const std::vector<LodLevel>& lods) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    u32 num_lods = lods.size();
+    file.write(LOD_FILE_MAGIC, sizeof(LOD_FILE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&LOD_FILE_VERSION), sizeof(u32));
+    file.write(reinterpret_cast<const char*>(&num_lods), sizeof(u32));
+    for (const LodLevel& lod : lods) {
+        u32 num_vertices = lod.vertices.size();
+        file.write(reinterpret_cast<const char*>(&lod.error), sizeof(f32));
+        file.write(reinterpret_cast<const char*>(&num_vertices), sizeof(u32));
+        file.write(reinterpret_cast<const char*>(lod.vertices.data()), num_vertices * sizeof(Vertex));
+    }
+
+    return (bool)file;
+}
+
+std::vector<LodLevel> load_lod_chain(const char* path) {
+    std::vector<char> data = utils::load_binary_file(path);
+
+    size_t offset = 0;
+    auto   read   = [&](void* dst, size_t size) {
+        if (offset + size > data.size()) {
+            return false;
+        }
+        std::memcpy(dst, data.data() + offset, size);
+        offset += size;
+        return true;
+    };
+
+    char magic[4];
+    u32  version  = 0;
+    u32  num_lods = 0;
+    if (!read(magic, sizeof(magic)) || std::memcmp(magic, LOD_FILE_MAGIC, sizeof(magic)) != 0 ||
+        !read(&version, sizeof(u32)) || version != LOD_FILE_VERSION || !read(&num_lods, sizeof(u32))) {
+        return {};
+    }
+
+    std::vector<LodLevel> lods(num_lods);
+    for (LodLevel& lod : lods) {
+        u32 num_vertices = 0;
+        if (!read(&lod.error, sizeof(f32)) || !read(&num_vertices, sizeof(u32)) ||
+            (size_t)num_vertices * sizeof(Vertex) > data.size() - offset) {
+            return {};
+        }
+
+        lod.vertices.resize(num_vertices);
+        read(lod.vertices.data(), num_vertices * sizeof(Vertex));
+    }
+
+    return lods;
+}
+
+} // namespace rune::gfx
@@ -0,0 +1,60 @@
+#ifndef RUNE_MESH_SIMPLIFIER_H
+#define RUNE_MESH_SIMPLIFIER_H
+
+#include "types.h"
+#include "vertex.h"
+
+#include <vector>
+
+namespace rune::gfx {
+
+// maximum number of levels of detail a mesh can have, keep in sync with mesh_table.glsl
+constexpr u32 MAX_MESH_LODS = 4;
+
+/**
+ * One level of a generated lod chain
+ */
+struct LodLevel {
+    std::vector<Vertex> vertices;     // a triangle list, like load_mesh takes
+    f32                 error = 0.0f; // how far the surface moved from the input mesh, in model space
+};
+
+/**
+ * Simplify a triangle list with quadric error metric edge collapses, see Garland and Heckbert's "Surface
+ * Simplification Using Quadric Error Metrics". Vertices are welded when all of their attributes match, so uv seams
+ * are kept like open borders
+ * @param vertices A triangle list
+ * @param num_vertices The number of vertices, a multiple of 3
+ * @param target_triangles Stop once there are at most this many triangles left
+ * @return The simplified mesh, it can have more triangles than targeted if collapsing more would fold the surface
+ */
+LodLevel simplify_mesh(const Vertex* vertices, u32 num_vertices, u32 target_triangles);
+
+/**
+ * Build a lod chain for a mesh. The first level is the mesh itself, every level after that targets half the triangles
+ * of the one before it. Errors are always increasing
+ * @param vertices A triangle list
+ * @param num_vertices The number of vertices, a multiple of 3
+ * @param max_lods The maximum number of levels, including the first
+ * @return The levels, stops early once a level doesn't remove enough triangles to be worth it
+ */
+std::vector<LodLevel> build_lod_chain(const Vertex* vertices, u32 num_vertices, u32 max_lods);
+
+/**
+ * Write a lod chain to a file, see load_lod_chain
+ * @param path The path of the file
+ * @param lods The lod chain
+ * @return Whether the file was written
+ */
+bool save_lod_chain(const char* path, const std::vector<LodLevel>& lods);
+
+/**
+ * Read a lod chain written by save_lod_chain
+ * @param path The path of the file
+ * @return The lod chain, empty if the file couldn't be read
+ */
+std::vector<LodLevel> load_lod_chain(const char* path);
+
+} // namespace rune::gfx
+
+#endif // RUNE_MESH_SIMPLIFIER_H
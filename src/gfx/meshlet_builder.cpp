@@ -0,0 +1,264 @@
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace rune::gfx {
+
+namespace {
+
+constexpr u32 NONE = ~0u;
+
+/**
+ * Builds meshlets one at a time from welded triangles, see build_meshlets
+ */
+class MeshletBuilder {
+  public:
+    MeshletBuilder(const Vertex* vertices, u32 num_vertices) : vertices_(vertices) {
+        weld(num_vertices);
+        build_adjacency();
+    }
+
+    MeshletMesh build() {
+        local_indices_.assign(unique_vertices_.size(), NONE);
+        is_emitted_.assign(triangles_.size(), false);
+
+        u32 next_seed = 0;
+        for (u32 num_emitted = 0; num_emitted < triangles_.size(); ++num_emitted) {
+            bool has_neighbors = false;
+            u32  triangle      = find_best_neighbor(has_neighbors);
+            if (triangle == NONE) {
+                // the neighbors don't fit, or this part of the mesh is done and the next one starts somewhere else
+                if (has_neighbors) {
+                    flush();
+                }
+
+                while (is_emitted_[next_seed]) {
+                    ++next_seed;
+                }
+                triangle = next_seed;
+
+                if (count_new_vertices(triangle) + meshlet_vertices_.size() > MAX_MESHLET_VERTICES ||
+                    meshlet_triangles_.size() == MAX_MESHLET_TRIANGLES) {
+                    flush();
+                }
+            }
+
+            add_triangle(triangle);
+        }
+        flush();
+
+        return std::move(result_);
+    }
+
+  private:
+    void weld(u32 num_vertices) {
+        // welded vertices are numbered densely, each remembers the first corner it came from
+        std::unordered_map<VertexKey, u32, VertexKeyHash> unique_indices;
+        unique_indices.reserve(num_vertices);
+
+        std::vector<u32> indices(num_vertices);
+        for (u32 i = 0; i < num_vertices; ++i) {
+            auto [it, inserted] = unique_indices.try_emplace(VertexKey{vertices_[i]}, (u32)unique_vertices_.size());
+            if (inserted) {
+                unique_vertices_.push_back(i);
+            }
+            indices[i] = it->second;
+        }
+
+        for (u32 i = 0; i + 2 < num_vertices; i += 3) {
+            std::array<u32, 3> triangle = {indices[i], indices[i + 1], indices[i + 2]};
+            if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) {
+                continue; // degenerate, it wouldn't cover anything
+            }
+            triangles_.push_back(triangle);
+        }
+    }
+
+    void build_adjacency() {
+        // the triangles around each vertex, packed one vertex after another
+        adjacency_offsets_.assign(unique_vertices_.size() + 1, 0);
+        for (const std::array<u32, 3>& triangle : triangles_) {
+            for (u32 index : triangle) {
+                ++adjacency_offsets_[index + 1];
+            }
+        }
+
+        for (u32 i = 0; i < unique_vertices_.size(); ++i) {
+            adjacency_offsets_[i + 1] += adjacency_offsets_[i];
+        }
+
+        std::vector<u32> fill = adjacency_offsets_;
+        adjacent_triangles_.resize(triangles_.size() * 3);
+        for (u32 t = 0; t < triangles_.size(); ++t) {
+            for (u32 index : triangles_[t]) {
+                adjacent_triangles_[fill[index]++] = t;
+            }
+        }
+    }
+
+    [[nodiscard]] u32 count_new_vertices(u32 triangle) const {
+        u32 num_new = 0;
+        for (u32 index : triangles_[triangle]) {
+            num_new += local_indices_[index] == NONE ? 1 : 0;
+        }
+        return num_new;
+    }
+
+    /**
+     * Find the triangle touching the current meshlet that adds the fewest vertices to it and still fits
+     * @param has_neighbors Set if any triangle touches the meshlet, even if none of them fit
+     * @return The triangle, or NONE
+     */
+    u32 find_best_neighbor(bool& has_neighbors) const {
+        if (meshlet_triangles_.size() == MAX_MESHLET_TRIANGLES) {
+            has_neighbors = true;
+            return NONE;
+        }
+
+        u32 best          = NONE;
+        u32 best_num_new  = NONE;
+        u32 vertices_left = MAX_MESHLET_VERTICES - meshlet_vertices_.size();
+        for (u32 vertex : meshlet_vertices_) {
+            for (u32 i = adjacency_offsets_[vertex]; i < adjacency_offsets_[vertex + 1]; ++i) {
+                u32 triangle = adjacent_triangles_[i];
+                if (is_emitted_[triangle]) {
+                    continue;
+                }
+                has_neighbors = true;
+
+                // ties go to the earlier triangle so the result doesn't depend on the order vertices were added in
+                u32  num_new   = count_new_vertices(triangle);
+                bool is_better = num_new < best_num_new || (num_new == best_num_new && triangle < best);
+                if (num_new <= vertices_left && is_better) {
+                    best         = triangle;
+                    best_num_new = num_new;
+                }
+            }
+        }
+
+        return best;
+    }
+
+    void add_triangle(u32 triangle) {
+        u32 packed = 0;
+        for (u32 corner = 0; corner < 3; ++corner) {
+            u32 index = triangles_[triangle][corner];
+            if (local_indices_[index] == NONE) {
+                local_indices_[index] = meshlet_vertices_.size();
+                meshlet_vertices_.push_back(index);
+            }
+            packed |= local_indices_[index] << (corner * 8);
+        }
+
+        meshlet_triangles_.push_back(packed);
+        is_emitted_[triangle] = true;
+    }
+
+    glm::vec3 get_position(u32 unique_index) const {
+        const Vertex& v = vertices_[unique_vertices_[unique_index]];
+        return {v.x, v.y, v.z};
+    }
+
+    void flush() {
+        if (meshlet_triangles_.empty()) {
+            return;
+        }
+
+        Meshlet meshlet         = {};
+        meshlet.vertex_offset   = result_.vertices.size();
+        meshlet.triangle_offset = result_.triangles.size();
+        meshlet.vertex_count    = meshlet_vertices_.size();
+        meshlet.triangle_count  = meshlet_triangles_.size();
+
+        // bounding sphere around the center of the aabb, like the mesh's
+        glm::vec3 min_position = glm::vec3(std::numeric_limits<f32>::max());
+        glm::vec3 max_position = glm::vec3(std::numeric_limits<f32>::lowest());
+        for (u32 vertex : meshlet_vertices_) {
+            min_position = glm::min(min_position, get_position(vertex));
+            max_position = glm::max(max_position, get_position(vertex));
+        }
+
+        glm::vec3 center = (min_position + max_position) * 0.5f;
+        f32       radius = 0.0f;
+        for (u32 vertex : meshlet_vertices_) {
+            radius = glm::max(radius, glm::distance(center, get_position(vertex)));
+        }
+        meshlet.bounding_sphere = glm::vec4(center, radius);
+
+        // the cone axis is the average of the triangle normals and it's as wide as the normal furthest from it
+        std::array<glm::vec3, MAX_MESHLET_TRIANGLES> normals;
+        u32                                          num_normals = 0;
+        glm::vec3                                    normal_sum  = glm::vec3(0);
+        for (u32 packed : meshlet_triangles_) {
+            glm::vec3 p0     = get_position(meshlet_vertices_[packed & 0xff]);
+            glm::vec3 p1     = get_position(meshlet_vertices_[(packed >> 8) & 0xff]);
+            glm::vec3 p2     = get_position(meshlet_vertices_[(packed >> 16) & 0xff]);
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+
+            f32 length = glm::length(normal);
+            if (length > 0.0f) {
+                normals[num_normals++] = normal / length;
+                normal_sum += normal / length;
+            }
+        }
+
+        meshlet.cone = glm::vec4(0, 0, 0, 1);
+        if (glm::length(normal_sum) > 0.0f) {
+            glm::vec3 axis    = glm::normalize(normal_sum);
+            f32       min_dot = 1.0f;
+            for (u32 i = 0; i < num_normals; ++i) {
+                min_dot = glm::min(min_dot, glm::dot(normals[i], axis));
+            }
+
+            // a cone wider than a hemisphere can't be behind a plane, so it's never culled
+            if (min_dot > 0.0f) {
+                meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - min_dot * min_dot));
+            }
+        }
+
+        for (u32 vertex : meshlet_vertices_) {
+            result_.vertices.push_back(unique_vertices_[vertex]);
+            local_indices_[vertex] = NONE;
+        }
+        result_.triangles.insert(result_.triangles.end(), meshlet_triangles_.begin(), meshlet_triangles_.end());
+        result_.meshlets.push_back(meshlet);
+
+        meshlet_vertices_.clear();
+        meshlet_triangles_.clear();
+    }
+
+    const Vertex* vertices_;
+
+    std::vector<u32>                unique_vertices_; // welded vertex -> first corner with its attributes
+    std::vector<std::array<u32, 3>> triangles_;       // welded vertices of each non-degenerate triangle
+    std::vector<u32>                adjacency_offsets_;
+    std::vector<u32>                adjacent_triangles_;
+
+    std::vector<bool> is_emitted_;
+    std::vector<u32>  local_indices_; // welded vertex -> index in the current meshlet, NONE if it isn't in it
+
+    // the meshlet being built
+    std::vector<u32> meshlet_vertices_;
+    std::vector<u32> meshlet_triangles_;
+
+    MeshletMesh result_;
+};
+
+} // namespace
+
+MeshletMesh build_meshlets(const Vertex* vertices, u32 num_vertices) {
+    return MeshletBuilder(vertices, num_vertices).build();
+}
+
+bool is_meshlet_backfacing(const Meshlet& meshlet, glm::vec3 camera_position) {
+    glm::vec3 center = glm::vec3(meshlet.bounding_sphere);
+    glm::vec3 offset = center - camera_position;
+    return glm::dot(offset, glm::vec3(meshlet.cone)) >=
+           meshlet.cone.w * glm::length(offset) + meshlet.bounding_sphere.w;
+}
+
+} // namespace rune::gfx
@@ -0,0 +1,57 @@
+#ifndef RUNE_MESHLET_BUILDER_H
+#define RUNE_MESHLET_BUILDER_H
+
+#include "types.h"
+#include "vertex.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace rune::gfx {
+
+// limits of a single meshlet, keep in sync with meshlet.glsl
+constexpr u32 MAX_MESHLET_VERTICES  = 64;
+constexpr u32 MAX_MESHLET_TRIANGLES = 124;
+
+/**
+ * A small cluster of a mesh's triangles that's culled and drawn on its own. Matches Meshlet in meshlet.glsl, std430
+ */
+struct Meshlet {
+    glm::vec4 bounding_sphere; // xyz is the center, w is the radius, in model space
+    glm::vec4 cone;            // xyz is the average normal, w is the cone's cutoff, 1 if it can't be backface culled
+    u32       vertex_offset;   // first index into the meshlet vertex list
+    u32       triangle_offset; // first entry in the meshlet triangle list
+    u32       vertex_count;
+    u32       triangle_count;
+};
+
+/**
+ * The meshlets of a mesh along with the lists they index into
+ */
+struct MeshletMesh {
+    std::vector<Meshlet> meshlets;
+    std::vector<u32>     vertices;  // indices into the vertices the meshlets were built from
+    std::vector<u32>     triangles; // three indices into the meshlet's vertices, one per byte from the lowest
+};
+
+/**
+ * Split a triangle list into meshlets of at most MAX_MESHLET_VERTICES vertices and MAX_MESHLET_TRIANGLES triangles.
+ * Corners with matching attributes are welded so they're shared within a meshlet, and each meshlet is grown from
+ * triangles that share the most vertices with it to keep it compact, which keeps its bounds and normal cone tight
+ * @param vertices A triangle list
+ * @param num_vertices The number of vertices, a multiple of 3
+ * @return The meshlets, their vertex indices point at the first corner with the same attributes
+ */
+MeshletMesh build_meshlets(const Vertex* vertices, u32 num_vertices);
+
+/**
+ * Whether every triangle of a meshlet faces away from a camera, see Meshlet::cone. The test is conservative, it only
+ * passes if it holds anywhere in the meshlet's bounding sphere
+ * @param meshlet The meshlet
+ * @param camera_position The position of the camera, in the same space as the meshlet
+ */
+bool is_meshlet_backfacing(const Meshlet& meshlet, glm::vec3 camera_position);
+
+} // namespace rune::gfx
+
+#endif // RUNE_MESHLET_BUILDER_H
@@ -0,0 +1,139 @@
+#include "meshlet_pass.h"
+
+#include "core.h"
+
+namespace rune::gfx {
+
+MeshletPass::MeshletPass(Core& core, GraphicsBackend& gfx, const GraphicsPassDesc& desc, bool use_mesh_shaders)
+    : core_(core), gfx_(gfx), use_mesh_shaders_(use_mesh_shaders),
+      pass_(core, gfx, get_pass_desc(desc, use_mesh_shaders)) {
+    rune_assert(core_, use_mesh_shaders_ ? gfx_.supports_mesh_shaders() : gfx_.supports_meshlets());
+
+    if (!use_mesh_shaders_) {
+        cull_pass_.emplace(core_, gfx_, ComputePassDesc{"../data/shaders/cull_meshlets.comp.spv"});
+    }
+}
+
+GraphicsPassDesc MeshletPass::get_pass_desc(GraphicsPassDesc desc, bool use_mesh_shaders) {
+    if (use_mesh_shaders) {
+        desc.vert_shader_path = nullptr;
+        desc.task_shader_path = "../data/shaders/meshlet.task.spv";
+        desc.mesh_shader_path = "../data/shaders/meshlet.mesh.spv";
+    } else {
+        desc.vert_shader_path = "../data/shaders/meshlet.vert.spv";
+        desc.task_shader_path = nullptr;
+        desc.mesh_shader_path = nullptr;
+    }
+
+    return desc;
+}
+
+bool MeshletPass::get_cull_data(const MeshBatch& batch, const Camera& camera, CullData& cull_data) const {
+    const MeshData& mesh_data = gfx_.get_mesh_data(batch.mesh.get_index());
+
+    cull_data                 = {};
+    cull_data.vp              = camera.get_view_projection_matrix();
+    cull_data.camera_position = camera.get_position();
+    cull_data.first_object    = batch.first_object_idx;
+    cull_data.first_meshlet   = mesh_data.first_meshlet;
+    cull_data.num_meshlets    = mesh_data.num_meshlets;
+
+    return batch.num_objects > 0 && mesh_data.num_meshlets > 0;
+}
+
+void MeshletPass::draw(VkCommandBuffer cmd, std::span<const MeshBatch> batches, const Camera& camera) {
+    if (!use_mesh_shaders_) {
+        cull(cmd, batches, camera);
+    }
+
+    pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_vertices", gfx_.get_unified_vertex_buffer());
+        writes.set_buffer("u_object_data", gfx_.get_object_data_buffer());
+        writes.set_buffer("u_meshlets", gfx_.get_meshlet_buffer());
+        writes.set_buffer("u_meshlet_vertices", gfx_.get_meshlet_vertex_buffer());
+        writes.set_buffer("u_meshlet_triangles", gfx_.get_meshlet_triangle_buffer());
+        writes.set_buffer("u_materials", gfx_.get_material_buffer());
+
+        if (!use_mesh_shaders_) {
+            writes.set_buffer("u_visible_meshlets", gfx_.get_visible_meshlet_buffer());
+            pass_.set_descriptors(cmd, writes);
+
+            glm::mat4 vp = camera.get_view_projection_matrix();
+            pass_.set_push_constants(cmd, VK_SHADER_STAGE_VERTEX_BIT, vp);
+
+            // one instance per visible meshlet, the count was written by the culling
+            vkCmdDrawIndirect(cmd, gfx_.get_visible_meshlet_buffer().buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+            return;
+        }
+
+        pass_.set_descriptors(cmd, writes);
+
+        // a task shader workgroup for every MESHLETS_PER_TASK meshlets of every object
+        for (const MeshBatch& batch : batches) {
+            CullData cull_data;
+            if (!get_cull_data(batch, camera, cull_data)) {
+                continue;
+            }
+
+            pass_.set_push_constants(cmd, VK_SHADER_STAGE_TASK_BIT_EXT, cull_data);
+            gfx_.draw_mesh_tasks(cmd,
+                                 (cull_data.num_meshlets + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK,
+                                 batch.num_objects);
+        }
+    });
+}
+
+void MeshletPass::cull(VkCommandBuffer cmd, std::span<const MeshBatch> batches, const Camera& camera) {
+    Buffer visible_meshlets = gfx_.get_visible_meshlet_buffer();
+
+    // on its own queue the culling only has to finish before the draw, the semaphore between them makes the list
+    // visible to it
+    bool is_async = gfx_.supports_async_compute();
+    if (is_async) {
+        cmd = gfx_.get_async_compute_command_buffer(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                                    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+    }
+
+    // reset the draw, each instance has room for a full meshlet
+    VkDrawIndirectCommand draw = {};
+    draw.vertexCount           = MAX_MESHLET_TRIANGLES * 3;
+    vkCmdUpdateBuffer(cmd, visible_meshlets.buffer, 0, sizeof(draw), &draw);
+
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    cull_pass_->run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_object_data", gfx_.get_object_data_buffer());
+        writes.set_buffer("u_meshlets", gfx_.get_meshlet_buffer());
+        writes.set_buffer("u_visible_meshlets", visible_meshlets);
+        cull_pass_->set_descriptors(cmd, writes);
+
+        for (const MeshBatch& batch : batches) {
+            CullData cull_data;
+            if (!get_cull_data(batch, camera, cull_data)) {
+                continue;
+            }
+
+            cull_pass_->set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, cull_data);
+            ComputePass::dispatch(cmd, {cull_data.num_meshlets, batch.num_objects}, {WORKGROUP_SIZE, 1});
+        }
+    });
+
+    if (is_async) {
+        return;
+    }
+
+    // the draw is read by the indirect draw, the list by the vertex shader
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+} // namespace rune::gfx
@@ -0,0 +1,86 @@
+#ifndef RUNE_MESHLET_PASS_H
+#define RUNE_MESHLET_PASS_H
+
+#include "gfx/camera.h"
+#include "gfx/compute_pass.h"
+#include "gfx/graphics_backend.h"
+#include "gfx/graphics_pass.h"
+
+#include <optional>
+#include <span>
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+/**
+ * Draws meshes as meshlets, each one is culled against the frustum and by its normal cone so an object that's partly
+ * off screen or facing away only draws the clusters that can be seen.
+ * With mesh shaders a task shader culls the meshlets of an object and launches a mesh shader for each visible one.
+ * Without them a compute pass appends the visible meshlets to a list, and the list is drawn with a single indirect
+ * draw whose vertex shader pulls each meshlet's triangles
+ * @note Check GraphicsBackend::supports_meshlets before using
+ */
+class MeshletPass {
+  public:
+    /**
+     * @param desc The graphics pass to draw in, its vertex, task and mesh shaders are replaced
+     * @param use_mesh_shaders Whether to use mesh shaders, needs GraphicsBackend::supports_mesh_shaders. If not, the
+     * compute fallback is used
+     */
+    explicit MeshletPass(Core& core, GraphicsBackend& gfx, const GraphicsPassDesc& desc, bool use_mesh_shaders);
+
+    /**
+     * Record culling and drawing the meshlets of every object in a set of batches
+     * @note Must be recorded outside of a graphics pass, after the frame's object data was added
+     * @param cmd The command buffer to record to
+     * @param batches The batches to draw, their objects are read from GraphicsBackend::get_object_data_buffer()
+     * @param camera The camera to cull and draw with
+     */
+    void draw(VkCommandBuffer cmd, std::span<const MeshBatch> batches, const Camera& camera);
+
+    [[nodiscard]] bool is_using_mesh_shaders() const {
+        return use_mesh_shaders_;
+    }
+
+  private:
+    // local_size_x of meshlet.task and cull_meshlets.comp
+    static constexpr u32 MESHLETS_PER_TASK = 32;
+    static constexpr u32 WORKGROUP_SIZE    = 64;
+
+    // matches the push constants of meshlet.task, meshlet.mesh and cull_meshlets.comp
+    struct CullData {
+        glm::mat4 vp;
+        glm::vec3 camera_position;
+        u32       first_object;
+        u32       first_meshlet;
+        u32       num_meshlets;
+    };
+
+    static GraphicsPassDesc get_pass_desc(GraphicsPassDesc desc, bool use_mesh_shaders);
+
+    /**
+     * Fill the culling data of a batch
+     * @return Whether the batch has anything to draw
+     */
+    bool get_cull_data(const MeshBatch& batch, const Camera& camera, CullData& cull_data) const;
+
+    /**
+     * Record culling the meshlets of the batches into the visible meshlet list, for the compute fallback. It's recorded
+     * to the async compute queue if there is one
+     */
+    void cull(VkCommandBuffer cmd, std::span<const MeshBatch> batches, const Camera& camera);
+
+    Core&            core_;
+    GraphicsBackend& gfx_;
+    bool             use_mesh_shaders_;
+
+    GraphicsPass               pass_;
+    std::optional<ComputePass> cull_pass_; // only used by the fallback
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_MESHLET_PASS_H
@@ -0,0 +1,214 @@
+#include "particle_system.h"
+
+#include "constants.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace rune::gfx {
+
+ParticleSystem::ParticleSystem(Core& core, GraphicsBackend& gfx, const GraphicsPassDesc& desc)
+    : gfx_(gfx), emit_pass_(core, gfx, {"../data/shaders/particle_emit.comp.spv"}),
+      simulate_pass_(core, gfx, {"../data/shaders/particle_simulate.comp.spv"}),
+      counts_pass_(core, gfx, {"../data/shaders/particle_counts.comp.spv"}),
+      sort_pass_(core, gfx, {"../data/shaders/particle_sort.comp.spv"}), draw_pass_(core, gfx, get_pass_desc(desc)) {
+    for (Buffer& particles : particles_) {
+        particles = gfx_.create_storage_buffer_gpu(sizeof(Particle) * MAX_PARTICLES);
+    }
+    draw_list_ = gfx_.create_storage_buffer_gpu(sizeof(glm::uvec2) * MAX_PARTICLES);
+    counters_  = gfx_.create_storage_buffer_gpu(sizeof(Counters), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+}
+
+GraphicsPassDesc ParticleSystem::get_pass_desc(GraphicsPassDesc desc) {
+    desc.vert_shader_path = "../data/shaders/particle.vert.spv";
+    desc.frag_shader_path = "../data/shaders/particle.frag.spv";
+    desc.task_shader_path = nullptr;
+    desc.mesh_shader_path = nullptr;
+
+    // tested against what's drawn, but they don't hide each other since they're blended
+    desc.depth.test       = true;
+    desc.depth.write      = false;
+    desc.depth.compare_op = VK_COMPARE_OP_LESS;
+    desc.is_blended       = true;
+
+    return desc;
+}
+
+void ParticleSystem::simulate(VkCommandBuffer                  cmd,
+                              std::span<const ParticleEmitter> emitters,
+                              const Camera&                    camera,
+                              f32                              time) {
+    // nothing moves or is emitted until the second frame, there's no step before the first
+    f32 time_step = is_started_ ? std::clamp(time - time_, 0.0f, MAX_TIME_STEP) : 0.0f;
+    time_         = time;
+
+    // the last frame's draw reads the draw list and counters that are written again
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                        0,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0);
+
+    // nothing's been written this frame, and the draw list's entries without a particle sort last
+    if (!is_started_) {
+        vkCmdFillBuffer(cmd, counters_.buffer, 0, VK_WHOLE_SIZE, 0);
+        is_started_ = true;
+    } else {
+        vkCmdFillBuffer(cmd, counters_.buffer, offsetof(Counters, num_written), sizeof(u32), 0);
+    }
+    vkCmdFillBuffer(cmd, draw_list_.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    const Buffer& last_particles = particles_[current_particles_];
+    current_particles_ ^= 1;
+    const Buffer& particles = particles_[current_particles_];
+
+    simulate_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_counters", counters_);
+        writes.set_buffer("u_draw_list", draw_list_);
+        writes.set_buffer("u_particles_in", last_particles);
+        writes.set_buffer("u_particles_out", particles);
+        simulate_pass_.set_descriptors(cmd, writes);
+
+        SimulateData simulate_data    = {};
+        simulate_data.camera_position = camera.get_position();
+        simulate_data.time_step       = time_step;
+        simulate_data.acceleration    = -GRAVITY * consts::UP;
+        simulate_pass_.set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, simulate_data);
+
+        // sized by last frame's count
+        vkCmdDispatchIndirect(cmd, counters_.buffer, offsetof(Counters, simulate));
+    });
+
+    // the particles that are still alive are written first, the emitted ones only take the room that's left
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    emit_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_counters", counters_);
+        writes.set_buffer("u_draw_list", draw_list_);
+        writes.set_buffer("u_particles_out", particles);
+        emit_pass_.set_descriptors(cmd, writes);
+
+        for (const ParticleEmitter& emitter : emitters) {
+            // as many as it emits in the step, counted from the start of time so fractions carry over between frames
+            f64 rate          = emitter.rate;
+            f64 num_particles = std::floor(rate * time) - std::floor(rate * (time - time_step));
+            if (num_particles <= 0.0) {
+                continue;
+            }
+
+            EmitData emit_data        = {};
+            emit_data.position        = emitter.position;
+            emit_data.radius          = emitter.radius;
+            emit_data.velocity        = emitter.velocity;
+            emit_data.spread          = emitter.spread;
+            emit_data.color           = emitter.color;
+            emit_data.camera_position = camera.get_position();
+            emit_data.lifetime        = emitter.lifetime;
+            emit_data.size            = emitter.size;
+            emit_data.num_particles   = (u32)std::min(num_particles, (f64)MAX_PARTICLES);
+            emit_data.seed            = seed_++;
+            emit_pass_.set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, emit_data);
+
+            ComputePass::dispatch(cmd, emit_data.num_particles, WORKGROUP_SIZE);
+        }
+    });
+
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    counts_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_counters", counters_);
+        counts_pass_.set_descriptors(cmd, writes);
+
+        u32 max_particles = MAX_PARTICLES;
+        counts_pass_.set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, max_particles);
+
+        vkCmdDispatch(cmd, 1, 1, 1);
+    });
+
+    // the sort's dispatches are sized by the counts
+    gfx_.memory_barrier(cmd,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    sort(cmd);
+}
+
+void ParticleSystem::sort(VkCommandBuffer cmd) {
+    sort_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_draw_list", draw_list_);
+        sort_pass_.set_descriptors(cmd, writes);
+
+        // the dispatches all cover the start of the draw list that holds the particles, see particle_sort.comp
+        auto sort_step = [&](u32 k, u32 j) {
+            struct SortData {
+                u32 k;
+                u32 j;
+            } sort_data = {};
+            sort_data.k = k;
+            sort_data.j = j;
+            sort_pass_.set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, sort_data);
+
+            vkCmdDispatchIndirect(cmd, counters_.buffer, offsetof(Counters, sort));
+            gfx_.memory_barrier(cmd,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_ACCESS_SHADER_WRITE_BIT,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        };
+
+        // every block is sorted in shared memory, then each stage that merges blocks takes a dispatch per step whose
+        // pairs are in different blocks, and one for the rest of its steps
+        sort_step(2, 1);
+        for (u32 k = 2 * SORT_BLOCK_SIZE; k <= MAX_PARTICLES; k *= 2) {
+            for (u32 j = k / 2; j >= SORT_BLOCK_SIZE; j /= 2) {
+                sort_step(k, j);
+            }
+            sort_step(k, SORT_BLOCK_SIZE / 2);
+        }
+    });
+}
+
+void ParticleSystem::draw(VkCommandBuffer cmd, const Camera& camera) {
+    draw_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_particles", particles_[current_particles_]);
+        writes.set_buffer("u_draw_list", draw_list_);
+        draw_pass_.set_descriptors(cmd, writes);
+
+        struct DrawData {
+            glm::mat4 vp;
+            glm::vec4 right;
+            glm::vec4 up;
+        } draw_data     = {};
+        draw_data.vp    = camera.get_view_projection_matrix();
+        draw_data.right = glm::vec4(glm::normalize(camera.get_right()), 0.0f);
+        draw_data.up    = glm::vec4(glm::normalize(camera.get_up()), 0.0f);
+        draw_pass_.set_push_constants(cmd, VK_SHADER_STAGE_VERTEX_BIT, draw_data);
+
+        // a quad per particle, the count was written by the simulation
+        vkCmdDrawIndirect(cmd, counters_.buffer, offsetof(Counters, draw), 1, sizeof(VkDrawIndirectCommand));
+    });
+}
+
+} // namespace rune::gfx
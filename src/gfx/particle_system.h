@@ -0,0 +1,151 @@
+#ifndef RUNE_PARTICLE_SYSTEM_H
+#define RUNE_PARTICLE_SYSTEM_H
+
+#include "gfx/camera.h"
+#include "gfx/compute_pass.h"
+#include "gfx/graphics_backend.h"
+#include "gfx/graphics_pass.h"
+
+#include <bit>
+#include <span>
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+/**
+ * Emits particles for a frame, see ParticleSystem::simulate
+ */
+struct ParticleEmitter {
+    glm::vec3 position = glm::vec3(0.0f);
+    f32       radius   = 0.0f; // particles start anywhere this close to the position
+    glm::vec3 velocity = glm::vec3(0.0f);
+    f32       spread   = 0.0f; // up to this much speed is added in a random direction
+    glm::vec4 color    = glm::vec4(1.0f); // fades out over the particle's life
+    f32       rate     = 0.0f;            // particles per second
+    f32       lifetime = 1.0f;            // in seconds
+    f32       size     = 0.05f;           // world units across
+};
+
+/**
+ * Particles that only live on the gpu. Every frame compute shaders move last frame's particles and compact the ones
+ * still alive into a second list, append the newly emitted ones, and sort them back to front into a draw list. The
+ * draw list is drawn with one indirect draw of a camera facing quad per particle, whose instance count is the gpu
+ * written number of particles, so the cpu never touches a particle or reads the count back. The cpu only records a
+ * dispatch per emitter and the same dispatches for the sort whatever the count
+ */
+class ParticleSystem {
+  public:
+    /**
+     * @param desc The graphics pass to draw in, it has to load what's drawn before it. Its shaders are replaced, and
+     * it blends and doesn't write depth
+     */
+    explicit ParticleSystem(Core& core, GraphicsBackend& gfx, const GraphicsPassDesc& desc);
+
+    /**
+     * Record emitting this frame's particles, moving the ones that are alive and sorting them for the camera
+     * @note Must be recorded outside of a graphics pass. The draw has to wait for the compute shaders, see RenderGraph
+     * @param cmd The command buffer to record to
+     * @param emitters What emits particles this frame, each emits as many as it would have since the last frame
+     * @param camera The camera the particles are drawn with
+     * @param time The time of this frame in seconds, particles move by how much it advanced since the last frame
+     */
+    void simulate(VkCommandBuffer cmd, std::span<const ParticleEmitter> emitters, const Camera& camera, f32 time);
+
+    /**
+     * Record drawing the particles as the last simulate sorted them, blended over what's drawn
+     * @param cmd The command buffer to record to
+     * @param camera The camera they were sorted for
+     */
+    void draw(VkCommandBuffer cmd, const Camera& camera);
+
+  private:
+    // local_size_x of the emission and simulation shaders, and of the sort, which sorts blocks of twice as many
+    // entries in shared memory. See particles.glsl
+    static constexpr u32 WORKGROUP_SIZE      = 64;
+    static constexpr u32 SORT_WORKGROUP_SIZE = 512;
+    static constexpr u32 SORT_BLOCK_SIZE     = 2 * SORT_WORKGROUP_SIZE;
+
+    // the most particles alive at once, a power of two so the whole draw list can be sorted
+    static constexpr u32 MAX_PARTICLES = 256 * 1024;
+    static_assert(std::has_single_bit(MAX_PARTICLES) && MAX_PARTICLES >= SORT_BLOCK_SIZE);
+
+    // a frame's step is capped so a hitch doesn't throw particles through the scene or emit a burst
+    static constexpr f32 MAX_TIME_STEP = 0.1f;
+
+    // every particle falls
+    static constexpr f32 GRAVITY = 9.81f;
+
+    // matches Particle in particles.glsl, std430
+    struct Particle {
+        glm::vec3 position;
+        f32       size;
+        glm::vec3 velocity;
+        f32       age;
+        glm::vec4 color;
+        f32       lifetime;
+        f32       padding_[3];
+    };
+
+    // matches ParticleCounterBuffer in the particle shaders, written by them
+    struct Counters {
+        VkDrawIndirectCommand     draw;          // a quad per particle in the draw list
+        VkDispatchIndirectCommand simulate;      // an invocation per particle in the draw list, next frame
+        VkDispatchIndirectCommand sort;          // a workgroup per block of the draw list that holds particles
+        u32                       num_particles; // in the draw list
+        u32                       num_written;   // counted up as this frame's particles are written, can overshoot
+    };
+
+    // matches the push constants of particle_emit.comp
+    struct EmitData {
+        glm::vec3 position;
+        f32       radius;
+        glm::vec3 velocity;
+        f32       spread;
+        glm::vec4 color;
+        glm::vec3 camera_position;
+        f32       lifetime;
+        f32       size;
+        u32       num_particles;
+        u32       seed;
+    };
+
+    // matches the push constants of particle_simulate.comp
+    struct SimulateData {
+        glm::vec3 camera_position;
+        f32       time_step;
+        glm::vec3 acceleration;
+    };
+
+    static GraphicsPassDesc get_pass_desc(GraphicsPassDesc desc);
+
+    /**
+     * Record sorting the draw list back to front, after the counts were written
+     */
+    void sort(VkCommandBuffer cmd);
+
+    GraphicsBackend& gfx_;
+
+    ComputePass  emit_pass_;
+    ComputePass  simulate_pass_;
+    ComputePass  counts_pass_;
+    ComputePass  sort_pass_;
+    GraphicsPass draw_pass_;
+
+    // last frame's particles and this frame's, they swap every simulate. The particles that are alive fill the start
+    Buffer particles_[2];
+    u32    current_particles_ = 0;
+
+    Buffer draw_list_; // a sort key and index into this frame's particles for each of them, back to front once sorted
+    Buffer counters_;  // a Counters
+
+    bool is_started_ = false;
+    f32  time_       = 0.0f; // of the last simulate
+    u32  seed_       = 0;    // counts emissions, so each gets its own random numbers
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_PARTICLE_SYSTEM_H
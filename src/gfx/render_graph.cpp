@@ -0,0 +1,472 @@
+#include "render_graph.h"
+
+#include "core.h"
+#include "gfx/graphics_backend.h"
+
+#include <algorithm>
+
+namespace rune::gfx {
+
+// the access bits that make memory another access has to wait on, the rest only ever need to be made visible to
+static constexpr VkAccessFlags2KHR WRITE_ACCESS =
+    VK_ACCESS_2_SHADER_WRITE_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR |
+    VK_ACCESS_2_HOST_WRITE_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+
+static bool is_overlapping(VkDeviceSize a_offset, VkDeviceSize a_size, VkDeviceSize b_offset, VkDeviceSize b_size) {
+    return a_offset < b_offset + b_size && b_offset < a_offset + a_size;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(ResourceId               resource,
+                                                         VkPipelineStageFlags2KHR stages,
+                                                         VkAccessFlags2KHR        access,
+                                                         VkImageLayout            layout) {
+    graph_.passes_[pass_].accesses.push_back({resource, stages, access, layout, layout, false, false});
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(ResourceId               resource,
+                                                          VkPipelineStageFlags2KHR stages,
+                                                          VkAccessFlags2KHR        access,
+                                                          VkImageLayout            layout) {
+    graph_.passes_[pass_].accesses.push_back({resource, stages, access, layout, layout, true, false});
+    return *this;
+}
+
+RenderGraph::PassBuilder&
+RenderGraph::PassBuilder::attachment(ResourceId image, VkImageLayout initial_layout, VkImageLayout final_layout) {
+    // the render pass loads and stores the attachment in the stages that touch its aspect
+    bool                     is_depth = graph_.resources_[image].aspect & VK_IMAGE_ASPECT_DEPTH_BIT;
+    VkPipelineStageFlags2KHR stages   = is_depth ? VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR |
+                                                     VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR
+                                                 : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+    VkAccessFlags2KHR        access   = is_depth ? VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR |
+                                                     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR
+                                                 : VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR |
+                                                     VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR;
+
+    graph_.passes_[pass_].accesses.push_back({image, stages, access, initial_layout, final_layout, true, true});
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::set_side_effects() {
+    graph_.passes_[pass_].has_side_effects = true;
+    return *this;
+}
+
+RenderGraph::RenderGraph(Core& core, GraphicsBackend& gfx) : core_(core), gfx_(gfx) {}
+
+RenderGraph::ResourceId RenderGraph::import_buffer(const char* name) {
+    Resource resource     = {};
+    resource.name         = name;
+    resource.type         = ResourceType::BUFFER;
+    resource.is_transient = false;
+
+    resources_.emplace_back(resource);
+    return resources_.size() - 1;
+}
+
+RenderGraph::ResourceId RenderGraph::import_image(const char*        name,
+                                                  VkImageAspectFlags aspect,
+                                                  VkImageLayout      initial_layout,
+                                                  VkImageLayout      final_layout) {
+    Resource resource       = {};
+    resource.name           = name;
+    resource.type           = ResourceType::IMAGE;
+    resource.is_transient   = false;
+    resource.aspect         = aspect;
+    resource.initial_layout = initial_layout;
+    resource.final_layout   = final_layout;
+
+    resources_.emplace_back(resource);
+    return resources_.size() - 1;
+}
+
+RenderGraph::ResourceId RenderGraph::create_image(const char* name, const ImageDesc& desc) {
+    Resource resource       = {};
+    resource.name           = name;
+    resource.type           = ResourceType::IMAGE;
+    resource.is_transient   = true;
+    resource.desc           = desc;
+    resource.aspect         = desc.aspect;
+    resource.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.final_layout   = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    resources_.emplace_back(resource);
+    return resources_.size() - 1;
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(const char* name, Execute execute) {
+    rune_assert(core_, !is_compiled_);
+
+    Pass pass    = {};
+    pass.name    = name;
+    pass.execute = std::move(execute);
+    passes_.emplace_back(std::move(pass));
+
+    return PassBuilder(*this, passes_.size() - 1);
+}
+
+void RenderGraph::compile() {
+    rune_assert(core_, !is_compiled_);
+
+    cull_passes();
+
+    // a transient image lives from the first live pass that uses it to the last
+    for (u32 i = 0; i < passes_.size(); ++i) {
+        if (!passes_[i].is_live) {
+            continue;
+        }
+
+        for (const Access& access : passes_[i].accesses) {
+            Resource& resource = resources_[access.resource];
+            if (resource.first_pass == NO_PASS) {
+                resource.first_pass = i;
+            }
+            resource.last_pass = i;
+        }
+    }
+
+    allocate_transients();
+    plan_barriers();
+
+    is_compiled_ = true;
+}
+
+void RenderGraph::set_image(ResourceId image, const Image& bound_image) {
+    rune_assert(core_, resources_[image].type == ResourceType::IMAGE && !resources_[image].is_transient);
+    resources_[image].image = bound_image;
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd) {
+    rune_assert(core_, is_compiled_);
+
+    for (const Pass& pass : passes_) {
+        if (pass.is_live) {
+            record_barrier(cmd, pass.barrier);
+            pass.execute(cmd);
+        }
+    }
+    record_barrier(cmd, final_barrier_);
+}
+
+void RenderGraph::cull_passes() {
+    // walk back from the passes that have to run, keeping the passes that write what a kept pass reads
+    std::vector<bool> is_needed(resources_.size(), false);
+    for (u32 i = passes_.size(); i-- > 0;) {
+        Pass& pass   = passes_[i];
+        pass.is_live = pass.has_side_effects;
+        for (const Access& access : pass.accesses) {
+            if (access.is_write && (!resources_[access.resource].is_transient || is_needed[access.resource])) {
+                pass.is_live = true;
+            }
+        }
+
+        if (!pass.is_live) {
+            core_.get_logger().info("render graph culled pass %, nothing uses what it writes", pass.name);
+            continue;
+        }
+
+        // loading an attachment reads what was drawn to it before
+        for (const Access& access : pass.accesses) {
+            if (!access.is_write || (access.is_attachment && access.layout != VK_IMAGE_LAYOUT_UNDEFINED)) {
+                is_needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::allocate_transients() {
+    std::vector<ResourceId>   transients;
+    std::vector<VkDeviceSize> alignments(resources_.size(), 1);
+    VkMemoryRequirements      combined = {};
+    combined.alignment                 = 1;
+    combined.memoryTypeBits            = ~0u;
+    for (ResourceId id = 0; id < resources_.size(); ++id) {
+        Resource& resource = resources_[id];
+        if (!resource.is_transient || resource.first_pass == NO_PASS) {
+            continue;
+        }
+
+        VkMemoryRequirements requirements;
+        resource.image = gfx_.create_image_unbound(resource.desc.extent,
+                                                   resource.desc.format,
+                                                   resource.desc.usage,
+                                                   resource.desc.mip_levels,
+                                                   requirements);
+        resource.size  = requirements.size;
+        alignments[id] = requirements.alignment;
+
+        combined.alignment = std::max(combined.alignment, requirements.alignment);
+        combined.memoryTypeBits &= requirements.memoryTypeBits;
+        transients.emplace_back(id);
+    }
+
+    if (transients.empty()) {
+        return;
+    }
+    if (combined.memoryTypeBits == 0) {
+        core_.get_logger().fatal("render graph transient images have no memory type in common");
+    }
+
+    // the biggest images first, each at the lowest offset that doesn't overlap an image alive at the same time
+    std::sort(transients.begin(), transients.end(), [&](ResourceId a, ResourceId b) {
+        return resources_[a].size > resources_[b].size;
+    });
+
+    VkDeviceSize unaliased_size = 0;
+    for (u32 i = 0; i < transients.size(); ++i) {
+        Resource&    resource  = resources_[transients[i]];
+        VkDeviceSize alignment = alignments[transients[i]];
+        unaliased_size += resource.size;
+
+        auto is_alive_with = [&](const Resource& other) {
+            return resource.first_pass <= other.last_pass && other.first_pass <= resource.last_pass;
+        };
+
+        // an image can go at the start or right after one it would share the memory with
+        VkDeviceSize best_offset = ~0ull;
+        for (u32 j = 0; j <= i; ++j) {
+            VkDeviceSize candidate = 0;
+            if (j < i) {
+                const Resource& placed = resources_[transients[j]];
+                if (!is_alive_with(placed)) {
+                    continue;
+                }
+                candidate = (placed.offset + placed.size + alignment - 1) / alignment * alignment;
+            }
+            if (candidate >= best_offset) {
+                continue;
+            }
+
+            bool is_free = true;
+            for (u32 k = 0; k < i && is_free; ++k) {
+                const Resource& placed = resources_[transients[k]];
+                is_free = !is_alive_with(placed) ||
+                          !is_overlapping(candidate, resource.size, placed.offset, placed.size);
+            }
+            if (is_free) {
+                best_offset = candidate;
+            }
+        }
+
+        resource.offset = best_offset;
+        combined.size   = std::max(combined.size, resource.offset + resource.size);
+    }
+
+    VmaAllocation allocation = gfx_.allocate_image_memory(combined);
+    for (ResourceId id : transients) {
+        Resource& resource = resources_[id];
+        gfx_.bind_image_memory(resource.image, allocation, resource.offset, resource.aspect);
+    }
+
+    transient_memory_size_ = combined.size;
+    core_.get_logger().info("render graph placed % transient images in % bytes, % without aliasing",
+                            transients.size(),
+                            combined.size,
+                            unaliased_size);
+}
+
+void RenderGraph::plan_barriers() {
+    // what happened to each resource so far
+    struct State {
+        VkPipelineStageFlags2KHR write_stages   = 0; // of the last write or layout transition
+        VkAccessFlags2KHR        write_access   = 0;
+        VkPipelineStageFlags2KHR read_stages    = 0; // since the last write
+        VkPipelineStageFlags2KHR visible_stages = 0; // that the last write was made visible to
+        VkAccessFlags2KHR        visible_access = 0;
+        VkImageLayout            layout         = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool                     is_used        = false;
+    };
+
+    std::vector<State> states(resources_.size());
+    for (ResourceId id = 0; id < resources_.size(); ++id) {
+        states[id].layout = resources_[id].initial_layout;
+    }
+
+    // a transient image's first use waits for every image it shares memory with to be done with it, including itself
+    // from the frame before
+    auto get_alias_stages = [&](const Resource& resource, VkAccessFlags2KHR& write_access) {
+        VkPipelineStageFlags2KHR stages = 0;
+        write_access                    = 0;
+        for (const Pass& pass : passes_) {
+            if (!pass.is_live) {
+                continue;
+            }
+
+            for (const Access& access : pass.accesses) {
+                const Resource& other = resources_[access.resource];
+                if (other.is_transient && other.first_pass != NO_PASS &&
+                    is_overlapping(resource.offset, resource.size, other.offset, other.size)) {
+                    stages |= access.stages;
+                    write_access |= access.access & WRITE_ACCESS;
+                }
+            }
+        }
+        return stages;
+    };
+
+    for (Pass& pass : passes_) {
+        if (!pass.is_live) {
+            continue;
+        }
+
+        Barrier& barrier = pass.barrier;
+        for (const Access& access : pass.accesses) {
+            const Resource& resource = resources_[access.resource];
+            State&          state    = states[access.resource];
+
+            bool needs_transition = resource.type == ResourceType::IMAGE &&
+                                    access.layout != VK_IMAGE_LAYOUT_UNDEFINED && access.layout != state.layout;
+
+            VkPipelineStageFlags2KHR src_stages = state.write_stages | state.read_stages;
+            VkAccessFlags2KHR        src_access = state.write_access;
+            if (!state.is_used && resource.is_transient) {
+                src_stages |= get_alias_stages(resource, src_access);
+            } else if (!state.is_used && needs_transition) {
+                // whatever used the imported image before the graph
+                src_stages |= VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+                src_access |= VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+            }
+            bool is_first_use = !state.is_used;
+            state.is_used     = true;
+
+            if (access.is_attachment) {
+                // the render pass waits for earlier passes and transitions the image itself, from the layout it
+                // expects. Unless it clears the image, it has to be in that layout already
+                if (needs_transition) {
+                    barrier.images.push_back({access.resource,
+                                              src_stages,
+                                              src_access,
+                                              access.stages,
+                                              access.access,
+                                              state.layout,
+                                              access.layout});
+                } else if (is_first_use && resource.is_transient) {
+                    // its external dependency doesn't cover every stage an image sharing the memory could be used in
+                    barrier.src_stages |= src_stages;
+                    barrier.src_access |= src_access;
+                    barrier.dst_stages |= access.stages;
+                    barrier.dst_access |= access.access;
+                }
+
+                state.write_stages   = access.stages;
+                state.write_access   = access.access & WRITE_ACCESS;
+                state.read_stages    = 0;
+                state.visible_stages = 0;
+                state.visible_access = 0;
+                state.layout         = access.final_layout;
+                continue;
+            }
+
+            if (needs_transition) {
+                barrier.images.push_back({access.resource,
+                                          src_stages,
+                                          src_access,
+                                          access.stages,
+                                          access.access,
+                                          state.layout,
+                                          access.layout});
+                state.layout = access.layout;
+            } else if (access.is_write && src_stages != 0) {
+                // waits for earlier writes, and for earlier reads to be done before overwriting what they read
+                barrier.src_stages |= src_stages;
+                barrier.src_access |= src_access;
+                barrier.dst_stages |= access.stages;
+                barrier.dst_access |= access.access;
+            } else if (!access.is_write && state.write_access != 0 &&
+                       ((access.stages & ~state.visible_stages) != 0 || (access.access & ~state.visible_access) != 0)) {
+                // the write has to be made visible to each stage that reads it, but only once
+                barrier.src_stages |= state.write_stages;
+                barrier.src_access |= state.write_access;
+                barrier.dst_stages |= access.stages;
+                barrier.dst_access |= access.access;
+            }
+
+            if (access.is_write) {
+                state.write_stages   = access.stages;
+                state.write_access   = access.access & WRITE_ACCESS;
+                state.read_stages    = 0;
+                state.visible_stages = 0;
+                state.visible_access = 0;
+            } else if (needs_transition) {
+                // the transition is a write that's visible to this read
+                state.write_stages   = access.stages;
+                state.write_access   = 0;
+                state.read_stages    = access.stages;
+                state.visible_stages = access.stages;
+                state.visible_access = access.access;
+            } else {
+                state.read_stages |= access.stages;
+                state.visible_stages |= access.stages;
+                state.visible_access |= access.access;
+            }
+        }
+    }
+
+    // imported images are left in the layout whatever comes after the graph expects
+    for (ResourceId id = 0; id < resources_.size(); ++id) {
+        const Resource& resource = resources_[id];
+        const State&    state    = states[id];
+        if (resource.type == ResourceType::IMAGE && !resource.is_transient && state.is_used &&
+            resource.final_layout != VK_IMAGE_LAYOUT_UNDEFINED && state.layout != resource.final_layout) {
+            // nothing in the graph waits on the transition, what comes after it waits with its semaphores
+            final_barrier_.images.push_back({id,
+                                             state.write_stages | state.read_stages,
+                                             state.write_access,
+                                             VK_PIPELINE_STAGE_2_NONE_KHR,
+                                             VK_ACCESS_2_NONE_KHR,
+                                             state.layout,
+                                             resource.final_layout});
+        }
+    }
+}
+
+void RenderGraph::record_barrier(VkCommandBuffer cmd, const Barrier& barrier) {
+    if (barrier.src_stages == 0 && barrier.images.empty()) {
+        return;
+    }
+
+    VkMemoryBarrier2KHR memory_barrier = {};
+    memory_barrier.sType               = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+    memory_barrier.srcStageMask        = barrier.src_stages;
+    memory_barrier.srcAccessMask       = barrier.src_access;
+    memory_barrier.dstStageMask        = barrier.dst_stages;
+    memory_barrier.dstAccessMask       = barrier.dst_access;
+    bool has_memory_barrier            = barrier.src_stages != 0;
+
+    FrameVector<VkImageMemoryBarrier2KHR> image_barriers{
+        FrameAllocator<VkImageMemoryBarrier2KHR>(gfx_.get_frame_arena())};
+    image_barriers.reserve(barrier.images.size());
+    for (const ImageBarrier& image : barrier.images) {
+        const Resource& resource = resources_[image.resource];
+        rune_assert(core_, resource.image.image != VK_NULL_HANDLE);
+
+        VkImageMemoryBarrier2KHR image_barrier    = {};
+        image_barrier.sType                       = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+        image_barrier.srcStageMask                = image.src_stages;
+        image_barrier.srcAccessMask               = image.src_access;
+        image_barrier.dstStageMask                = image.dst_stages;
+        image_barrier.dstAccessMask               = image.dst_access;
+        image_barrier.oldLayout                   = image.old_layout;
+        image_barrier.newLayout                   = image.new_layout;
+        image_barrier.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image                       = resource.image.image;
+        image_barrier.subresourceRange.aspectMask = resource.aspect;
+        image_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        image_barriers.emplace_back(image_barrier);
+    }
+
+    // a first use has nothing to wait for, each image barrier only waits on the stages that used that image
+    VkDependencyInfoKHR dependency     = {};
+    dependency.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+    dependency.memoryBarrierCount      = has_memory_barrier ? 1 : 0;
+    dependency.pMemoryBarriers         = has_memory_barrier ? &memory_barrier : nullptr;
+    dependency.imageMemoryBarrierCount = image_barriers.size();
+    dependency.pImageMemoryBarriers    = image_barriers.data();
+    gfx_.pipeline_barrier(cmd, dependency);
+}
+
+} // namespace rune::gfx
@@ -0,0 +1,262 @@
+#ifndef RUNE_RENDER_GRAPH_H
+#define RUNE_RENDER_GRAPH_H
+
+#include "gfx/image.h"
+#include "types.h"
+
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+class GraphicsBackend;
+
+/**
+ * The passes of a frame along with the buffers and images they read and write. From what the passes declare the graph
+ * works out the barriers and layout transitions between them, leaves out passes whose results nothing uses, and places
+ * transient images that are never used at the same time in the same memory.
+ * A graph is built once, then compiled, and executed every frame. Passes only record their own work, the graph records
+ * every barrier between them for the resources they declare.
+ * Imported resources come from outside the graph, work outside it that touches them has to synchronize itself. Buffers
+ * are synchronized with global memory barriers, so they only need to be declared and not bound.
+ * Attachments of render passes are transitioned and synchronized with the passes before them by the render pass itself
+ * through its layouts and external dependencies, the graph only transitions them into the layout the render pass
+ * expects if it isn't in it already
+ */
+class RenderGraph {
+  public:
+    using ResourceId = u32;
+    using Execute    = std::function<void(VkCommandBuffer)>;
+
+    /**
+     * A transient image, created by the graph and only valid during the frame
+     */
+    struct ImageDesc {
+        VkExtent2D         extent     = {};
+        VkFormat           format     = VK_FORMAT_UNDEFINED;
+        VkImageUsageFlags  usage      = 0;
+        VkImageAspectFlags aspect     = VK_IMAGE_ASPECT_COLOR_BIT;
+        u32                mip_levels = 1;
+    };
+
+    /**
+     * Declares the resources a pass uses, from add_pass
+     */
+    class PassBuilder {
+      public:
+        /**
+         * @param resource The resource to read
+         * @param stages The stages that read it
+         * @param access How it's read
+         * @param layout The layout images have to be in, ignored for buffers
+         */
+        PassBuilder& read(ResourceId               resource,
+                          VkPipelineStageFlags2KHR stages,
+                          VkAccessFlags2KHR        access,
+                          VkImageLayout            layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+        /**
+         * @param resource The resource to write
+         * @param stages The stages that write it
+         * @param access How it's written, and read if it is
+         * @param layout The layout images have to be in, ignored for buffers
+         */
+        PassBuilder& write(ResourceId               resource,
+                           VkPipelineStageFlags2KHR stages,
+                           VkAccessFlags2KHR        access,
+                           VkImageLayout            layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+        /**
+         * Draw to an image as an attachment of a render pass
+         * @param image The image
+         * @param initial_layout The render pass' initialLayout, undefined if it clears the image
+         * @param final_layout The render pass' finalLayout
+         */
+        PassBuilder& attachment(ResourceId image, VkImageLayout initial_layout, VkImageLayout final_layout);
+
+        /**
+         * Keep the pass even if nothing reads what it writes, like a pass that presents
+         */
+        PassBuilder& set_side_effects();
+
+      private:
+        friend class RenderGraph;
+
+        PassBuilder(RenderGraph& graph, u32 pass) : graph_(graph), pass_(pass) {}
+
+        RenderGraph& graph_;
+        u32          pass_;
+    };
+
+    explicit RenderGraph(Core& core, GraphicsBackend& gfx);
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    /**
+     * @param name The name of the buffer, for logging. Not copied
+     * @return The buffer
+     */
+    ResourceId import_buffer(const char* name);
+
+    /**
+     * Import an image that's bound with set_image, it's expected to be in initial_layout when the graph starts and is
+     * left in final_layout
+     * @param name The name of the image, for logging. Not copied
+     * @param aspect The aspects barriers cover
+     * @return The image
+     */
+    ResourceId
+    import_image(const char* name, VkImageAspectFlags aspect, VkImageLayout initial_layout, VkImageLayout final_layout);
+
+    /**
+     * Create a transient image, its contents are undefined at the start of every frame
+     * @param name The name of the image, for logging. Not copied
+     * @param desc The image
+     * @return The image
+     */
+    ResourceId create_image(const char* name, const ImageDesc& desc);
+
+    /**
+     * Add a pass, passes run in the order they're added
+     * @param name The name of the pass, for logging. Not copied
+     * @param execute Records the pass
+     * @return A builder to declare what the pass uses
+     */
+    PassBuilder add_pass(const char* name, Execute execute);
+
+    /**
+     * Cull passes, work out the barriers between the rest and allocate the transient images. Call once after
+     * everything is added
+     */
+    void compile();
+
+    [[nodiscard]] bool is_compiled() const {
+        return is_compiled_;
+    }
+
+    /**
+     * Bind an imported image for the next execute, like one that changes with the swapchain image
+     */
+    void set_image(ResourceId image, const Image& bound_image);
+
+    /**
+     * Get an image, transient images are only valid after compile
+     */
+    [[nodiscard]] const Image& get_image(ResourceId image) const {
+        return resources_[image].image;
+    }
+
+    /**
+     * Record the passes that weren't culled and the barriers between them
+     * @note Must be recorded outside of a render pass
+     */
+    void execute(VkCommandBuffer cmd);
+
+    /**
+     * Get the size of the memory all the transient images share, valid after compile
+     */
+    [[nodiscard]] VkDeviceSize get_transient_memory_size() const {
+        return transient_memory_size_;
+    }
+
+  private:
+    static constexpr u32 NO_PASS = ~0u;
+
+    enum class ResourceType
+    {
+        BUFFER,
+        IMAGE
+    };
+
+    struct Resource {
+        const char*  name;
+        ResourceType type;
+        bool         is_transient;
+
+        ImageDesc          desc;   // transient images
+        VkImageAspectFlags aspect; // images
+        VkImageLayout      initial_layout;
+        VkImageLayout      final_layout;
+        Image              image;
+
+        // from compile, transient images only
+        u32          first_pass = NO_PASS;
+        u32          last_pass  = NO_PASS;
+        VkDeviceSize offset     = 0;
+        VkDeviceSize size       = 0;
+    };
+
+    struct Access {
+        ResourceId               resource;
+        VkPipelineStageFlags2KHR stages;
+        VkAccessFlags2KHR        access;
+        VkImageLayout            layout;
+        VkImageLayout            final_layout; // attachments only
+        bool                     is_write;
+        bool                     is_attachment;
+    };
+
+    struct ImageBarrier {
+        ResourceId               resource;
+        VkPipelineStageFlags2KHR src_stages;
+        VkAccessFlags2KHR        src_access;
+        VkPipelineStageFlags2KHR dst_stages;
+        VkAccessFlags2KHR        dst_access;
+        VkImageLayout            old_layout;
+        VkImageLayout            new_layout;
+    };
+
+    struct Barrier {
+        VkPipelineStageFlags2KHR  src_stages = 0; // of the global memory barrier
+        VkAccessFlags2KHR         src_access = 0;
+        VkPipelineStageFlags2KHR  dst_stages = 0;
+        VkAccessFlags2KHR         dst_access = 0;
+        std::vector<ImageBarrier> images;
+    };
+
+    struct Pass {
+        const char*         name;
+        Execute             execute;
+        std::vector<Access> accesses;
+        bool                has_side_effects = false;
+        bool                is_live          = false;
+        Barrier             barrier; // recorded before the pass
+    };
+
+    /**
+     * Keep the passes that lead to a side effect or to a write of an imported resource
+     */
+    void cull_passes();
+
+    /**
+     * Place the transient images in one allocation, images that are alive at the same time don't overlap
+     */
+    void allocate_transients();
+
+    /**
+     * Walk the live passes and work out the barrier before each one, and the one after the last
+     */
+    void plan_barriers();
+
+    void record_barrier(VkCommandBuffer cmd, const Barrier& barrier);
+
+    Core&            core_;
+    GraphicsBackend& gfx_;
+
+    std::vector<Resource> resources_;
+    std::vector<Pass>     passes_;
+    Barrier               final_barrier_; // returns imported images to their final layouts
+
+    VkDeviceSize transient_memory_size_ = 0;
+    bool         is_compiled_           = false;
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_RENDER_GRAPH_H
@@ -1,8 +1,13 @@
 #include "render_pass.h"
 
 #include "core.h"
+#include "frame_arena.h"
+#include "gfx/graphics_backend.h"
+#include "heap_tracker.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <map>
 #include <spirv_reflect.h>
 
 namespace rune::gfx {
@@ -17,29 +22,105 @@ void RenderPass::set_push_constants(VkCommandBuffer       cmd,
                                     const void*           data,
                                     u32                   size,
                                     u32                   offset) {
-    if constexpr (!consts::is_release) {
-        // validate that we're updating in a push constant range
-        bool valid = false;
-        for (const PushConstantsInfo& info : push_constants_) {
-            if (info.stage != shader_stage) {
-                continue;
+    // a range shared by several stages has to be updated for all of them at once
+    const PushConstantsInfo* range = nullptr;
+    for (const PushConstantsInfo& info : push_constants_) {
+        if ((info.stages & shader_stage) != 0 && offset + size <= info.size + info.offset) {
+            range = &info;
+            break;
+        }
+    }
+
+    if (!range) {
+        core_.get_logger().warn("Invalid push constant with size: %, offset: %, shader stage: %",
+                                size,
+                                offset,
+                                shader_stage);
+        return;
+    }
+    vkCmdPushConstants(cmd, pipeline_layout_, range->stages, offset, size, data);
+}
+
+void RenderPass::write_descriptors(VkCommandBuffer         cmd,
+                                   const DescriptorWrites& variable_writes,
+                                   VkPipelineBindPoint     bind_point) {
+    if (variable_writes.is_overflowed()) {
+        core_.get_logger().fatal("tried to write more than % descriptors at once", DescriptorWrites::MAX_WRITES);
+    }
+
+    // name -> descriptor info
+    const DescriptorInfoMap& descriptors = get_descriptors();
+
+    // set index -> descriptor set, null if nothing was written to the set
+    VkDescriptorSet descriptor_sets[MAX_DESCRIPTOR_SETS] = {};
+
+    FrameVector<VkWriteDescriptorSet> writes{FrameAllocator<VkWriteDescriptorSet>(gfx_.get_frame_arena())};
+    {
+        heap_tracker::Scope heap_scope;
+
+        writes.reserve(variable_writes.get_write_data().size());
+        for (const auto& [variable_name, write_data] : variable_writes.get_write_data()) {
+            auto it = descriptors.find(variable_name);
+            if (it == descriptors.end()) {
+                core_.get_logger().fatal("tried to set descriptor that doesn't exist: '%'", variable_name);
+            }
+
+            if (it->second.type != write_data.descriptor_type) {
+                core_.get_logger().fatal("tried to write incorrect descriptor type: expected '%', got '%'",
+                                         it->second.type,
+                                         write_data.descriptor_type);
+            }
+
+            u32 set_idx = it->second.set;
+            rune_assert(core_, set_idx < MAX_DESCRIPTOR_SETS);
+
+            // see if we've written something to this set yet in this batch
+            VkDescriptorSet set = descriptor_sets[set_idx];
+            if (set == VK_NULL_HANDLE) {
+                // if this is the first time we're seeing this set, get or allocate a new descriptor set
+                set                      = gfx_.get_descriptor_set(get_descriptor_set_layout(set_idx));
+                descriptor_sets[set_idx] = set;
             }
 
-            if (offset + size <= info.size + info.offset) {
-                valid = true;
+            VkWriteDescriptorSet write = {};
+            write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet               = set;
+            write.dstBinding           = it->second.binding;
+            write.descriptorType       = it->second.type;
+            write.descriptorCount      = 1;
+
+            switch (write_data.write_type) {
+            case DescriptorWrites::Write::WriteDataType::BUFFER:
+                write.pBufferInfo = &write_data.data.buffer_info;
+                break;
+            case DescriptorWrites::Write::WriteDataType::IMAGE:
+                write.pImageInfo = &write_data.data.image_info;
+                break;
+            case DescriptorWrites::Write::WriteDataType::INVALID:
+                core_.get_logger().fatal("invalid write type");
                 break;
             }
+
+            writes.emplace_back(write);
         }
+    }
+
+    gfx_.update_descriptor_sets(writes.data(), writes.size());
 
-        if (!valid) {
-            core_.get_logger().warn("Invalid push constant with size: %, offset: %, shader stage: %",
-                                    size,
-                                    offset,
-                                    shader_stage);
-            return;
+    for (u32 set_idx = 0; set_idx < MAX_DESCRIPTOR_SETS; ++set_idx) {
+        if (descriptor_sets[set_idx] == VK_NULL_HANDLE) {
+            continue;
         }
+
+        vkCmdBindDescriptorSets(cmd,
+                                bind_point,
+                                pipeline_layout_,
+                                set_idx,
+                                1,
+                                &descriptor_sets[set_idx],
+                                0,
+                                nullptr);
     }
-    vkCmdPushConstants(cmd, pipeline_layout_, shader_stage, offset, size, data);
 }
 
 void RenderPass::process_shaders(const std::vector<ShaderInfo>& shaders) {
@@ -59,22 +140,11 @@ void RenderPass::process_shaders(const std::vector<ShaderInfo>& shaders) {
                         SPV_REFLECT_RESULT_SUCCESS);
     }
 
-    u32 total_sets      = 0;
-    u32 total_constants = 0;
-    for (SpvReflectShaderModule& module : modules) {
-        u32 num_sets;
-        spvReflectEnumerateDescriptorSets(&module, &num_sets, nullptr);
-        total_sets += num_sets;
-
-        u32 num_constants;
-        spvReflectEnumeratePushConstantBlocks(&module, &num_constants, nullptr);
-        total_constants += num_constants;
-    }
-    std::vector<VkDescriptorSetLayout> layouts(total_sets);
-    std::vector<VkPushConstantRange>   constant_ranges(total_constants);
+    // stages that use the same set share its layout and stages with the same push constant block share its range,
+    // so bindings and ranges used by several stages are merged with all of their stage flags
+    std::map<u32, std::vector<VkDescriptorSetLayoutBinding>> set_bindings;
+    std::vector<VkPushConstantRange>                          constant_ranges;
 
-    u32 set_start_idx       = 0;
-    u32 constants_start_idx = 0;
     for (u32 s = 0; s < shaders.size(); ++s) {
         logger.verbose("info for shader: '%'", shaders[s].path);
 
@@ -90,34 +160,38 @@ void RenderPass::process_shaders(const std::vector<ShaderInfo>& shaders) {
 
             logger.verbose(" - set %:", set->set);
 
-            std::vector<VkDescriptorSetLayoutBinding> bindings(set->binding_count);
+            std::vector<VkDescriptorSetLayoutBinding>& bindings = set_bindings[set->set];
             for (u32 j = 0; j < set->binding_count; ++j) {
                 SpvReflectDescriptorBinding* binding = set->bindings[j];
                 logger.verbose("  - binding %: '%'", binding->binding, binding->name);
 
-                bindings[j].binding            = binding->binding;
-                bindings[j].descriptorType     = static_cast<VkDescriptorType>(binding->descriptor_type);
-                bindings[j].descriptorCount    = binding->count;
-                bindings[j].stageFlags         = shaders[s].stage;
-                bindings[j].pImmutableSamplers = nullptr;
+                VkDescriptorType type = static_cast<VkDescriptorType>(binding->descriptor_type);
+
+                auto it = std::find_if(bindings.begin(), bindings.end(), [&](const VkDescriptorSetLayoutBinding& b) {
+                    return b.binding == binding->binding;
+                });
+                if (it == bindings.end()) {
+                    VkDescriptorSetLayoutBinding& new_binding = bindings.emplace_back();
+                    new_binding.binding                       = binding->binding;
+                    new_binding.descriptorType                = type;
+                    new_binding.descriptorCount               = binding->count;
+                    new_binding.stageFlags                    = shaders[s].stage;
+                    new_binding.pImmutableSamplers            = nullptr;
+                } else if (it->descriptorType != type) {
+                    logger.fatal("set % binding % has different descriptor types in different stages",
+                                 set->set,
+                                 binding->binding);
+                } else {
+                    it->stageFlags |= shaders[s].stage;
+                }
 
                 DescriptorInfo descriptor_info = {};
                 descriptor_info.set            = binding->set;
                 descriptor_info.binding        = binding->binding;
-                descriptor_info.type           = static_cast<VkDescriptorType>(binding->descriptor_type);
+                descriptor_info.type           = type;
                 descriptors_[binding->name]    = descriptor_info;
             }
-
-            VkDescriptorSetLayoutCreateInfo set_info = {};
-            set_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            set_info.bindingCount                    = set->binding_count;
-            set_info.pBindings                       = bindings.data();
-
-            VkDescriptorSetLayout layout      = gfx_.create_descriptor_set_layout(set_info);
-            layouts[set_start_idx + i]        = layout;
-            descriptor_set_layouts_[set->set] = layout;
         }
-        set_start_idx += num_sets;
 
         // push constants
         u32 num_constants;
@@ -132,17 +206,42 @@ void RenderPass::process_shaders(const std::vector<ShaderInfo>& shaders) {
                            push_variable->name,
                            push_variable->offset,
                            push_variable->size);
-            constant_ranges[constants_start_idx + i].offset     = push_variable->offset;
-            constant_ranges[constants_start_idx + i].size       = push_variable->size;
-            constant_ranges[constants_start_idx + i].stageFlags = shaders[s].stage;
-
-            PushConstantsInfo push_constant_info = {};
-            push_constant_info.offset            = push_variable->offset;
-            push_constant_info.size              = push_variable->size;
-            push_constant_info.stage             = shaders[s].stage;
-            push_constants_.emplace_back(push_constant_info);
+
+            auto it = std::find_if(constant_ranges.begin(), constant_ranges.end(), [&](const VkPushConstantRange& r) {
+                return r.offset == push_variable->offset && r.size == push_variable->size;
+            });
+            if (it == constant_ranges.end()) {
+                VkPushConstantRange& range = constant_ranges.emplace_back();
+                range.offset               = push_variable->offset;
+                range.size                 = push_variable->size;
+                range.stageFlags           = shaders[s].stage;
+            } else {
+                it->stageFlags |= shaders[s].stage;
+            }
         }
-        constants_start_idx += num_constants;
+    }
+
+    for (const VkPushConstantRange& range : constant_ranges) {
+        PushConstantsInfo push_constant_info = {};
+        push_constant_info.offset            = range.offset;
+        push_constant_info.size              = range.size;
+        push_constant_info.stages            = range.stageFlags;
+        push_constants_.emplace_back(push_constant_info);
+    }
+
+    // the pipeline layout's sets are indexed by set number, sets no stage uses get an empty layout
+    u32 num_set_layouts = set_bindings.empty() ? 0 : set_bindings.rbegin()->first + 1;
+    std::vector<VkDescriptorSetLayout> layouts(num_set_layouts);
+    for (u32 set = 0; set < num_set_layouts; ++set) {
+        std::vector<VkDescriptorSetLayoutBinding>& bindings = set_bindings[set];
+
+        VkDescriptorSetLayoutCreateInfo set_info = {};
+        set_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        set_info.bindingCount                    = bindings.size();
+        set_info.pBindings                       = bindings.data();
+
+        layouts[set]                 = gfx_.create_descriptor_set_layout(set_info);
+        descriptor_set_layouts_[set] = layouts[set];
     }
 
     // create VkPipelineLayout
@@ -3,10 +3,16 @@
 
 #include "buffer.h"
 #include "consts.h"
+#include "function_ref.h"
 #include "types.h"
+#include "utils.h"
 
-#include <functional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 #include <vulkan/vulkan.h>
 
 namespace rune {
@@ -25,10 +31,63 @@ struct ShaderInfo {
     const char*           path;
 };
 
+/**
+ * Depth test state of a graphics pipeline
+ */
+struct DepthState {
+    bool        test       = true;
+    bool        write      = true;
+    VkCompareOp compare_op = VK_COMPARE_OP_LESS;
+
+    // pushes the depth written away from the view, by a constant and by how steep the triangle is. Lets shadow maps be
+    // tested against the surfaces they were drawn from without them shadowing themselves
+    f32 constant_bias = 0.0f;
+    f32 slope_bias    = 0.0f;
+};
+
+/**
+ * The color attachment a graphics pass draws to, alongside the depth image of the swapchain image
+ */
+enum class ColorAttachment
+{
+    SWAPCHAIN,
+    VISIBILITY_ID, // a R32_UINT triangle id per pixel, see GraphicsBackend::get_visibility_id_image
+    GBUFFER,       // the surface of each pixel, one attachment per GBufferAttachment
+    NONE           // depth only, like shadow maps
+};
+
+/**
+ * The images of the g-buffer, in the order they're attached. See GraphicsBackend::get_gbuffer_image
+ */
+enum class GBufferAttachment
+{
+    DIFFUSE,                      // rgb albedo
+    NORMAL,                       // world space normal, scaled and biased to [0, 1]
+    OCCLUSION_ROUGHNESS_METALLIC, // in r, g and b
+    COUNT
+};
+
+// the most color attachments a graphics pass can draw to, the g-buffer's
+constexpr u32 MAX_COLOR_ATTACHMENTS = (u32)GBufferAttachment::COUNT;
+
+constexpr u32 get_num_color_attachments(ColorAttachment color_attachment) {
+    switch (color_attachment) {
+    case ColorAttachment::GBUFFER:
+        return MAX_COLOR_ATTACHMENTS;
+    case ColorAttachment::NONE:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
 /**
  * Holds data relating to writing to descriptors
+ * @note Variable names aren't copied, they need to outlive the DescriptorWrites. String literals are fine
  */
 struct DescriptorWrites {
+    static constexpr u32 MAX_WRITES = 16;
+
     struct Write {
         enum class WriteDataType
         {
@@ -45,27 +104,87 @@ struct DescriptorWrites {
         } data;
     };
 
-    const std::unordered_map<std::string, Write>& get_write_data() const {
-        return write_data_;
+    struct NamedWrite {
+        std::string_view name;
+        Write            write;
+    };
+
+    [[nodiscard]] std::span<const NamedWrite> get_write_data() const {
+        return {write_data_, num_writes_};
     }
 
-    void set_buffer(const std::string& name, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
-        Write& write          = write_data_[name];
-        write.descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        write.write_type      = Write::WriteDataType::BUFFER;
+    /**
+     * Whether more than MAX_WRITES variables were written, the extra writes are dropped
+     */
+    [[nodiscard]] bool is_overflowed() const {
+        return overflowed_;
+    }
+
+    void set_buffer(std::string_view name, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+        Write* write = get_write(name);
+        if (!write) {
+            return;
+        }
+
+        write->descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write->write_type      = Write::WriteDataType::BUFFER;
 
-        write.data.buffer_info.buffer = buffer;
-        write.data.buffer_info.offset = offset;
-        write.data.buffer_info.range  = range;
+        write->data.buffer_info.buffer = buffer;
+        write->data.buffer_info.offset = offset;
+        write->data.buffer_info.range  = range;
     }
 
-    void set_buffer(const std::string& name, const Buffer& buffer, VkDeviceSize offset = 0) {
+    void set_buffer(std::string_view name, const Buffer& buffer, VkDeviceSize offset = 0) {
         set_buffer(name, buffer.buffer, offset, buffer.range);
     }
 
+    void set_combined_image_sampler(std::string_view name, VkImageView view, VkSampler sampler, VkImageLayout layout) {
+        set_image(name, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler, layout);
+    }
+
+    void set_storage_image(std::string_view name, VkImageView view, VkImageLayout layout) {
+        set_image(name, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, view, VK_NULL_HANDLE, layout);
+    }
+
   private:
-    // variable name -> write info
-    std::unordered_map<std::string, Write> write_data_;
+    void set_image(std::string_view name,
+                   VkDescriptorType descriptor_type,
+                   VkImageView      view,
+                   VkSampler        sampler,
+                   VkImageLayout    layout) {
+        Write* write = get_write(name);
+        if (!write) {
+            return;
+        }
+
+        write->descriptor_type = descriptor_type;
+        write->write_type      = Write::WriteDataType::IMAGE;
+
+        write->data.image_info.imageView   = view;
+        write->data.image_info.sampler     = sampler;
+        write->data.image_info.imageLayout = layout;
+    }
+
+    Write* get_write(std::string_view name) {
+        for (u32 i = 0; i < num_writes_; ++i) {
+            if (write_data_[i].name == name) {
+                return &write_data_[i].write;
+            }
+        }
+
+        if (num_writes_ == MAX_WRITES) {
+            overflowed_ = true;
+            return nullptr;
+        }
+
+        write_data_[num_writes_].name = name;
+        return &write_data_[num_writes_++].write;
+    }
+
+    // fixed size so that filling out writes every frame doesn't allocate
+    NamedWrite write_data_[MAX_WRITES] = {};
+    u32        num_writes_             = 0;
+    bool       overflowed_             = false;
 };
 
 /**
@@ -84,7 +203,7 @@ class RenderPass {
      * @param cmd The command buffer to be used
      * @param func The function to run
      */
-    virtual void run(VkCommandBuffer cmd, const std::function<void(VkCommandBuffer)>& func) = 0;
+    virtual void run(VkCommandBuffer cmd, FunctionRef<void(VkCommandBuffer)> func) = 0;
 
     /**
      * Set push constants for this render pass. Should be called within the function that's passed to run
@@ -118,7 +237,18 @@ class RenderPass {
      */
     virtual void set_descriptors(VkCommandBuffer cmd, const gfx::DescriptorWrites& writes) = 0;
 
+    /**
+     * Whether the pass' shaders use a descriptor, for recording code that's shared by passes with different shaders
+     * @param name The name of the descriptor's variable
+     */
+    [[nodiscard]] bool has_descriptor(std::string_view name) const {
+        return descriptors_.find(name) != descriptors_.end();
+    }
+
   protected:
+    // the minimum maxBoundDescriptorSets that's guaranteed
+    static constexpr u32 MAX_DESCRIPTOR_SETS = 4;
+
     Core&            core_;
     GraphicsBackend& gfx_;
     VkPipelineLayout pipeline_layout_;
@@ -132,23 +262,34 @@ class RenderPass {
         VkDescriptorType type;
     };
 
+    // variable name -> descriptor info, can be searched with a std::string_view
+    using DescriptorInfoMap = std::unordered_map<std::string, DescriptorInfo, utils::StringHash, std::equal_to<>>;
+
     /**
      * Holds info related to a push constant
      */
     struct PushConstantsInfo {
-        u32                   offset;
-        u32                   size;
-        VkShaderStageFlagBits stage;
+        u32                offset;
+        u32                size;
+        VkShaderStageFlags stages; // every stage that declares this range
 
         bool operator==(const PushConstantsInfo& rhs) const {
-            return std::tie(offset, size, stage) == std::tie(rhs.offset, rhs.size, rhs.stage);
+            return std::tie(offset, size, stages) == std::tie(rhs.offset, rhs.size, rhs.stages);
         }
         bool operator!=(const PushConstantsInfo& rhs) const {
             return !(rhs == *this);
         }
     };
 
-    const std::unordered_map<std::string, DescriptorInfo>& get_descriptors() const {
+    /**
+     * Write descriptors and bind their sets, shared implementation of set_descriptors
+     * @param cmd The command buffer to write to
+     * @param writes The descriptor writes to perform
+     * @param bind_point The pipeline bind point to bind the sets to
+     */
+    void write_descriptors(VkCommandBuffer cmd, const DescriptorWrites& writes, VkPipelineBindPoint bind_point);
+
+    const DescriptorInfoMap& get_descriptors() const {
         return descriptors_;
     }
 
@@ -172,9 +313,9 @@ class RenderPass {
      */
     void process_shaders(const std::vector<ShaderInfo>& shaders);
 
-    std::unordered_map<std::string, DescriptorInfo> descriptors_;
-    std::vector<PushConstantsInfo>                  push_constants_;
-    std::unordered_map<u32, VkDescriptorSetLayout>  descriptor_set_layouts_;
+    DescriptorInfoMap                              descriptors_;
+    std::vector<PushConstantsInfo>                 push_constants_;
+    std::unordered_map<u32, VkDescriptorSetLayout> descriptor_set_layouts_;
 };
 
 } // namespace rune::gfx
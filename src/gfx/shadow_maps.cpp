@@ -0,0 +1,217 @@
+#include "shadow_maps.h"
+
+#include "constants.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace rune::gfx {
+
+// what add_views returns when the frame is out of room for views
+static constexpr u32 NO_VIEW = ~0u;
+
+/**
+ * Record copying every layer of a depth image to another of the same size
+ */
+static void copy_layers(VkCommandBuffer cmd, const Image& src, const Image& dst) {
+    VkImageCopy region               = {};
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    region.srcSubresource.layerCount = src.num_layers;
+    region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    region.dstSubresource.layerCount = dst.num_layers;
+    region.extent                    = {src.extent.width, src.extent.height, 1};
+
+    vkCmdCopyImage(cmd,
+                   src.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   dst.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1,
+                   &region);
+}
+
+static GraphicsPassDesc get_pass_desc(u32 resolution, VkAttachmentLoadOp load_op) {
+    GraphicsPassDesc desc    = {};
+    desc.render_area         = {0, 0, resolution, resolution};
+    desc.load_op             = load_op;
+    desc.is_present_pass     = false;
+    desc.color_attachment    = ColorAttachment::NONE;
+    desc.num_views           = MAX_SHADOW_CASCADES;
+    desc.depth.constant_bias = 1.25f;
+    desc.depth.slope_bias    = 1.75f;
+    desc.vert_shader_path    = "../data/shaders/shadow.vert.spv";
+    return desc;
+}
+
+ShadowMaps::ShadowMaps(Core& core, GraphicsBackend& gfx)
+    : gfx_(gfx), static_pass_(core, gfx, get_pass_desc(RESOLUTION, VK_ATTACHMENT_LOAD_OP_CLEAR)),
+      dynamic_pass_(core, gfx, get_pass_desc(RESOLUTION, VK_ATTACHMENT_LOAD_OP_LOAD)) {
+    // filtered comparisons soften the edges of the shadows, outside the cascades nothing is in shadow
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType               = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter           = VK_FILTER_LINEAR;
+    sampler_info.minFilter           = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_info.addressModeV        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_info.addressModeW        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.borderColor         = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    sampler_info.compareEnable       = VK_TRUE;
+    sampler_info.compareOp           = VK_COMPARE_OP_LESS_OR_EQUAL;
+    sampler_                         = gfx_.create_sampler(sampler_info);
+
+    cache_ = gfx_.create_image_gpu({RESOLUTION, RESOLUTION},
+                                   gfx_.get_depth_image().format,
+                                   VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                       VK_IMAGE_USAGE_SAMPLED_BIT,
+                                   1,
+                                   VK_IMAGE_ASPECT_DEPTH_BIT,
+                                   MAX_SHADOW_CASCADES);
+}
+
+void ShadowMaps::update(const Camera& camera, const DirectionalLight& light, u64 static_version) {
+    // only the light's direction matters, a light looking straight up or down needs another up vector
+    glm::vec3 direction = glm::normalize(light.direction);
+    glm::vec3 up        = glm::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : consts::UP;
+    glm::mat4 view      = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+    // the camera in light space, looking along -z
+    glm::vec3 camera_position = view * glm::vec4(camera.get_position(), 1.0f);
+
+    DirectionalLightData light_data = {};
+    light_data.light                = light;
+    light_data.num_cascades         = MAX_SHADOW_CASCADES;
+
+    f32 radius = FIRST_CASCADE_RADIUS;
+    for (u32 i = 0; i < MAX_SHADOW_CASCADES; ++i, radius *= CASCADE_SCALE) {
+        // the center is snapped to steps so the cascade doesn't change until the camera leaves its step
+        f32       step   = radius * CASCADE_STEP;
+        glm::vec3 center = (glm::floor(camera_position / step) + 0.5f) * step;
+        f32       extent = radius + step;
+
+        glm::mat4 projection = glm::orthoRH_ZO(center.x - extent,
+                                               center.x + extent,
+                                               center.y - extent,
+                                               center.y + extent,
+                                               -center.z - extent - CASTER_DISTANCE,
+                                               -center.z + extent);
+
+        light_data.cascades[i] = projection * view;
+        if (light_data.cascades[i] != light_data_.cascades[i]) {
+            is_cache_valid_ = false;
+        }
+    }
+
+    if (static_version != static_version_) {
+        is_cache_valid_ = false;
+    }
+
+    light_data_     = light_data;
+    static_version_ = static_version;
+}
+
+void ShadowMaps::draw(VkCommandBuffer cmd, const BatchGroup& static_casters, const BatchGroup& dynamic_casters) {
+    // the passes draw every cascade at once, picking their matrices by view index
+    u32 first_view = gfx_.add_views(light_data_.cascades);
+
+    // out of room for the views nothing is drawn, the cache is tried again next frame
+    if (!is_cache_valid_) {
+        draw_cache(cmd, static_casters, first_view);
+        is_cache_valid_ = first_view != NO_VIEW;
+    }
+
+    // the old contents aren't needed, wait for the earlier frame that used this shadow map to stop reading it
+    const Image& shadow_map = get_shadow_map();
+    gfx_.image_barrier(cmd,
+                       shadow_map,
+                       VK_IMAGE_ASPECT_DEPTH_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_IMAGE_LAYOUT_UNDEFINED,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    copy_layers(cmd, cache_, shadow_map);
+
+    // the dynamic pass loads the copy from the layout a loading pass expects
+    gfx_.image_barrier(cmd,
+                       shadow_map,
+                       VK_IMAGE_ASPECT_DEPTH_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    draw_casters(dynamic_pass_, cmd, dynamic_casters, first_view);
+}
+
+void ShadowMaps::draw_cache(VkCommandBuffer cmd, const BatchGroup& static_casters, u32 first_view) {
+    draw_casters(static_pass_, cmd, static_casters, first_view);
+
+    // the cache's old contents aren't needed, but earlier frames may still be copying them out
+    const Image& static_map = static_pass_.get_layered_image(0);
+    gfx_.image_barrier(cmd,
+                       static_map,
+                       VK_IMAGE_ASPECT_DEPTH_BIT,
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_READ_BIT,
+                       VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    gfx_.image_barrier(cmd,
+                       cache_,
+                       VK_IMAGE_ASPECT_DEPTH_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_IMAGE_LAYOUT_UNDEFINED,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    copy_layers(cmd, static_map, cache_);
+
+    gfx_.image_barrier(cmd,
+                       cache_,
+                       VK_IMAGE_ASPECT_DEPTH_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_READ_BIT,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    // back to the layout the static pass leaves it in, its next clear has to wait for the copy to read it
+    gfx_.image_barrier(cmd,
+                       static_map,
+                       VK_IMAGE_ASPECT_DEPTH_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+}
+
+void ShadowMaps::draw_casters(GraphicsPass& pass, VkCommandBuffer cmd, const BatchGroup& group, u32 first_view) {
+    pass.run(cmd, [&](VkCommandBuffer cmd) {
+        if (group.num_batches == 0 || first_view == NO_VIEW) {
+            return;
+        }
+
+        DescriptorWrites writes;
+        writes.set_buffer("u_vertices", gfx_.get_unified_vertex_buffer());
+        writes.set_buffer("u_object_data", gfx_.get_object_data_buffer());
+        writes.set_buffer("u_views", gfx_.get_view_buffer());
+        pass.set_descriptors(cmd, writes);
+
+        struct DrawData {
+            u32 first_view;
+        } draw_data          = {};
+        draw_data.first_view = first_view;
+        pass.set_push_constants(cmd, VK_SHADER_STAGE_VERTEX_BIT, draw_data);
+
+        gfx_.draw_batch_group(cmd, group);
+    });
+}
+
+} // namespace rune::gfx
@@ -0,0 +1,110 @@
+#ifndef RUNE_SHADOW_MAPS_H
+#define RUNE_SHADOW_MAPS_H
+
+#include "gfx/camera.h"
+#include "gfx/graphics_backend.h"
+#include "gfx/graphics_pass.h"
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+// every cascade is a view of one multiview pass
+static_assert(MAX_SHADOW_CASCADES <= MAX_VIEWS);
+
+/**
+ * Cascaded shadow maps of the directional light, see DirectionalLightData. Each cascade is a square around the camera
+ * that's a few times bigger than the one before, all of them are drawn at once by a depth only multiview pass.
+ * Static casters are drawn into a cache that's only redrawn when a static caster or the cascades move. Every frame the
+ * cache is copied into the frame's shadow map and only the dynamic casters are drawn on top of it, so the level
+ * geometry that makes up most of what casts shadows costs a copy instead of its draws.
+ * The cascades stay put while the camera moves within a fraction of their size, so the cache survives small camera
+ * movements and the shadows don't crawl along with the camera
+ * @note Needs multiview, see GraphicsBackend::supports_multiview
+ */
+class ShadowMaps {
+  public:
+    explicit ShadowMaps(Core& core, GraphicsBackend& gfx);
+
+    /**
+     * Place the cascades for this frame, the cache is redrawn by the next draw if they or the static casters moved
+     * @param camera The camera the shadows are seen from
+     * @param light The light that casts the shadows
+     * @param static_version Changes whenever a static caster changes, see InstanceTable::get_static_version
+     */
+    void update(const Camera& camera, const DirectionalLight& light, u64 static_version);
+
+    /**
+     * Get the light along with the cascades from the last update, for GraphicsBackend::update_directional_light
+     */
+    [[nodiscard]] const DirectionalLightData& get_light_data() const {
+        return light_data_;
+    }
+
+    /**
+     * Record drawing this frame's shadow map, it's left in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+     * @note Must be recorded outside of a graphics pass. The static casters are only drawn when the cache is redrawn,
+     * with this frame's object data
+     * @param cmd The command buffer to record to
+     * @param static_casters The batch group of the static casters, it has to be drawn without a gpu count
+     * @param dynamic_casters The batch group of every other caster, it has to be drawn without a gpu count
+     */
+    void draw(VkCommandBuffer cmd, const BatchGroup& static_casters, const BatchGroup& dynamic_casters);
+
+    /**
+     * Get this frame's shadow map, a layer per cascade
+     */
+    [[nodiscard]] const Image& get_shadow_map() const {
+        return dynamic_pass_.get_layered_image(0);
+    }
+
+    /**
+     * Get the sampler to test the shadow map with, it compares with the depth it's given
+     */
+    [[nodiscard]] VkSampler get_sampler() const {
+        return sampler_;
+    }
+
+  private:
+    // texels on a side of each cascade
+    static constexpr u32 RESOLUTION = 1024;
+
+    // the first cascade covers this far from the camera, in world units, each after it CASCADE_SCALE times as far
+    static constexpr f32 FIRST_CASCADE_RADIUS = 2.0f;
+    static constexpr f32 CASCADE_SCALE        = 4.0f;
+
+    // a cascade moves in steps of this much of its radius, it covers that much more so the camera stays inside
+    static constexpr f32 CASCADE_STEP = 0.25f;
+
+    // how far towards the light casters are kept, past the cascade's own depth
+    static constexpr f32 CASTER_DISTANCE = 50.0f;
+
+    /**
+     * Record drawing a batch group to one of the passes with every cascade
+     */
+    void draw_casters(GraphicsPass& pass, VkCommandBuffer cmd, const BatchGroup& group, u32 first_view);
+
+    /**
+     * Record drawing the static casters and copying them to the cache
+     */
+    void draw_cache(VkCommandBuffer cmd, const BatchGroup& static_casters, u32 first_view);
+
+    GraphicsBackend& gfx_;
+
+    GraphicsPass static_pass_;  // clears, drawn to the cache
+    GraphicsPass dynamic_pass_; // draws on top of a copy of the cache
+    VkSampler    sampler_;
+
+    // the static casters as they were last drawn, a layer per cascade. Kept in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+    Image cache_;
+    bool  is_cache_valid_ = false;
+    u64   static_version_ = 0;
+
+    DirectionalLightData light_data_ = {};
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_SHADOW_MAPS_H
@@ -0,0 +1,91 @@
+#include "tiled_lighting.h"
+
+namespace rune::gfx {
+
+static GraphicsPassDesc get_shade_pass_desc(VkRect2D render_area) {
+    GraphicsPassDesc desc = {};
+    desc.render_area      = render_area;
+    desc.load_op          = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    desc.is_present_pass  = true;
+    desc.depth.test       = false;
+    desc.depth.write      = false;
+    desc.vert_shader_path = "../data/shaders/fullscreen.vert.spv";
+    desc.frag_shader_path = "../data/shaders/deferred_lighting.frag.spv";
+    return desc;
+}
+
+TiledLighting::TiledLighting(Core& core, GraphicsBackend& gfx, VkRect2D render_area)
+    : gfx_(gfx), render_area_(render_area), cull_pass_(core, gfx, {"../data/shaders/light_culling.comp.spv"}),
+      shade_pass_(core, gfx, get_shade_pass_desc(render_area)) {
+    // the shaders only use texelFetch, but a combined image sampler needs a sampler
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType               = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter           = VK_FILTER_NEAREST;
+    sampler_info.minFilter           = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_                         = gfx_.create_sampler(sampler_info);
+}
+
+void TiledLighting::cull_lights(VkCommandBuffer cmd, const Camera& camera, const Image& depth) {
+    cull_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_combined_image_sampler("u_depth",
+                                          depth.view,
+                                          sampler_,
+                                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        writes.set_buffer("u_lights", gfx_.get_light_data_buffer());
+        writes.set_buffer("u_light_tiles", gfx_.get_light_tile_buffer());
+        cull_pass_.set_descriptors(cmd, writes);
+
+        glm::mat4 projection = camera.get_projection_matrix();
+
+        CullData cull_data   = {};
+        cull_data.view       = camera.get_view_matrix();
+        cull_data.projection = {1.0f / projection[0][0], 1.0f / projection[1][1], projection[2][2], projection[3][2]};
+        cull_data.viewport   = get_viewport();
+        cull_data.info       = {gfx_.get_num_lights(), gfx_.get_num_light_tiles().width, 0, 0};
+        cull_pass_.set_push_constants(cmd, VK_SHADER_STAGE_COMPUTE_BIT, cull_data);
+
+        // every tile of the depth buffer gets a list, even outside the render area, so the tiles line up with pixels
+        ComputePass::dispatch(cmd, depth.extent, CULL_WORKGROUP_SIZE);
+    });
+}
+
+void TiledLighting::shade(VkCommandBuffer cmd, const Camera& camera, const Image& depth) {
+    shade_pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_combined_image_sampler("u_diffuse",
+                                          gfx_.get_gbuffer_image(GBufferAttachment::DIFFUSE).view,
+                                          sampler_,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        writes.set_combined_image_sampler("u_normal",
+                                          gfx_.get_gbuffer_image(GBufferAttachment::NORMAL).view,
+                                          sampler_,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        writes.set_combined_image_sampler("u_occlusion_roughness_metallic",
+                                          gfx_.get_gbuffer_image(GBufferAttachment::OCCLUSION_ROUGHNESS_METALLIC).view,
+                                          sampler_,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        writes.set_combined_image_sampler("u_depth",
+                                          depth.view,
+                                          sampler_,
+                                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        writes.set_buffer("u_lights", gfx_.get_light_data_buffer());
+        writes.set_buffer("u_light_tiles", gfx_.get_light_tile_buffer());
+        shade_pass_.set_descriptors(cmd, writes);
+
+        ShadeData shade_data  = {};
+        shade_data.inverse_vp = glm::inverse(camera.get_view_projection_matrix());
+        shade_data.viewport   = get_viewport();
+        shade_data.info       = {gfx_.get_num_light_tiles().width, 0, 0, 0};
+        shade_pass_.set_push_constants(cmd, VK_SHADER_STAGE_FRAGMENT_BIT, shade_data);
+
+        // a single triangle covering the render area, see fullscreen.vert
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+    });
+}
+
+} // namespace rune::gfx
@@ -0,0 +1,81 @@
+#ifndef RUNE_TILED_LIGHTING_H
+#define RUNE_TILED_LIGHTING_H
+
+#include "gfx/camera.h"
+#include "gfx/compute_pass.h"
+#include "gfx/graphics_backend.h"
+#include "gfx/graphics_pass.h"
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+/**
+ * Lights the g-buffer with the frame's point lights, see GraphicsBackend::update_light_data. The lights are first
+ * binned into screen tiles against the depth range drawn in each tile, then every pixel is lit by the lights of its
+ * tile only. The cost stays with the lights that actually reach the geometry however many lights the scene has
+ */
+class TiledLighting {
+  public:
+    /**
+     * @param render_area The area to light, the one the g-buffer was drawn to
+     */
+    explicit TiledLighting(Core& core, GraphicsBackend& gfx, VkRect2D render_area);
+
+    /**
+     * Record binning this frame's lights into GraphicsBackend::get_light_tile_buffer()
+     * @note Must be recorded outside of a graphics pass
+     * @param cmd The command buffer to record to
+     * @param camera The camera the depth buffer was drawn with
+     * @param depth The depth buffer, in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+     */
+    void cull_lights(VkCommandBuffer cmd, const Camera& camera, const Image& depth);
+
+    /**
+     * Record lighting the current swapchain image from the g-buffer, it's presented after
+     * @note The light tiles and the g-buffer must be written and visible to fragment shaders
+     * @param cmd The command buffer to record to
+     * @param camera The camera the g-buffer was drawn with
+     * @param depth The depth buffer, in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+     */
+    void shade(VkCommandBuffer cmd, const Camera& camera, const Image& depth);
+
+  private:
+    // matches the push constants of light_culling.comp
+    struct CullData {
+        glm::mat4  view;
+        glm::vec4  projection; // 1 / p[0][0], 1 / p[1][1], p[2][2] and p[3][2]
+        glm::vec4  viewport;   // offset in xy and extent in zw
+        glm::uvec4 info;       // the number of lights and the number of tiles along x
+    };
+
+    // matches the push constants of deferred_lighting.frag
+    struct ShadeData {
+        glm::mat4  inverse_vp;
+        glm::vec4  viewport; // offset in xy and extent in zw
+        glm::uvec4 info;     // the number of tiles along x
+    };
+
+    // local_size_x and local_size_y of light_culling.comp, a workgroup per tile
+    static constexpr VkExtent2D CULL_WORKGROUP_SIZE = {LIGHT_TILE_SIZE, LIGHT_TILE_SIZE};
+
+    [[nodiscard]] glm::vec4 get_viewport() const {
+        return {(f32)render_area_.offset.x,
+                (f32)render_area_.offset.y,
+                (f32)render_area_.extent.width,
+                (f32)render_area_.extent.height};
+    }
+
+    GraphicsBackend& gfx_;
+    VkRect2D         render_area_;
+
+    ComputePass  cull_pass_;
+    GraphicsPass shade_pass_;
+    VkSampler    sampler_;
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_TILED_LIGHTING_H
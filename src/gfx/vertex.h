@@ -1,6 +1,11 @@
 #ifndef RUNE_VERTEX_H
 #define RUNE_VERTEX_H
 
+#include "types.h"
+#include "utils.h"
+
+#include <cstring>
+
 namespace rune {
 
 struct Vertex {
@@ -8,6 +13,31 @@ struct Vertex {
     float u, v;
 };
 
+/**
+ * A vertex that compares and hashes by the bits of all of its attributes, for welding the corners of a triangle list
+ * into shared vertices
+ */
+struct VertexKey {
+    Vertex vertex;
+
+    bool operator==(const VertexKey& rhs) const {
+        return std::memcmp(&vertex, &rhs.vertex, sizeof(Vertex)) == 0;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        const f32* values = &key.vertex.x;
+        u64        hash   = 0;
+        for (u32 i = 0; i < sizeof(Vertex) / sizeof(f32); ++i) {
+            u32 bits;
+            std::memcpy(&bits, &values[i], sizeof(u32));
+            hash = utils::hash_combine(hash, bits);
+        }
+        return hash;
+    }
+};
+
 } // namespace rune
 
 #endif // RUNE_VERTEX_H
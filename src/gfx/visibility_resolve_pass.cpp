@@ -0,0 +1,57 @@
+#include "visibility_resolve_pass.h"
+
+namespace rune::gfx {
+
+static GraphicsPassDesc get_pass_desc(VkRect2D render_area) {
+    GraphicsPassDesc desc = {};
+    desc.render_area      = render_area;
+    desc.load_op          = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    desc.is_present_pass  = true;
+    desc.depth.test       = false;
+    desc.depth.write      = false;
+    desc.vert_shader_path = "../data/shaders/fullscreen.vert.spv";
+    desc.frag_shader_path = "../data/shaders/visibility_resolve.frag.spv";
+    return desc;
+}
+
+VisibilityResolvePass::VisibilityResolvePass(Core& core, GraphicsBackend& gfx, VkRect2D render_area)
+    : gfx_(gfx), render_area_(render_area), pass_(core, gfx, get_pass_desc(render_area)) {
+    // the shader only uses texelFetch, but a combined image sampler needs a sampler
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType               = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter           = VK_FILTER_NEAREST;
+    sampler_info.minFilter           = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW        = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_                         = gfx_.create_sampler(sampler_info);
+}
+
+void VisibilityResolvePass::resolve(VkCommandBuffer cmd, const Camera& camera, bool is_culled) {
+    pass_.run(cmd, [&](VkCommandBuffer cmd) {
+        DescriptorWrites writes;
+        writes.set_buffer("u_vertices", gfx_.get_unified_vertex_buffer());
+        writes.set_buffer("u_object_data",
+                          is_culled ? gfx_.get_culled_object_data_buffer() : gfx_.get_object_data_buffer());
+        writes.set_buffer("u_materials", gfx_.get_material_buffer());
+        writes.set_combined_image_sampler("u_visibility_ids",
+                                          gfx_.get_visibility_id_image().view,
+                                          sampler_,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        pass_.set_descriptors(cmd, writes);
+
+        ResolveData resolve_data = {};
+        resolve_data.vp          = camera.get_view_projection_matrix();
+        resolve_data.viewport    = {(f32)render_area_.offset.x,
+                                    (f32)render_area_.offset.y,
+                                    (f32)render_area_.extent.width,
+                                    (f32)render_area_.extent.height};
+        pass_.set_push_constants(cmd, VK_SHADER_STAGE_FRAGMENT_BIT, resolve_data);
+
+        // a single triangle covering the render area, see fullscreen.vert
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+    });
+}
+
+} // namespace rune::gfx
@@ -0,0 +1,51 @@
+#ifndef RUNE_VISIBILITY_RESOLVE_PASS_H
+#define RUNE_VISIBILITY_RESOLVE_PASS_H
+
+#include "gfx/camera.h"
+#include "gfx/graphics_backend.h"
+#include "gfx/graphics_pass.h"
+
+namespace rune {
+class Core;
+}
+
+namespace rune::gfx {
+
+/**
+ * Shades the swapchain image from the visibility buffer with a full screen triangle. Each pixel looks up the triangle
+ * that was drawn to it and fetches its vertices from the unified vertex buffer again, so it's shaded exactly once
+ * however much geometry was drawn over it
+ */
+class VisibilityResolvePass {
+  public:
+    /**
+     * @param render_area The area to shade, the one the visibility buffer was drawn to
+     */
+    explicit VisibilityResolvePass(Core& core, GraphicsBackend& gfx, VkRect2D render_area);
+
+    /**
+     * Record shading the current swapchain image, it's presented after
+     * @note The last pass drawing to the visibility buffer this frame must already have been recorded
+     * @param cmd The command buffer to record to
+     * @param camera The camera the visibility buffer was drawn with
+     * @param is_culled Whether the geometry was gpu culled, its object indices are into the culled object data then
+     */
+    void resolve(VkCommandBuffer cmd, const Camera& camera, bool is_culled);
+
+  private:
+    // matches the push constants of visibility_resolve.frag
+    struct ResolveData {
+        glm::mat4 vp;
+        glm::vec4 viewport; // offset in xy and extent in zw
+    };
+
+    GraphicsBackend& gfx_;
+    VkRect2D         render_area_;
+
+    GraphicsPass pass_;
+    VkSampler    sampler_;
+};
+
+} // namespace rune::gfx
+
+#endif // RUNE_VISIBILITY_RESOLVE_PASS_H
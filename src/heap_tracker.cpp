@@ -0,0 +1,105 @@
+#include "heap_tracker.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace rune::heap_tracker {
+
+namespace {
+
+// per-thread so other threads allocating don't show up in the render thread's counts
+thread_local u32 t_scope_depth     = 0;
+thread_local u64 t_num_allocations = 0;
+
+} // namespace
+
+u64 get_num_allocations() {
+    return t_num_allocations;
+}
+
+Scope::Scope() {
+    ++t_scope_depth;
+}
+
+Scope::~Scope() {
+    --t_scope_depth;
+}
+
+#ifndef NDEBUG
+
+static void* tracked_allocate(std::size_t size, std::size_t alignment) {
+    if (t_scope_depth > 0) {
+        ++t_num_allocations;
+    }
+
+    if (size == 0) {
+        size = 1;
+    }
+
+    void* ptr = alignment > alignof(std::max_align_t)
+                    ? std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1))
+                    : std::malloc(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+#endif
+
+} // namespace rune::heap_tracker
+
+#ifndef NDEBUG
+
+// replacing the global operators, the nothrow versions forward to these so they're counted too
+
+void* operator new(std::size_t size) {
+    return rune::heap_tracker::tracked_allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size) {
+    return rune::heap_tracker::tracked_allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return rune::heap_tracker::tracked_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return rune::heap_tracker::tracked_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef RUNE_HEAP_TRACKER_H
+#define RUNE_HEAP_TRACKER_H
+
+#include "types.h"
+
+namespace rune::heap_tracker {
+
+/**
+ * Get the number of global heap allocations made by this thread inside of a Scope
+ * @note Only tracked in debug builds, always 0 in release builds
+ * @return The number of allocations
+ */
+u64 get_num_allocations();
+
+/**
+ * While a Scope is alive, global operator new calls on this thread are counted. Used to check that code which should
+ * only use arenas doesn't touch the heap.
+ * @note Calls to malloc aren't seen, like the ones the driver and VMA make when buffers or command buffers are created
+ */
+class Scope {
+  public:
+    Scope();
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+} // namespace rune::heap_tracker
+
+#endif // RUNE_HEAP_TRACKER_H
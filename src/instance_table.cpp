@@ -0,0 +1,225 @@
+#include "instance_table.h"
+
+#include "gfx/draw_key.h"
+
+#include <algorithm>
+
+namespace rune {
+
+InstanceTable::InstanceTable(u32 num_copies) : num_copies_(std::min<u32>(num_copies, 8)), dirty_slots_(num_copies_) {}
+
+/**
+ * Get the box around a world space bounding sphere
+ */
+static Aabb get_bounds(const glm::vec4& sphere) {
+    return Aabb::from_sphere(glm::vec3(sphere), sphere.w);
+}
+
+InstanceHandle InstanceTable::create(gfx::Mesh        mesh,
+                                     gfx::Material    material,
+                                     const glm::mat4& transform,
+                                     const glm::vec4& bounding_sphere,
+                                     bool             is_static) {
+    if (mesh.get_index() == gfx::Mesh::INVALID_INDEX) {
+        return {};
+    }
+
+    // the depth only orders instances within a batch, which slots don't
+    u64 key   = gfx::DrawKey::make(material.get_pipeline(), material.get_index(), mesh.get_index(), 0.0f);
+    u64 state = gfx::DrawKey::get_state(key) | (is_static ? 0 : DYNAMIC_STATE);
+
+    u32 batch_index = std::lower_bound(batch_states_.begin(), batch_states_.end(), state) - batch_states_.begin();
+    if (batch_index == batch_states_.size() || batch_states_[batch_index] != state) {
+        insert_batch(batch_index, state, mesh, material);
+    }
+
+    // make room at the end of the batch by moving the first instance of each later batch past its last one
+    transforms_.emplace_back();
+    bounding_spheres_.emplace_back();
+    batch_indices_.emplace_back();
+    handle_indices_.emplace_back();
+    dirty_copies_.emplace_back(0);
+    for (u32 i = batches_.size() - 1; i > batch_index; --i) {
+        gfx::MeshBatch& batch = batches_[i];
+        if (batch.num_objects > 0) {
+            move_slot(batch.first_object_idx, batch.first_object_idx + batch.num_objects);
+        }
+        ++batch.first_object_idx;
+    }
+
+    gfx::MeshBatch& batch = batches_[batch_index];
+    u32             slot  = batch.first_object_idx + batch.num_objects++;
+
+    InstanceHandle handle;
+    if (!free_handles_.empty()) {
+        handle.index = free_handles_.back();
+        free_handles_.pop_back();
+    } else {
+        handle.index = slots_.size();
+        slots_.emplace_back();
+        generations_.emplace_back(0);
+        proxies_.emplace_back();
+    }
+    handle.generation    = generations_[handle.index];
+    slots_[handle.index] = slot;
+
+    transforms_[slot]       = transform;
+    bounding_spheres_[slot] = bounding_sphere;
+    batch_indices_[slot]    = batch_index;
+    handle_indices_[slot]   = handle.index;
+    mark_dirty(slot);
+
+    proxies_[handle.index] = bvh_.insert(get_bounds(get_bounding_sphere(slot)), handle.index);
+
+    ++layout_version_;
+    if (is_static) {
+        ++static_version_;
+    }
+    return handle;
+}
+
+bool InstanceTable::set_transform(InstanceHandle handle, const glm::mat4& transform) {
+    if (!is_alive(handle)) {
+        return false;
+    }
+
+    u32 slot          = slots_[handle.index];
+    transforms_[slot] = transform;
+    mark_dirty(slot);
+
+    bvh_.move(proxies_[handle.index], get_bounds(get_bounding_sphere(slot)));
+
+    if (batch_states_[batch_indices_[slot]] < DYNAMIC_STATE) {
+        ++static_version_;
+    }
+    return true;
+}
+
+bool InstanceTable::destroy(InstanceHandle handle) {
+    if (!is_alive(handle)) {
+        return false;
+    }
+
+    u32 slot        = slots_[handle.index];
+    u32 batch_index = batch_indices_[slot];
+
+    if (batch_states_[batch_index] < DYNAMIC_STATE) {
+        ++static_version_;
+    }
+
+    slots_[handle.index] = NO_SLOT;
+    ++generations_[handle.index];
+    free_handles_.emplace_back(handle.index);
+    bvh_.remove(proxies_[handle.index]);
+
+    // fill the hole with the batch's last instance, then close the gap after the batch by moving the last instance of
+    // each later batch in front of its first one
+    gfx::MeshBatch& batch = batches_[batch_index];
+    u32             hole  = batch.first_object_idx + --batch.num_objects;
+    if (slot != hole) {
+        move_slot(hole, slot);
+    }
+
+    for (u32 i = batch_index + 1; i < batches_.size(); ++i) {
+        gfx::MeshBatch& later_batch = batches_[i];
+        --later_batch.first_object_idx;
+        if (later_batch.num_objects > 0) {
+            u32 last = later_batch.first_object_idx + later_batch.num_objects;
+            move_slot(last, hole);
+            hole = last;
+        }
+    }
+
+    // the hole ended up in the last slot
+    transforms_.pop_back();
+    bounding_spheres_.pop_back();
+    batch_indices_.pop_back();
+    handle_indices_.pop_back();
+    dirty_copies_.pop_back();
+
+    // create and destroy churn across meshes and materials would otherwise leave ever more empty batches to draw
+    if (batch.num_objects == 0) {
+        remove_batch(batch_index);
+    }
+
+    ++layout_version_;
+    return true;
+}
+
+gfx::ObjectData InstanceTable::get_object_data(u32 slot) const {
+    gfx::ObjectData odata  = {};
+    odata.model_matrix     = transforms_[slot];
+    odata.mesh_index       = batches_[batch_indices_[slot]].mesh.get_index();
+    odata.batch_index      = batch_indices_[slot];
+    odata.material_index   = batches_[batch_indices_[slot]].material.get_index();
+    odata.visibility_index = handle_indices_[slot];
+    return odata;
+}
+
+void InstanceTable::take_dirty_slots(u32 copy, FrameVector<u32>& slots) {
+    slots.clear();
+
+    u8 copy_bit = 1 << copy;
+    for (u32 slot : dirty_slots_[copy]) {
+        // slots past the end were freed by destroys since they changed
+        if (slot < dirty_copies_.size()) {
+            dirty_copies_[slot] &= ~copy_bit;
+            slots.emplace_back(slot);
+        }
+    }
+    dirty_slots_[copy].clear();
+
+    // a slot that was freed and taken again can be in the list twice
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+}
+
+void InstanceTable::insert_batch(u32 batch_index, u64 state, gfx::Mesh mesh, gfx::Material material) {
+    gfx::MeshBatch batch;
+    batch.mesh             = mesh;
+    batch.material         = material;
+    batch.first_object_idx =
+        batch_index < batches_.size() ? batches_[batch_index].first_object_idx : (u32)transforms_.size();
+
+    // the object data of every later slot holds its batch index
+    for (u32 slot = batch.first_object_idx; slot < transforms_.size(); ++slot) {
+        ++batch_indices_[slot];
+        mark_dirty(slot);
+    }
+
+    batches_.insert(batches_.begin() + batch_index, batch);
+    batch_states_.insert(batch_states_.begin() + batch_index, state);
+}
+
+void InstanceTable::remove_batch(u32 batch_index) {
+    // the object data of every later slot holds its batch index
+    for (u32 slot = batches_[batch_index].first_object_idx; slot < transforms_.size(); ++slot) {
+        --batch_indices_[slot];
+        mark_dirty(slot);
+    }
+
+    batches_.erase(batches_.begin() + batch_index);
+    batch_states_.erase(batch_states_.begin() + batch_index);
+}
+
+void InstanceTable::move_slot(u32 from, u32 to) {
+    transforms_[to]       = transforms_[from];
+    bounding_spheres_[to] = bounding_spheres_[from];
+    batch_indices_[to]    = batch_indices_[from];
+    handle_indices_[to]   = handle_indices_[from];
+
+    slots_[handle_indices_[to]] = to;
+    mark_dirty(to);
+}
+
+void InstanceTable::mark_dirty(u32 slot) {
+    for (u32 copy = 0; copy < num_copies_; ++copy) {
+        u8 copy_bit = 1 << copy;
+        if ((dirty_copies_[slot] & copy_bit) == 0) {
+            dirty_copies_[slot] |= copy_bit;
+            dirty_slots_[copy].emplace_back(slot);
+        }
+    }
+}
+
+} // namespace rune
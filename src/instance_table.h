@@ -0,0 +1,233 @@
+#ifndef RUNE_INSTANCE_TABLE_H
+#define RUNE_INSTANCE_TABLE_H
+
+#include "frame_arena.h"
+#include "function_ref.h"
+#include "gfx/bvh.h"
+#include "gfx/draw_key.h"
+#include "gfx/graphics_backend.h"
+#include "types.h"
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace rune {
+
+/**
+ * Refers to an instance in an InstanceTable. Its index is reused once the instance is destroyed, but with a new
+ * generation so the old handle is recognized as stale
+ */
+struct InstanceHandle {
+    static constexpr u32 INVALID_INDEX = ~0u;
+
+    u32 index      = INVALID_INDEX;
+    u32 generation = 0;
+
+    [[nodiscard]] bool is_valid() const {
+        return index != INVALID_INDEX;
+    }
+};
+
+/**
+ * Render instances that persist between frames. They're kept in slots ordered by batch, one batch per material and
+ * mesh, so the slots are the object data of the batches as is. The batches are ordered by their draw key state like
+ * the batches of objects added to a frame, see gfx::DrawKey, with the batches of static instances before the rest.
+ * Creating or destroying an instance moves at most one instance of each batch after it to keep the batches contiguous,
+ * and the object data of a slot only has to be uploaded again when it changes. Each copy of the object data, one per
+ * frame in flight, tracks what changed since it was last uploaded.
+ * Every instance's world space bounds are kept in a Bvh, so culling and scene queries don't have to visit all of them.
+ * The slot data is stored as an array per field
+ */
+class InstanceTable {
+  public:
+    /**
+     * @param num_copies The number of copies of the object data that are kept up to date, at most 8
+     */
+    explicit InstanceTable(u32 num_copies);
+
+    /**
+     * @param mesh The mesh to draw the instance with
+     * @param material The material to draw the instance with
+     * @param transform The model matrix
+     * @param bounding_sphere The mesh's bounding sphere in model space, see gfx::MeshData
+     * @param is_static Whether the instance is expected to stay put, static instances get batches of their own
+     * @return A handle to the instance, valid until it's destroyed
+     */
+    InstanceHandle create(gfx::Mesh        mesh,
+                          gfx::Material    material,
+                          const glm::mat4& transform,
+                          const glm::vec4& bounding_sphere,
+                          bool             is_static = false);
+
+    /**
+     * @return Whether the handle referred to a live instance
+     */
+    bool set_transform(InstanceHandle handle, const glm::mat4& transform);
+
+    /**
+     * @return Whether the handle referred to a live instance
+     */
+    bool destroy(InstanceHandle handle);
+
+    [[nodiscard]] bool is_alive(InstanceHandle handle) const {
+        return handle.index < generations_.size() && generations_[handle.index] == handle.generation &&
+               slots_[handle.index] != NO_SLOT;
+    }
+
+    /**
+     * Get the batches the slots are grouped into, the first object of each is its first slot. Every batch has
+     * instances, a batch is removed along with its last instance
+     */
+    [[nodiscard]] const std::vector<gfx::MeshBatch>& get_batches() const {
+        return batches_;
+    }
+
+    /**
+     * Get a number that changes whenever instances are created or destroyed, and with them the batches
+     */
+    [[nodiscard]] u64 get_layout_version() const {
+        return layout_version_;
+    }
+
+    /**
+     * Get the number of batches of static instances, they're the first ones
+     */
+    [[nodiscard]] u32 get_num_static_batches() const {
+        return std::lower_bound(batch_states_.begin(), batch_states_.end(), DYNAMIC_STATE) - batch_states_.begin();
+    }
+
+    /**
+     * Get a number that changes whenever a static instance is created, moved or destroyed
+     */
+    [[nodiscard]] u64 get_static_version() const {
+        return static_version_;
+    }
+
+    [[nodiscard]] u32 get_num_instances() const {
+        return transforms_.size();
+    }
+
+    /**
+     * @param slot The slot, less than get_num_instances
+     */
+    [[nodiscard]] const glm::mat4& get_transform(u32 slot) const {
+        return transforms_[slot];
+    }
+
+    /**
+     * Get the index of a slot's batch in get_batches
+     * @param slot The slot, less than get_num_instances
+     */
+    [[nodiscard]] u32 get_batch_index(u32 slot) const {
+        return batch_indices_[slot];
+    }
+
+    /**
+     * Get the world space bounding sphere of a slot's instance
+     * @param slot The slot, less than get_num_instances
+     */
+    [[nodiscard]] glm::vec4 get_bounding_sphere(u32 slot) const {
+        return transform_bounding_sphere(bounding_spheres_[slot], transforms_[slot]);
+    }
+
+    /**
+     * @param slot The slot, less than get_num_instances
+     * @return A handle to the instance in the slot
+     */
+    [[nodiscard]] InstanceHandle get_handle(u32 slot) const {
+        return InstanceHandle{handle_indices_[slot], generations_[handle_indices_[slot]]};
+    }
+
+    /**
+     * Call a function for the slot of every instance whose bounds might intersect a frustum, see Bvh::query_frustum
+     */
+    void query_frustum(const Frustum& frustum, FunctionRef<void(u32)> func) const {
+        bvh_.query_frustum(frustum, [&](u32 handle_index) { func(slots_[handle_index]); });
+    }
+
+    /**
+     * Call a function for the slot of every instance whose bounds might overlap a box, see Bvh::query_box
+     */
+    void query_box(const Aabb& bounds, FunctionRef<void(u32)> func) const {
+        bvh_.query_box(bounds, [&](u32 handle_index) { func(slots_[handle_index]); });
+    }
+
+    /**
+     * Call a function for the slot of every instance whose bounds a ray segment might hit, nearest first, see
+     * Bvh::query_ray
+     */
+    void query_ray(glm::vec3 origin, glm::vec3 direction, f32 max_t, FunctionRef<f32(u32, f32)> func) const {
+        bvh_.query_ray(origin, direction, max_t, [&](u32 handle_index, f32 t) {
+            return func(slots_[handle_index], t);
+        });
+    }
+
+    /**
+     * Get the object data of a slot, its visibility index is the instance's handle index
+     * @param slot The slot, less than get_num_instances
+     */
+    [[nodiscard]] gfx::ObjectData get_object_data(u32 slot) const;
+
+    /**
+     * Take the slots whose object data changed since a copy was last brought up to date, the copy is up to date after
+     * @param copy The copy, less than num_copies
+     * @param slots Filled with the changed slots in increasing order
+     */
+    void take_dirty_slots(u32 copy, FrameVector<u32>& slots);
+
+  private:
+    static constexpr u32 NO_SLOT = ~0u;
+
+    // set in the batch state of instances that aren't static, above the draw key state so they sort after
+    static constexpr u64 DYNAMIC_STATE = 1ull << (64 - gfx::DrawKey::DEPTH_BITS);
+
+    /**
+     * Insert an empty batch, the slots of the batches after it move up a batch index
+     * @param batch_index Where the batch goes
+     * @param state The batch's draw key state
+     */
+    void insert_batch(u32 batch_index, u64 state, gfx::Mesh mesh, gfx::Material material);
+
+    /**
+     * Remove an empty batch, the slots of the batches after it move down a batch index
+     * @param batch_index The batch
+     */
+    void remove_batch(u32 batch_index);
+
+    /**
+     * Move the instance in a slot to another one, the source is left to be overwritten
+     */
+    void move_slot(u32 from, u32 to);
+
+    void mark_dirty(u32 slot);
+
+    u32 num_copies_;
+    u64 layout_version_ = 0;
+    u64 static_version_ = 0;
+
+    // by handle index
+    std::vector<u32> slots_; // NO_SLOT once destroyed
+    std::vector<u32> generations_;
+    std::vector<u32> free_handles_;
+    std::vector<u32> proxies_; // in bvh_
+
+    // by slot
+    std::vector<glm::mat4> transforms_;
+    std::vector<glm::vec4> bounding_spheres_; // in model space
+    std::vector<u32>       batch_indices_;
+    std::vector<u32>       handle_indices_;
+    std::vector<u8>        dirty_copies_; // a bit for each copy that hasn't been sent the slot since it changed
+
+    // the world space bounds of every instance, with its handle index. Slots move around, handles don't
+    Bvh bvh_;
+
+    std::vector<gfx::MeshBatch> batches_;
+    std::vector<u64>            batch_states_; // draw key state of each batch and DYNAMIC_STATE, in increasing order
+
+    std::vector<std::vector<u32>> dirty_slots_; // by copy, unordered
+};
+
+} // namespace rune
+
+#endif // RUNE_INSTANCE_TABLE_H
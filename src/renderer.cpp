@@ -1,81 +1,854 @@
 #include "renderer.h"
 
 #include "core.h"
-#include "gfx/graphics_pass.h"
+#include "gfx/draw_key.h"
+#include "gfx/frustum_culling.h"
+#include "gfx/meshlet_pass.h"
+#include "gfx/render_graph.h"
+#include "gfx/visibility_resolve_pass.h"
+#include "heap_tracker.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <numeric>
 
 namespace rune {
 
-Renderer::Renderer(Core& core) : core_(core), gfx_(core_.get_platform().get_graphics_backend()) {}
+Renderer::Renderer(Core& core)
+    : core_(core), gfx_(core_.get_platform().get_graphics_backend()), gpu_culling_(core_, gfx_),
+      render_objects_(FrameAllocator<RenderObject>(frame_arena_)),
+      lights_(FrameAllocator<gfx::PointLight>(frame_arena_)),
+      particle_emitters_(FrameAllocator<gfx::ParticleEmitter>(frame_arena_)),
+      instances_(gfx::GraphicsBackend::get_num_frames_in_flight()) {}
 
 void Renderer::add_to_frame(const RenderObject& robj) {
-    render_objects_by_mesh_[robj.mesh.get_id()].emplace_back(robj);
+    heap_tracker::Scope heap_scope;
+
+    render_objects_.emplace_back(robj);
+}
+
+void Renderer::add_light(const gfx::PointLight& light) {
+    heap_tracker::Scope heap_scope;
+
+    lights_.emplace_back(light);
+}
+
+void Renderer::add_particle_emitter(const gfx::ParticleEmitter& emitter) {
+    heap_tracker::Scope heap_scope;
+
+    particle_emitters_.emplace_back(emitter);
+}
+
+InstanceHandle Renderer::create_instance(gfx::Mesh        mesh,
+                                         const glm::mat4& transform,
+                                         gfx::Material    material,
+                                         bool             is_static) {
+    if (mesh.get_index() == gfx::Mesh::INVALID_INDEX) {
+        core_.get_logger().warn("tried to create an instance of an invalid mesh");
+        return {};
+    }
+    if (instances_.get_num_instances() >= MAX_INSTANCES) {
+        core_.get_logger().warn("could not create instance. current: %, max: %",
+                                instances_.get_num_instances(),
+                                MAX_INSTANCES);
+        return {};
+    }
+
+    const glm::vec4& bounding_sphere = gfx_.get_mesh_data(mesh.get_index()).bounding_sphere;
+    return instances_.create(mesh, material, transform, bounding_sphere, is_static);
+}
+
+void Renderer::set_transform(InstanceHandle handle, const glm::mat4& transform) {
+    if (!instances_.set_transform(handle, transform)) {
+        core_.get_logger().warn("tried to move instance %, which doesn't exist", handle.index);
+    }
+}
+
+void Renderer::destroy_instance(InstanceHandle handle) {
+    if (!instances_.destroy(handle)) {
+        core_.get_logger().warn("tried to destroy instance %, which doesn't exist", handle.index);
+    }
+}
+
+InstanceHandle Renderer::pick(glm::vec3 origin, glm::vec3 direction, f32 max_distance, f32* distance) const {
+    InstanceHandle hit;
+    glm::vec3      ray_direction = glm::normalize(direction);
+
+    instances_.query_ray(origin, ray_direction, max_distance, [&](u32 slot, f32 max_t) {
+        // where the ray enters the sphere, or its start if it's inside
+        glm::vec4 sphere       = instances_.get_bounding_sphere(slot);
+        glm::vec3 to_center    = glm::vec3(sphere) - origin;
+        f32       t_center     = glm::dot(to_center, ray_direction);
+        f32       distance_sq  = glm::dot(to_center, to_center) - t_center * t_center;
+        f32       half_span_sq = sphere.w * sphere.w - distance_sq;
+        if (half_span_sq < 0.0f || t_center + glm::sqrt(half_span_sq) < 0.0f) {
+            return max_t;
+        }
+
+        f32 t = glm::max(t_center - glm::sqrt(half_span_sq), 0.0f);
+        if (t >= max_t) {
+            return max_t;
+        }
+
+        hit = instances_.get_handle(slot);
+        if (distance) {
+            *distance = t;
+        }
+        return t;
+    });
+
+    return hit;
+}
+
+void Renderer::query_box(const Aabb& bounds, FunctionRef<void(InstanceHandle)> func) const {
+    instances_.query_box(bounds, [&](u32 slot) {
+        // the tree holds enlarged boxes
+        glm::vec4 sphere = instances_.get_bounding_sphere(slot);
+        if (Aabb::from_sphere(glm::vec3(sphere), sphere.w).overlaps(bounds)) {
+            func(instances_.get_handle(slot));
+        }
+    });
 }
 
 void Renderer::render() {
+    // the whole frame is counted, so once it settles the assert at the end sees every allocation made while building,
+    // uploading and recording it
+    heap_tracker::Scope heap_scope;
+
     // TODO: use shaderc to compile shader strings for fast iteration and so we're not committing spriv
 
     gfx::GraphicsPassDesc pass_desc = {};
     pass_desc.render_area      = {0, 0, core_.get_config().get_window_width(), core_.get_config().get_window_height()};
-    pass_desc.vert_shader_path = "../data/shaders/triangle.vert.spv";
+    pass_desc.vert_shader_path = gfx_.supports_multi_draw_indirect() ? "../data/shaders/triangle.vert.spv"
+                                                                     : "../data/shaders/triangle_single_draw.vert.spv";
     pass_desc.frag_shader_path = "../data/shaders/triangle.frag.spv";
 
-    static gfx::GraphicsPass pass(core_, gfx_, pass_desc);
+    // with deferred lighting the geometry passes write a g-buffer, the lights are binned into screen tiles and a full
+    // screen pass lights each pixel with its tile's lights
+    bool is_deferred = core_.get_config().get_lighting_mode() == LightingMode::DEFERRED;
 
-    // TODO: materials
-    // TODO: attachment description
-    // TODO: index buffer support
+    // with clustered lighting the lights are binned into clusters of the view frustum before the geometry passes,
+    // which light each pixel with its cluster's lights as they draw
+    bool is_clustered = core_.get_config().get_lighting_mode() == LightingMode::CLUSTERED;
 
-    process_object_data();
+    // with shadows the directional light's cascaded shadow maps are drawn before the geometry passes, which sample
+    // them. Only clustered lighting samples them, and the casters are only all in the batches when culling them is
+    // left to the gpu
+    bool is_shadowed = core_.get_config().is_shadows_enabled() && is_clustered && gfx_.supports_multiview() &&
+                       gfx_.supports_gpu_culling();
+
+    // with a visibility buffer the geometry passes only write triangle ids, a full screen pass shades them after
+    bool is_visibility_buffer = core_.get_config().is_visibility_buffer_enabled() && !is_deferred && !is_clustered;
+
+    // meshlets are culled on their own, so the whole frame is drawn in one pass
+    MeshletMode meshlet_mode = core_.get_config().get_meshlet_mode();
+    bool        is_meshlet   = meshlet_mode != MeshletMode::OFF && gfx_.supports_meshlets();
+
+    // with particles they're drawn last, blended over geometry that was shaded as it was drawn
+    bool is_particles =
+        core_.get_config().is_particles_enabled() && !is_deferred && !is_visibility_buffer && !is_meshlet;
+
+    // with a depth prepass each phase lays down its depth first, so its geometry pass only shades the closest surface.
+    // The visibility buffer already shades each pixel once
+    bool is_depth_prepass = core_.get_config().is_depth_prepass_enabled() && !is_visibility_buffer;
+
+    gfx::GraphicsPassDesc prepass_desc = pass_desc;
+    prepass_desc.vert_shader_path      = gfx_.supports_multi_draw_indirect()
+                                             ? "../data/shaders/depth_prepass.vert.spv"
+                                             : "../data/shaders/depth_prepass_single_draw.vert.spv";
+    prepass_desc.frag_shader_path      = nullptr;
+    prepass_desc.is_present_pass       = false;
+
+    // only created when enabled, so their shaders aren't needed otherwise
+    static std::optional<gfx::GraphicsPass> early_prepass;
+    static std::optional<gfx::GraphicsPass> late_prepass;
+    if (is_depth_prepass && !early_prepass) {
+        prepass_desc.load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        early_prepass.emplace(core_, gfx_, prepass_desc);
+
+        prepass_desc.load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+        late_prepass.emplace(core_, gfx_, prepass_desc);
+    }
+
+    gfx::GraphicsPassDesc geometry_desc = pass_desc;
+    if (is_depth_prepass) {
+        geometry_desc.depth.write      = false;
+        geometry_desc.depth.compare_op = VK_COMPARE_OP_EQUAL;
+    }
+    if (is_visibility_buffer) {
+        geometry_desc.vert_shader_path = gfx_.supports_multi_draw_indirect()
+                                             ? "../data/shaders/visibility.vert.spv"
+                                             : "../data/shaders/visibility_single_draw.vert.spv";
+        geometry_desc.frag_shader_path = "../data/shaders/visibility.frag.spv";
+        geometry_desc.color_attachment = gfx::ColorAttachment::VISIBILITY_ID;
+    }
+    if (is_deferred) {
+        geometry_desc.vert_shader_path = gfx_.supports_multi_draw_indirect()
+                                             ? "../data/shaders/gbuffer.vert.spv"
+                                             : "../data/shaders/gbuffer_single_draw.vert.spv";
+        geometry_desc.frag_shader_path = "../data/shaders/gbuffer.frag.spv";
+        geometry_desc.color_attachment = gfx::ColorAttachment::GBUFFER;
+    }
+    if (is_clustered) {
+        geometry_desc.vert_shader_path = gfx_.supports_multi_draw_indirect()
+                                             ? "../data/shaders/gbuffer.vert.spv"
+                                             : "../data/shaders/gbuffer_single_draw.vert.spv";
+        geometry_desc.frag_shader_path = is_shadowed ? "../data/shaders/clustered_forward_shadowed.frag.spv"
+                                                     : "../data/shaders/clustered_forward.frag.spv";
+    }
+
+    // the early pass draws what was visible last frame, the late pass draws on top of it after occlusion culling
+    geometry_desc.load_op         = is_depth_prepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    geometry_desc.is_present_pass = false;
+    static gfx::GraphicsPass early_pass(core_, gfx_, geometry_desc);
+
+    geometry_desc.load_op         = VK_ATTACHMENT_LOAD_OP_LOAD;
+    geometry_desc.is_present_pass = !is_particles;
+    static gfx::GraphicsPass late_pass(core_, gfx_, geometry_desc);
+
+    // only created when enabled, so their shaders aren't needed otherwise
+    static std::optional<gfx::VisibilityResolvePass> resolve_pass;
+    if (is_visibility_buffer && !resolve_pass) {
+        resolve_pass.emplace(core_, gfx_, pass_desc.render_area);
+    }
+    static std::optional<gfx::TiledLighting> tiled_lighting;
+    if (is_deferred && !tiled_lighting) {
+        tiled_lighting.emplace(core_, gfx_, pass_desc.render_area);
+    }
+    static std::optional<gfx::ClusteredLighting> clustered_lighting;
+    if (is_clustered && !clustered_lighting) {
+        clustered_lighting.emplace(core_, gfx_, pass_desc.render_area);
+    }
+    if (is_shadowed && !shadow_maps_) {
+        shadow_maps_.emplace(core_, gfx_);
+    }
+    if (is_particles && !particle_system_) {
+        gfx::GraphicsPassDesc particle_desc = pass_desc;
+        particle_desc.load_op               = VK_ATTACHMENT_LOAD_OP_LOAD;
+        particle_desc.is_present_pass       = true;
+        particle_system_.emplace(core_, gfx_, particle_desc);
+    }
 
+    // TODO: index buffer support
+
+    // the frame's buffers are only safe to write once begin_frame has waited on them
     gfx_.begin_frame();
+    process_object_data();
+    gfx_.update_light_data(lights_);
+    update_directional_light();
     {
-        pass.run(gfx_.get_command_buffer(), [&](VkCommandBuffer cmd) {
-            // update unified buffer descriptors
-            gfx::DescriptorWrites writes;
-            writes.set_buffer("u_vertices", gfx_.get_unified_vertex_buffer());
-            writes.set_buffer("u_object_data", gfx_.get_object_data_buffer());
-            pass.set_descriptors(cmd, writes);
-
-            struct DrawData {
-                glm::mat4 vp;
-            } draw_data  = {};
-            draw_data.vp = camera_.get_view_projection_matrix();
-            pass.set_push_constants(cmd, VK_SHADER_STAGE_VERTEX_BIT, draw_data);
-
-            gfx_.draw_batch_group(cmd, geometry_batch_group_);
-        });
+        VkCommandBuffer cmd = gfx_.get_command_buffer();
+
+        if (is_meshlet) {
+            pass_desc.load_op         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            pass_desc.is_present_pass = true;
+            static gfx::MeshletPass meshlet_pass(core_,
+                                                 gfx_,
+                                                 pass_desc,
+                                                 meshlet_mode == MeshletMode::ON && gfx_.supports_mesh_shaders());
+            meshlet_pass.draw(cmd, batches_, camera_);
+        } else {
+            // each way of culling has its own passes, their graph is built the first frame it's used. The graph works
+            // out the barriers between the passes from what they declare
+            bool is_gpu_culled = gfx_.supports_gpu_culling() && geometry_batch_group_.num_batches > 0;
+            static gfx::RenderGraph gpu_culled_graph(core_, gfx_);
+            static gfx::RenderGraph cpu_culled_graph(core_, gfx_);
+            gfx::RenderGraph& graph = is_gpu_culled ? gpu_culled_graph : cpu_culled_graph;
+
+            // the graphs import them first, so they're the same in both
+            static GraphImages images;
+            if (!graph.is_compiled()) {
+                build_render_graph(graph,
+                                   is_gpu_culled,
+                                   early_prepass,
+                                   early_pass,
+                                   late_prepass,
+                                   late_pass,
+                                   resolve_pass,
+                                   tiled_lighting,
+                                   clustered_lighting,
+                                   images);
+            }
+
+            graph.set_image(images.depth, gfx_.get_depth_image());
+            if (is_visibility_buffer) {
+                graph.set_image(images.visibility_id, gfx_.get_visibility_id_image());
+            }
+            if (is_deferred) {
+                for (u32 i = 0; i < gfx::MAX_COLOR_ATTACHMENTS; ++i) {
+                    graph.set_image(images.gbuffer[i], gfx_.get_gbuffer_image((gfx::GBufferAttachment)i));
+                }
+            }
+            if (shadow_maps_) {
+                graph.set_image(images.shadow_map, shadow_maps_->get_shadow_map());
+            }
+            graph.execute(cmd);
+        }
     }
     gfx_.end_frame();
 
+    // once the scene settles, building the frame should only have used the arenas
+    if (num_frames_layout_unchanged_ >= STEADY_STATE_FRAMES) {
+        rune_debug_assert(core_, heap_tracker::get_num_allocations() == frame_start_allocations_);
+    }
+
     reset_frame();
 }
 
+void Renderer::build_render_graph(gfx::RenderGraph&                          graph,
+                                  bool                                       is_gpu_culled,
+                                  std::optional<gfx::GraphicsPass>&          early_prepass,
+                                  gfx::GraphicsPass&                         early_pass,
+                                  std::optional<gfx::GraphicsPass>&          late_prepass,
+                                  gfx::GraphicsPass&                         late_pass,
+                                  std::optional<gfx::VisibilityResolvePass>& resolve_pass,
+                                  std::optional<gfx::TiledLighting>&         tiled_lighting,
+                                  std::optional<gfx::ClusteredLighting>&     clustered_lighting,
+                                  GraphImages&                               images) {
+    using ResourceId = gfx::RenderGraph::ResourceId;
+
+    ResourceId depth_image = graph.import_image("depth",
+                                                VK_IMAGE_ASPECT_DEPTH_BIT,
+                                                VK_IMAGE_LAYOUT_UNDEFINED,
+                                                VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    images.depth           = depth_image;
+
+    // the geometry passes' color attachments, other than the swapchain image
+    std::vector<ResourceId> color_images;
+    images.visibility_id = graph.import_image("visibility_id",
+                                              VK_IMAGE_ASPECT_COLOR_BIT,
+                                              VK_IMAGE_LAYOUT_UNDEFINED,
+                                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (resolve_pass) {
+        color_images.emplace_back(images.visibility_id);
+    }
+
+    constexpr const char* gbuffer_names[] = {"gbuffer_diffuse",
+                                             "gbuffer_normal",
+                                             "gbuffer_occlusion_roughness_metallic"};
+    static_assert(std::size(gbuffer_names) == gfx::MAX_COLOR_ATTACHMENTS);
+    for (u32 i = 0; i < gfx::MAX_COLOR_ATTACHMENTS; ++i) {
+        images.gbuffer[i] = graph.import_image(gbuffer_names[i],
+                                               VK_IMAGE_ASPECT_COLOR_BIT,
+                                               VK_IMAGE_LAYOUT_UNDEFINED,
+                                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        if (tiled_lighting) {
+            color_images.emplace_back(images.gbuffer[i]);
+        }
+    }
+
+    // drawn by the shadows pass, which leaves it to be sampled
+    images.shadow_map = graph.import_image("shadow_map",
+                                           VK_IMAGE_ASPECT_DEPTH_BIT,
+                                           VK_IMAGE_LAYOUT_UNDEFINED,
+                                           VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+    // written by the upload before the graph, which waits for the copy to finish
+    ResourceId object_data = graph.import_buffer("object_data");
+    // the culled object data, draws and counts
+    ResourceId culled_draws  = graph.import_buffer("culled_draws");
+    ResourceId depth_pyramid = graph.import_image("depth_pyramid",
+                                                  VK_IMAGE_ASPECT_COLOR_BIT,
+                                                  VK_IMAGE_LAYOUT_GENERAL,
+                                                  VK_IMAGE_LAYOUT_GENERAL);
+    // the lights are uploaded before the graph like the object data, only their tiles and clusters are written in it
+    ResourceId light_tiles    = graph.import_buffer("light_tiles");
+    ResourceId light_clusters = graph.import_buffer("light_clusters");
+    // the particles, their draw list and counts, kept on the gpu between frames
+    ResourceId particles = graph.import_buffer("particles");
+
+    u32 viewport_height = core_.get_config().get_window_height();
+
+    auto add_cull_pass = [&](const char* name, gfx::GpuCulling::Phase phase, gfx::BatchGroup* culled_group) {
+        graph
+            .add_pass(name,
+                      [this, phase, culled_group, viewport_height](VkCommandBuffer cmd) {
+                          *culled_group = gpu_culling_.cull(cmd,
+                                                            geometry_batch_group_,
+                                                            num_objects_,
+                                                            camera_,
+                                                            viewport_height,
+                                                            phase);
+                      })
+            .read(object_data, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT)
+            .write(culled_draws,
+                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                   VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    };
+
+    // the early pass clears what the late pass loads, and the late pass leaves the visibility buffer or g-buffer to be
+    // shaded
+    auto add_geometry_pass = [&](const char*                       name,
+                                 std::optional<gfx::GraphicsPass>& prepass,
+                                 gfx::GraphicsPass&                pass,
+                                 const gfx::BatchGroup*            group,
+                                 bool                              is_late) {
+        gfx::RenderGraph::PassBuilder builder =
+            graph.add_pass(name, [this, prepass = &prepass, pass = &pass, group](VkCommandBuffer cmd) {
+                draw_geometry(*prepass, *pass, cmd, *group);
+            });
+
+        builder.attachment(depth_image,
+                           is_late ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                           VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        for (ResourceId color_image : color_images) {
+            builder.attachment(color_image,
+                               is_late ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                               is_late ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                       : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        }
+        if (color_images.empty() && is_late) {
+            // presents
+            builder.set_side_effects();
+        }
+
+        if (clustered_lighting) {
+            builder.read(light_clusters, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        }
+        if (shadow_maps_) {
+            builder.read(images.shadow_map,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_ACCESS_SHADER_READ_BIT,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        }
+
+        if (is_gpu_culled) {
+            builder.read(culled_draws,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+        }
+    };
+
+    if (clustered_lighting) {
+        graph
+            .add_pass("light_clustering",
+                      [this, clustered_lighting = &clustered_lighting](VkCommandBuffer cmd) {
+                          (*clustered_lighting)->assign_lights(cmd, camera_);
+                      })
+            .write(light_clusters, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    }
+
+    if (shadow_maps_) {
+        // the static instances' batches come first, every other batch is drawn on top of the cached static casters.
+        // Casters aren't culled, so the shadows don't depend on what the camera sees
+        graph
+            .add_pass("shadows",
+                      [this](VkCommandBuffer cmd) {
+                          gfx::BatchGroup static_casters = geometry_batch_group_;
+                          static_casters.num_batches     = std::min(instances_.get_num_static_batches(),
+                                                                geometry_batch_group_.num_batches);
+
+                          gfx::BatchGroup dynamic_casters = geometry_batch_group_;
+                          dynamic_casters.first_batch += static_casters.num_batches;
+                          dynamic_casters.num_batches -= static_casters.num_batches;
+
+                          shadow_maps_->draw(cmd, static_casters, dynamic_casters);
+                      })
+            .read(object_data, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT)
+            .attachment(images.shadow_map,
+                        VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    }
+
+    if (particle_system_) {
+        graph
+            .add_pass("particle_simulation",
+                      [this](VkCommandBuffer cmd) {
+                          particle_system_->simulate(cmd, particle_emitters_, camera_, time_);
+                      })
+            .write(particles,
+                   VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+
+    static const gfx::BatchGroup no_group;
+    if (is_gpu_culled) {
+        add_cull_pass("early_cull", gfx::GpuCulling::Phase::EARLY, &early_group_);
+        add_geometry_pass("early_geometry", early_prepass, early_pass, &early_group_, false);
+
+        graph
+            .add_pass("depth_pyramid",
+                      [this](VkCommandBuffer cmd) { gpu_culling_.build_depth_pyramid(cmd, gfx_.get_depth_image()); })
+            .read(depth_image,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT,
+                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+            .write(depth_pyramid,
+                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                   VK_IMAGE_LAYOUT_GENERAL);
+
+        add_cull_pass("late_cull", gfx::GpuCulling::Phase::LATE, &late_group_);
+        add_geometry_pass("late_geometry", late_prepass, late_pass, &late_group_, true);
+    } else {
+        add_geometry_pass("early_geometry", early_prepass, early_pass, &geometry_batch_group_, false);
+        add_geometry_pass("late_geometry", late_prepass, late_pass, &no_group, true);
+    }
+
+    if (particle_system_) {
+        // on top of the late geometry pass, the last to draw to the swapchain image without particles
+        graph.add_pass("particles", [this](VkCommandBuffer cmd) { particle_system_->draw(cmd, camera_); })
+            .read(particles,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT)
+            .attachment(depth_image,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+            .set_side_effects();
+    }
+
+    if (resolve_pass) {
+        // out of room for culled batches the early phase draws the original group, and the late phase nothing
+        graph
+            .add_pass("visibility_resolve",
+                      [this, is_gpu_culled, resolve_pass = &resolve_pass](VkCommandBuffer cmd) {
+                          bool is_culled = is_gpu_culled && early_group_.count_buffer != VK_NULL_HANDLE;
+                          (*resolve_pass)->resolve(cmd, camera_, is_culled);
+                      })
+            .read(images.visibility_id,
+                  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT,
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+            .set_side_effects();
+    }
+
+    if (tiled_lighting) {
+        graph
+            .add_pass("light_culling",
+                      [this, tiled_lighting = &tiled_lighting](VkCommandBuffer cmd) {
+                          (*tiled_lighting)->cull_lights(cmd, camera_, gfx_.get_depth_image());
+                      })
+            .read(depth_image,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT,
+                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+            .write(light_tiles, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+        gfx::RenderGraph::PassBuilder builder =
+            graph.add_pass("deferred_lighting", [this, tiled_lighting = &tiled_lighting](VkCommandBuffer cmd) {
+                (*tiled_lighting)->shade(cmd, camera_, gfx_.get_depth_image());
+            });
+        for (ResourceId gbuffer_image : images.gbuffer) {
+            builder.read(gbuffer_image,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_ACCESS_SHADER_READ_BIT,
+                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+        builder
+            .read(depth_image,
+                  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                  VK_ACCESS_SHADER_READ_BIT,
+                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+            .read(light_tiles, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT)
+            .set_side_effects();
+    }
+
+    graph.compile();
+}
+
+void Renderer::draw_geometry(std::optional<gfx::GraphicsPass>& prepass,
+                             gfx::GraphicsPass&                pass,
+                             VkCommandBuffer                   cmd,
+                             const gfx::BatchGroup&            group) {
+    if (prepass) {
+        draw_geometry(*prepass, cmd, group);
+    }
+    draw_geometry(pass, cmd, group);
+}
+
+void Renderer::draw_geometry(gfx::GraphicsPass& pass, VkCommandBuffer cmd, const gfx::BatchGroup& group) {
+    pass.run(cmd, [&](VkCommandBuffer cmd) {
+        if (group.num_batches == 0) {
+            return;
+        }
+
+        // groups with a gpu count were culled, their instances are in the culled object data
+        bool is_culled = group.count_buffer != VK_NULL_HANDLE;
+
+        // update unified buffer descriptors
+        gfx::DescriptorWrites writes;
+        writes.set_buffer("u_vertices", gfx_.get_unified_vertex_buffer());
+        writes.set_buffer("u_object_data",
+                          is_culled ? gfx_.get_culled_object_data_buffer() : gfx_.get_object_data_buffer());
+        if (!gfx_.supports_multi_draw_indirect()) {
+            writes.set_buffer("u_mesh_table", gfx_.get_mesh_table_buffer());
+            writes.set_buffer("u_instance_ranges", gfx_.get_instance_range_buffer());
+        }
+        if (pass.has_descriptor("u_materials")) {
+            // the depth prepass doesn't shade
+            writes.set_buffer("u_materials", gfx_.get_material_buffer());
+        }
+        if (pass.has_descriptor("u_light_clusters")) {
+            // lit by clusters, unlike the depth prepass that shares this
+            writes.set_buffer("u_lights", gfx_.get_light_data_buffer());
+            writes.set_buffer("u_light_clusters", gfx_.get_light_cluster_buffer());
+            writes.set_buffer("u_directional_light", gfx_.get_directional_light_buffer());
+        }
+        if (pass.has_descriptor("u_shadow_map")) {
+            writes.set_combined_image_sampler("u_shadow_map",
+                                              shadow_maps_->get_shadow_map().view,
+                                              shadow_maps_->get_sampler(),
+                                              VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        }
+        pass.set_descriptors(cmd, writes);
+
+        struct DrawData {
+            glm::mat4 vp;
+        } draw_data  = {};
+        draw_data.vp = camera_.get_view_projection_matrix();
+        pass.set_push_constants(cmd, VK_SHADER_STAGE_VERTEX_BIT, draw_data);
+
+        gfx_.draw_batch_group(cmd, group);
+    });
+}
+
+void Renderer::update_directional_light() {
+    // without shadow maps the light is uploaded without cascades, which nothing samples
+    gfx::DirectionalLightData light_data = {};
+    light_data.light                     = directional_light_;
+    if (shadow_maps_) {
+        shadow_maps_->update(camera_, directional_light_, instances_.get_static_version());
+        light_data = shadow_maps_->get_light_data();
+    }
+    gfx_.update_directional_light(light_data);
+}
+
 void Renderer::process_object_data() {
-    // create batches and object data
-    std::vector<gfx::ObjectData> object_data;
-    std::vector<gfx::MeshBatch>  batches;
-    gfx::MeshBatch               prev_batch;
-    for (auto [mesh_id, render_objects] : render_objects_by_mesh_) {
-        gfx::MeshBatch batch;
-        batch.mesh             = render_objects.front().mesh;
-        batch.first_object_idx = prev_batch.first_object_idx + prev_batch.num_objects;
-        batch.num_objects      = render_objects.size();
-        batches.emplace_back(batch);
+    // retained instances go at the start of the object data as they're laid out in their table, only what changed is
+    // uploaded. Without gpu culling only the runs of them that might be visible are drawn
+    upload_instances();
+
+    FrameVector<gfx::MeshBatch>     visible_batches{FrameAllocator<gfx::MeshBatch>(frame_arena_)};
+    std::span<const gfx::MeshBatch> instance_batches = instances_.get_batches();
+    if (!gfx_.supports_gpu_culling()) {
+        cull_instances(visible_batches);
+        instance_batches = visible_batches;
+    }
+
+    FrameVector<gfx::ObjectData> object_data{FrameAllocator<gfx::ObjectData>(frame_arena_)};
+    build_object_data(object_data, instance_batches);
+
+    u32 first_object = instances_.get_num_instances();
+    gfx_.update_object_data(object_data.data(), object_data.size(), first_object);
+    num_objects_ = first_object + object_data.size();
+
+    // the backend skips uploading the indirect commands if its buffer for this frame already holds these batches
+    geometry_batch_group_ = gfx_.add_batches(batches_);
+}
+
+void Renderer::upload_instances() {
+    // this frame's copy of the object data was last written NUM_FRAMES_IN_FLIGHT frames ago
+    FrameVector<u32> slots{FrameAllocator<u32>(frame_arena_)};
+    instances_.take_dirty_slots(gfx_.get_frame_index(), slots);
+    if (slots.empty()) {
+        return;
+    }
+
+    FrameVector<gfx::ObjectData> object_data{FrameAllocator<gfx::ObjectData>(frame_arena_)};
+    object_data.reserve(slots.size());
+    for (u32 slot : slots) {
+        object_data.emplace_back(instances_.get_object_data(slot));
+    }
+
+    gfx_.update_object_data(object_data, slots);
+}
+
+void Renderer::cull_instances(FrameVector<gfx::MeshBatch>& visible_batches) {
+    // the tree skips whole groups of instances outside the frustum
+    FrameVector<u32> slots{FrameAllocator<u32>(frame_arena_)};
+    instances_.query_frustum(camera_.get_frustum(), [&](u32 slot) { slots.emplace_back(slot); });
+    std::sort(slots.begin(), slots.end());
+
+    // consecutive visible slots of a batch are drawn together
+    FrameVector<u32> run_batch_indices{FrameAllocator<u32>(frame_arena_)};
+    for (u32 slot : slots) {
+        u32  batch_index = instances_.get_batch_index(slot);
+        bool is_in_run   = !visible_batches.empty() && run_batch_indices.back() == batch_index &&
+                           visible_batches.back().first_object_idx + visible_batches.back().num_objects == slot;
+        if (!is_in_run) {
+            gfx::MeshBatch run   = instances_.get_batches()[batch_index];
+            run.first_object_idx = slot;
+            run.num_objects      = 0;
+            visible_batches.emplace_back(run);
+            run_batch_indices.emplace_back(batch_index);
+        }
+        ++visible_batches.back().num_objects;
+    }
+
+    // a scattered view can split the batches into more draws than there's room for, then each batch draws everything
+    // between its first and last visible instance instead
+    if (visible_batches.size() > MAX_INSTANCE_RUNS) {
+        u32 num_merged = 0;
+        for (u32 i = 0; i < visible_batches.size(); ++i) {
+            if (num_merged > 0 && run_batch_indices[num_merged - 1] == run_batch_indices[i]) {
+                gfx::MeshBatch& merged = visible_batches[num_merged - 1];
+                u32             end    = visible_batches[i].first_object_idx + visible_batches[i].num_objects;
+                merged.num_objects     = end - merged.first_object_idx;
+            } else {
+                visible_batches[num_merged]   = visible_batches[i];
+                run_batch_indices[num_merged] = run_batch_indices[i];
+                ++num_merged;
+            }
+        }
+        visible_batches.resize(num_merged);
+    }
+}
 
-        prev_batch = batch;
+void Renderer::build_object_data(FrameVector<gfx::ObjectData>&   object_data,
+                                 std::span<const gfx::MeshBatch> instance_batches) {
+    FrameVector<u64> keys{FrameAllocator<u64>(frame_arena_)};
+    FrameVector<u32> object_indices{FrameAllocator<u32>(frame_arena_)};
+    sort_render_objects(keys, object_indices);
+
+    // the instances' batches come first, the objects added to the frame are placed after them
+    u32 first_object = instances_.get_num_instances();
+    u32 first_batch  = instance_batches.size();
+
+    // each run of keys with the same state is a batch. The batch layout only depends on the instances' batches, the
+    // states and how long their runs are, if it's the same as last frame then the batches are too and only the object
+    // data needs to be rebuilt. The instances' meshes and materials only change along with the table's layout version
+    FrameVector<u64> layout{FrameAllocator<u64>(frame_arena_)};
+    layout.emplace_back(instances_.get_layout_version());
+    for (const gfx::MeshBatch& batch : instance_batches) {
+        layout.emplace_back(batch.first_object_idx);
+        layout.emplace_back(batch.num_objects);
+    }
+    for (u32 first = 0, last = 0; first < keys.size(); first = last) {
+        u64 state = gfx::DrawKey::get_state(keys[first]);
+        while (last < keys.size() && gfx::DrawKey::get_state(keys[last]) == state) {
+            ++last;
+        }
+
+        layout.emplace_back(state);
+        layout.emplace_back(last - first);
+    }
+
+    // the hash rules out most changes cheaply, the layout itself is compared so a collision can't keep stale batches
+    u64 layout_hash = 0;
+    for (u64 value : layout) {
+        layout_hash = utils::hash_combine(layout_hash, value);
+    }
+    bool is_layout_unchanged = layout_hash == batch_layout_hash_ && !batches_.empty() &&
+                               std::equal(layout.begin(), layout.end(), batch_layout_.begin(), batch_layout_.end());
+
+    if (is_layout_unchanged) {
+        ++num_frames_layout_unchanged_;
+    } else {
+        num_frames_layout_unchanged_ = 0;
+
+        batches_.clear();
+        batches_.insert(batches_.end(), instance_batches.begin(), instance_batches.end());
+        for (u32 i = 0; i < keys.size(); ++i) {
+            if (i == 0 || gfx::DrawKey::get_state(keys[i]) != gfx::DrawKey::get_state(keys[i - 1])) {
+                gfx::MeshBatch batch;
+                batch.mesh             = render_objects_[object_indices[i]].mesh;
+                batch.material         = render_objects_[object_indices[i]].material;
+                batch.first_object_idx = first_object + i;
+                batches_.emplace_back(batch);
+            }
+            ++batches_.back().num_objects;
+        }
+        batch_layout_.assign(layout.begin(), layout.end());
+        batch_layout_hash_ = layout_hash;
+    }
 
-        for (const RenderObject& robj : render_objects) {
-            gfx::ObjectData odata = {};
-            odata.model_matrix    = robj.model_matrix;
-            object_data.emplace_back(odata);
+    // create object data in key order, so each batch's objects are its range of it
+    object_data.reserve(keys.size());
+    u32 batch_index = first_batch;
+    for (u32 i = 0; i < keys.size(); ++i) {
+        if (i > 0 && gfx::DrawKey::get_state(keys[i]) != gfx::DrawKey::get_state(keys[i - 1])) {
+            ++batch_index;
         }
+
+        const RenderObject& robj = render_objects_[object_indices[i]];
+
+        // the instances' visibility is kept by handle index, below MAX_INSTANCES. An object added to the frame is only
+        // known by the order it was added in, past the end of the visibility buffer it's tested as if it wasn't visible
+        gfx::ObjectData odata  = {};
+        odata.model_matrix     = robj.model_matrix;
+        odata.mesh_index       = robj.mesh.get_index();
+        odata.batch_index      = batch_index;
+        odata.material_index   = robj.material.get_index();
+        odata.visibility_index = MAX_INSTANCES + object_indices[i];
+        object_data.emplace_back(odata);
+    }
+}
+
+void Renderer::sort_render_objects(FrameVector<u64>& keys, FrameVector<u32>& object_indices) {
+    // without gpu culling the frustum is tested here, so only visible objects end up in the batches and object data
+    if (gfx_.supports_gpu_culling()) {
+        object_indices.resize(render_objects_.size());
+        std::iota(object_indices.begin(), object_indices.end(), 0);
+    } else {
+        cull_render_objects(object_indices);
+    }
+
+    // depth along the view direction, by the object's origin
+    glm::vec3 camera_position = camera_.get_position();
+    glm::vec3 camera_forward  = camera_.get_forward();
+    f32       inv_far         = 1.0f / camera_.get_far();
+
+    FrameVector<gfx::SortItem> items(object_indices.size(), FrameAllocator<gfx::SortItem>(frame_arena_));
+    for (u32 i = 0; i < object_indices.size(); ++i) {
+        const RenderObject& robj  = render_objects_[object_indices[i]];
+        f32                 depth = glm::dot(glm::vec3(robj.model_matrix[3]) - camera_position, camera_forward);
+
+        items[i].key   = gfx::DrawKey::make(robj.material.get_pipeline(),
+                                            robj.material.get_index(),
+                                            robj.mesh.get_index(),
+                                            depth * inv_far);
+        items[i].value = object_indices[i];
+    }
+
+    FrameVector<gfx::SortItem> temp(items.size(), FrameAllocator<gfx::SortItem>(frame_arena_));
+    gfx::radix_sort(items, temp);
+
+    keys.resize(items.size());
+    for (u32 i = 0; i < items.size(); ++i) {
+        keys[i]           = items[i].key;
+        object_indices[i] = items[i].value;
     }
-    gfx_.update_object_data(object_data);
-    geometry_batch_group_ = gfx_.add_batches(batches);
+}
+
+void Renderer::cull_render_objects(FrameVector<u32>& visible_indices) {
+    u32 num_objects = render_objects_.size();
+
+    // world space bounding spheres, one array per component so they can be tested several at a time
+    FrameVector<f32> x(num_objects, FrameAllocator<f32>(frame_arena_));
+    FrameVector<f32> y(num_objects, FrameAllocator<f32>(frame_arena_));
+    FrameVector<f32> z(num_objects, FrameAllocator<f32>(frame_arena_));
+    FrameVector<f32> radius(num_objects, FrameAllocator<f32>(frame_arena_));
+
+    for (u32 i = 0; i < num_objects; ++i) {
+        const RenderObject& robj            = render_objects_[i];
+        glm::vec4           bounding_sphere = gfx_.get_mesh_data(robj.mesh.get_index()).bounding_sphere;
+        glm::vec4           world_sphere    = transform_bounding_sphere(bounding_sphere, robj.model_matrix);
+
+        x[i]      = world_sphere.x;
+        y[i]      = world_sphere.y;
+        z[i]      = world_sphere.z;
+        radius[i] = world_sphere.w;
+    }
+
+    BoundingSpheres spheres = {};
+    spheres.x               = x.data();
+    spheres.y               = y.data();
+    spheres.z               = z.data();
+    spheres.radius          = radius.data();
+    spheres.count           = num_objects;
+
+    visible_indices.resize(num_objects);
+    visible_indices.resize(cull_spheres(camera_.get_frustum(), spheres, visible_indices.data()));
 }
 
 void Renderer::reset_frame() {
-    render_objects_by_mesh_.clear();
+    // the render objects have to let go of the arena memory they live in before it's released
+    render_objects_    = FrameVector<RenderObject>(FrameAllocator<RenderObject>(frame_arena_));
+    lights_            = FrameVector<gfx::PointLight>(FrameAllocator<gfx::PointLight>(frame_arena_));
+    particle_emitters_ = FrameVector<gfx::ParticleEmitter>(FrameAllocator<gfx::ParticleEmitter>(frame_arena_));
+    frame_arena_.reset();
+
+    frame_start_allocations_ = heap_tracker::get_num_allocations();
 }
 
 } // namespace rune
@@ -1,10 +1,23 @@
 #ifndef RUNE_RENDERER_H
 #define RUNE_RENDERER_H
 
+#include "frame_arena.h"
 #include "gfx/camera.h"
+#include "gfx/clustered_lighting.h"
+#include "gfx/gpu_culling.h"
+#include "gfx/graphics_pass.h"
 #include "gfx/graphics_backend.h"
+#include "gfx/particle_system.h"
+#include "gfx/render_graph.h"
+#include "gfx/shadow_maps.h"
+#include "gfx/tiled_lighting.h"
+#include "gfx/visibility_resolve_pass.h"
+#include "instance_table.h"
 
 #include <glm/glm.hpp>
+#include <limits>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace rune {
@@ -18,8 +31,9 @@ class GraphicsBackend;
 }
 
 struct RenderObject {
-    glm::mat4 model_matrix;
-    gfx::Mesh mesh;
+    glm::mat4     model_matrix;
+    gfx::Mesh     mesh;
+    gfx::Material material;
 };
 
 // graphics frontend
@@ -30,11 +44,89 @@ class Renderer {
 
     /**
      * Add a render object to be rendered this frame
-     * @note Order is not guaranteed to be preserved
+     * @note Order is not guaranteed to be preserved. Occlusion culling remembers whether an object was visible by the
+     * order it was added in, so adding the same objects in the same order every frame keeps that history useful
      * @param robj Render object data for rendering
      */
     void add_to_frame(const RenderObject& robj);
 
+    /**
+     * Add a point light to this frame, lights only reach geometry with deferred or clustered lighting
+     * @param light The light, in world space
+     */
+    void add_light(const gfx::PointLight& light);
+
+    /**
+     * Add a particle emitter to this frame, particles are only simulated and drawn while they're enabled
+     * @param emitter The emitter, in world space
+     */
+    void add_particle_emitter(const gfx::ParticleEmitter& emitter);
+
+    /**
+     * Set the time of this frame, particles move by how much it advanced since the last frame
+     * @param time The time in seconds
+     */
+    void set_time(f32 time) {
+        time_ = time;
+    }
+
+    /**
+     * Set the directional light, it lights geometry with clustered lighting and casts shadows while they're enabled
+     * @param light The light, off by default
+     */
+    void set_directional_light(const gfx::DirectionalLight& light) {
+        directional_light_ = light;
+    }
+
+    /**
+     * Create an instance that's drawn every frame until it's destroyed. Unlike an object added to a frame, an instance
+     * only has to be uploaded again when it's moved, and the batches only change when instances are created or
+     * destroyed
+     * @param mesh The mesh to draw
+     * @param transform The model matrix
+     * @param material The material to draw it with
+     * @param is_static Whether the instance is expected to stay put. Static instances are drawn into cached shadow
+     * maps, which are drawn again whenever one of them is moved
+     * @return A handle to the instance, invalid if the mesh is invalid or MAX_INSTANCES instances already exist
+     */
+    InstanceHandle create_instance(gfx::Mesh        mesh,
+                                   const glm::mat4& transform,
+                                   gfx::Material    material  = {},
+                                   bool             is_static = false);
+
+    /**
+     * Move an instance
+     * @param handle An instance from create_instance
+     * @param transform The model matrix
+     */
+    void set_transform(InstanceHandle handle, const glm::mat4& transform);
+
+    /**
+     * Stop drawing an instance, its handle is invalid after
+     * @param handle An instance from create_instance
+     */
+    void destroy_instance(InstanceHandle handle);
+
+    /**
+     * Find the nearest instance a ray hits, tested against the instances' bounding spheres
+     * @param origin The start of the ray
+     * @param direction The direction of the ray, doesn't need to be normalized
+     * @param max_distance How far along the ray to look
+     * @param distance Set to how far along the ray the hit is, if there is one
+     * @return The instance that was hit, invalid if none was
+     */
+    [[nodiscard]] InstanceHandle pick(glm::vec3 origin,
+                                      glm::vec3 direction,
+                                      f32       max_distance = std::numeric_limits<f32>::max(),
+                                      f32*      distance     = nullptr) const;
+
+    /**
+     * Call a function for every instance whose bounding sphere's box overlaps a box
+     * @param bounds The box, in world space
+     * @param func Called with each instance
+     */
+    void query_box(const Aabb& bounds, FunctionRef<void(InstanceHandle)> func) const;
+
     /**
      * Set the camera for the next render
      * @param camera Camera
@@ -49,17 +141,150 @@ class Renderer {
     void render();
 
   private:
+    // number of frames the batch layout has to stay the same before the frame is expected to not touch the heap
+    static constexpr u32 STEADY_STATE_FRAMES = 4;
+
+    // the most draws culled instances are split into, past that each batch draws every instance between its first and
+    // last visible one. Leaves the rest of a frame's draws to the objects added to it
+    static constexpr u32 MAX_INSTANCE_RUNS = gfx::GraphicsBackend::get_max_draws() / 2;
+
+    // the most instances that can exist at once, they come first in the object data. Leaves the rest of it to the
+    // objects added to a frame
+    static constexpr u32 MAX_INSTANCES = gfx::GraphicsBackend::get_max_objects() / 2;
+
+    // the images a render graph imports, to bind each frame
+    struct GraphImages {
+        gfx::RenderGraph::ResourceId depth;
+        gfx::RenderGraph::ResourceId visibility_id;
+        gfx::RenderGraph::ResourceId gbuffer[gfx::MAX_COLOR_ATTACHMENTS]; // by GBufferAttachment
+        gfx::RenderGraph::ResourceId shadow_map;
+    };
+
+    /**
+     * Place the shadow cascades for this frame if there are any and upload the directional light
+     */
+    void update_directional_light();
+
     void process_object_data();
+
+    /**
+     * Upload the instances that changed since this frame's copy of the object data was last written
+     */
+    void upload_instances();
+
+    /**
+     * Find the instances that might be in the camera's frustum, for when they aren't culled on the gpu. Their object
+     * data stays where it is in the table, each run of visible slots in a batch is drawn as a batch of its own
+     * @param visible_batches Filled with the runs, in slot order
+     */
+    void cull_instances(FrameVector<gfx::MeshBatch>& visible_batches);
+
+    /**
+     * Record a pass that draws a batch group with the geometry shaders
+     * @param pass The pass to draw in
+     * @param cmd The command buffer to record to
+     * @param group The batch group to draw, nothing is drawn if it's empty
+     */
+    void draw_geometry(gfx::GraphicsPass& pass, VkCommandBuffer cmd, const gfx::BatchGroup& group);
+
+    /**
+     * Record a batch group's depth prepass, if there is one, followed by its geometry pass
+     * @param prepass The depth only pass, empty if depth prepasses are disabled
+     * @param pass The geometry pass
+     * @param cmd The command buffer to record to
+     * @param group The batch group to draw
+     */
+    void draw_geometry(std::optional<gfx::GraphicsPass>& prepass,
+                       gfx::GraphicsPass&                pass,
+                       VkCommandBuffer                   cmd,
+                       const gfx::BatchGroup&            group);
+
+    /**
+     * Add the passes of a frame drawn without meshlets to a graph and compile it. The passes keep references to the
+     * ones given and read the frame's batch groups when they're executed. The shadow maps are drawn first if there are
+     * any, and the particles are drawn last if there are any
+     * @param graph The graph to build
+     * @param is_gpu_culled Whether the batches are culled on the gpu in two phases, or were already culled on the cpu
+     * @param resolve_pass The pass that shades the visibility buffer, empty if it's disabled
+     * @param tiled_lighting The passes that light the g-buffer, empty if deferred lighting is disabled
+     * @param clustered_lighting The pass that bins lights for the geometry passes, empty if they aren't lit by clusters
+     * @param images Set to the images the graph imports
+     */
+    void build_render_graph(gfx::RenderGraph&                          graph,
+                            bool                                       is_gpu_culled,
+                            std::optional<gfx::GraphicsPass>&          early_prepass,
+                            gfx::GraphicsPass&                         early_pass,
+                            std::optional<gfx::GraphicsPass>&          late_prepass,
+                            gfx::GraphicsPass&                         late_pass,
+                            std::optional<gfx::VisibilityResolvePass>& resolve_pass,
+                            std::optional<gfx::TiledLighting>&         tiled_lighting,
+                            std::optional<gfx::ClusteredLighting>&     clustered_lighting,
+                            GraphImages&                               images);
+
+    /**
+     * Rebuild batches if the scene layout changed and fill the object data for this frame, touches no gpu state
+     * @param object_data Filled with the object data of the objects added to the frame, placed after the instances
+     * @param instance_batches The batches of the instances that are drawn, they come first
+     */
+    void build_object_data(FrameVector<gfx::ObjectData>& object_data, std::span<const gfx::MeshBatch> instance_batches);
+
+    /**
+     * Sort the render objects that will be drawn by their draw keys, see gfx::DrawKey
+     * @param keys Filled with the sorted keys
+     * @param object_indices Filled with the index of the render object for each key
+     */
+    void sort_render_objects(FrameVector<u64>& keys, FrameVector<u32>& object_indices);
+
+    /**
+     * Test the bounding spheres of the render objects against the camera's frustum on the cpu, for when gpu culling
+     * isn't supported
+     * @param visible_indices Filled with the indices of the visible objects in increasing order
+     */
+    void cull_render_objects(FrameVector<u32>& visible_indices);
+
     void reset_frame();
 
     Core&                 core_;
     gfx::GraphicsBackend& gfx_;
+    gfx::GpuCulling       gpu_culling_;
 
     Camera camera_;
 
-    // render objects grouped by mesh id, we're wasting 8 bytes here per element in vector
-    std::unordered_map<u64, std::vector<RenderObject>> render_objects_by_mesh_;
-    gfx::BatchGroup                                    geometry_batch_group_;
+    gfx::DirectionalLight directional_light_;
+
+    // only created once shadows are drawn, so their shaders aren't needed otherwise
+    std::optional<gfx::ShadowMaps> shadow_maps_;
+
+    // only created once particles are drawn, they're kept on the gpu between frames
+    std::optional<gfx::ParticleSystem> particle_system_;
+    f32                                time_ = 0.0f;
+
+    // per-frame temporaries, reset at the end of each frame once everything has been submitted
+    FrameArena frame_arena_;
+
+    // render objects in the order they were added, they're sorted by draw key when the frame is built
+    FrameVector<RenderObject> render_objects_;
+    gfx::BatchGroup           geometry_batch_group_;
+    u32                       num_objects_ = 0;
+
+    FrameVector<gfx::PointLight>      lights_;
+    FrameVector<gfx::ParticleEmitter> particle_emitters_;
+
+    // what each gpu culling phase kept this frame, written by the render graph's culling passes
+    gfx::BatchGroup early_group_;
+    gfx::BatchGroup late_group_;
+
+    // persist between frames, see create_instance
+    InstanceTable instances_;
+
+    // kept between frames so an unchanged scene layout doesn't rebuild its batches
+    std::vector<gfx::MeshBatch> batches_;
+    std::vector<u64>            batch_layout_; // see build_object_data
+    u64                         batch_layout_hash_           = 0;
+    u32                         num_frames_layout_unchanged_ = 0;
+
+    // used to check that steady state frames don't allocate, see heap_tracker
+    u64 frame_start_allocations_ = 0;
 };
 
 } // namespace rune
@@ -0,0 +1,159 @@
+#include "static_batching.h"
+
+#include "gfx/bvh.h"
+#include "gfx/draw_key.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace rune {
+
+namespace {
+
+// bits of each axis of a Morton code, the code fits under the material in a sort key
+constexpr u32 MORTON_BITS = 10;
+
+/**
+ * Spread the low MORTON_BITS bits of a value out to every third bit
+ */
+u32 spread_bits(u32 v) {
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+/**
+ * @param position The position to get the code of
+ * @param bounds The box the codes are spread over, positions outside are clamped to it
+ * @return The position's place along a Morton curve through the box
+ */
+u32 get_morton_code(glm::vec3 position, const Aabb& bounds) {
+    glm::vec3  size      = glm::max(bounds.max - bounds.min, glm::vec3(1e-6f));
+    glm::vec3  t         = glm::clamp((position - bounds.min) / size, 0.0f, 1.0f);
+    glm::uvec3 quantized = glm::uvec3(t * (f32)((1u << MORTON_BITS) - 1));
+    return (spread_bits(quantized.x) << 2) | (spread_bits(quantized.y) << 1) | spread_bits(quantized.z);
+}
+
+/**
+ * Append the vertices of an object to a triangle list with its transform applied
+ * @param vertices The object's mesh, a triangle list
+ * @param transform The object's model matrix
+ * @param baked The triangle list to append to
+ */
+void bake_vertices(std::span<const Vertex> vertices, const glm::mat4& transform, std::vector<Vertex>& baked) {
+    u32 first = baked.size();
+    for (const Vertex& vertex : vertices) {
+        glm::vec3 position = transform * glm::vec4(vertex.x, vertex.y, vertex.z, 1.0f);
+        baked.emplace_back(Vertex{position.x, position.y, position.z, vertex.u, vertex.v});
+    }
+
+    // a mirroring transform flips the winding, which swapping two corners of each triangle flips back
+    if (glm::determinant(glm::mat3(transform)) < 0.0f) {
+        for (u32 i = first; i + 2 < baked.size(); i += 3) {
+            std::swap(baked[i + 1], baked[i + 2]);
+        }
+    }
+}
+
+} // namespace
+
+std::vector<RenderObject> build_static_clusters(gfx::GraphicsBackend&         gfx,
+                                                std::span<const StaticObject> objects,
+                                                const StaticClusterDesc&      desc) {
+    std::vector<RenderObject> clusters;
+
+    // world space boxes of the objects from their meshes' bounding spheres, objects without a mesh are left out
+    std::vector<u32>       indices;
+    std::vector<Aabb>      boxes(objects.size());
+    std::vector<glm::vec3> centers(objects.size());
+
+    Aabb center_bounds = {glm::vec3(std::numeric_limits<f32>::max()), glm::vec3(std::numeric_limits<f32>::lowest())};
+    for (u32 i = 0; i < objects.size(); ++i) {
+        const RenderObject& robj = objects[i].object;
+        if (robj.mesh.get_index() == gfx::Mesh::INVALID_INDEX) {
+            continue;
+        }
+
+        glm::vec4        bounding_sphere = gfx.get_mesh_data(robj.mesh.get_index()).bounding_sphere;
+        const glm::mat4& m               = robj.model_matrix;
+
+        // the largest axis scale keeps the sphere around the mesh under non-uniform scaling
+        f32 scale = glm::max(glm::length(glm::vec3(m[0])),
+                             glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+
+        centers[i]    = m * glm::vec4(glm::vec3(bounding_sphere), 1.0f);
+        boxes[i]      = Aabb::from_sphere(centers[i], bounding_sphere.w * scale);
+        center_bounds = center_bounds.merge(Aabb{centers[i], centers[i]});
+        indices.emplace_back(i);
+    }
+
+    // each material's objects are contiguous and follow the Morton curve within it, so runs of them are close together
+    std::vector<gfx::SortItem> items(indices.size());
+    for (u32 i = 0; i < indices.size(); ++i) {
+        u64 material   = objects[indices[i]].object.material.get_index();
+        items[i].key   = (material << 32) | get_morton_code(centers[indices[i]], center_bounds);
+        items[i].value = indices[i];
+    }
+
+    std::vector<gfx::SortItem> temp(items.size());
+    gfx::radix_sort(items, temp);
+    for (u32 i = 0; i < items.size(); ++i) {
+        indices[i] = items[i].value;
+    }
+
+    std::vector<Vertex> vertices;
+    for (u32 first = 0, last = 0; first < indices.size(); first = last) {
+        const RenderObject& first_object = objects[indices[first]].object;
+        Aabb                bounds       = boxes[indices[first]];
+        u32                 num_vertices = objects[indices[first]].vertices.size();
+
+        // grow the cluster along the curve until it would break a limit, the first object always fits
+        for (last = first + 1; last < indices.size(); ++last) {
+            const StaticObject& object = objects[indices[last]];
+            Aabb                merged = bounds.merge(boxes[indices[last]]);
+            glm::vec3           size   = merged.max - merged.min;
+            if (object.object.material != first_object.material ||
+                num_vertices + object.vertices.size() > desc.max_vertices ||
+                glm::max(size.x, glm::max(size.y, size.z)) > desc.max_extent) {
+                break;
+            }
+
+            bounds = merged;
+            num_vertices += object.vertices.size();
+        }
+
+        // a lone object already is a mesh of its own
+        if (last - first == 1) {
+            clusters.emplace_back(first_object);
+            continue;
+        }
+
+        vertices.clear();
+        vertices.reserve(num_vertices);
+        for (u32 i = first; i < last; ++i) {
+            const StaticObject& object = objects[indices[i]];
+            bake_vertices(object.vertices, object.object.model_matrix, vertices);
+        }
+
+        RenderObject cluster = {};
+        cluster.model_matrix = glm::mat4(1.0f);
+        cluster.mesh         = gfx.load_mesh(vertices);
+        cluster.material     = first_object.material;
+
+        // out of room for the merged mesh, the objects are still drawn on their own
+        if (cluster.mesh.get_index() == gfx::Mesh::INVALID_INDEX) {
+            for (u32 i = first; i < last; ++i) {
+                clusters.emplace_back(objects[indices[i]].object);
+            }
+            continue;
+        }
+
+        clusters.emplace_back(cluster);
+    }
+
+    return clusters;
+}
+
+} // namespace rune
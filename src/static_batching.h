@@ -0,0 +1,50 @@
+#ifndef RUNE_STATIC_BATCHING_H
+#define RUNE_STATIC_BATCHING_H
+
+#include "gfx/graphics_backend.h"
+#include "renderer.h"
+#include "types.h"
+#include "vertex.h"
+
+#include <span>
+#include <vector>
+
+namespace rune {
+
+/**
+ * Limits of the clusters build_static_clusters merges objects into
+ */
+struct StaticClusterDesc {
+    u32 max_vertices = 384;   // objects with more vertices than this get a cluster of their own
+    f32 max_extent   = 16.0f; // the longest side a cluster's box can have, in world units
+};
+
+/**
+ * An object for build_static_clusters to merge
+ */
+struct StaticObject {
+    RenderObject            object;
+    std::span<const Vertex> vertices; // the full detail vertices its mesh was loaded from, a triangle list
+};
+
+/**
+ * Merge objects that never move into clusters, each loaded as one mesh with the objects' transforms baked into its
+ * vertices. Only objects with the same material are merged. They're ordered along a Morton curve through their
+ * centers and cut into clusters where the material changes or a cluster would get too big, so the objects of a
+ * cluster are near each other and its bounds stay tight for culling.
+ * Instances of the clusters replace the objects, which turns the draws and object data of level geometry into a few
+ * per area. The clusters' meshes live in the unified vertex buffer like any other mesh, the backend keeps no copy of
+ * the vertices so the caller passes them in
+ * @param gfx The backend to load the clusters' meshes with
+ * @param objects The objects to merge, their vertices only have to live until this returns
+ * @param desc The limits of a cluster
+ * @return A render object for each cluster with an identity transform. Objects of a cluster whose mesh couldn't be
+ * loaded are returned as they are
+ */
+std::vector<RenderObject> build_static_clusters(gfx::GraphicsBackend&         gfx,
+                                                std::span<const StaticObject> objects,
+                                                const StaticClusterDesc&      desc = {});
+
+} // namespace rune
+
+#endif // RUNE_STATIC_BATCHING_H
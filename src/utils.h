@@ -2,10 +2,12 @@
 #define RUNE_UTILS_H
 
 #include "consts.h"
+#include "types.h"
 
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace rune::utils {
@@ -96,6 +98,27 @@ template <typename... Args> static std::string format_str(const char* format, co
     return out.str();
 }
 
+/**
+ * Transparent string hash, lets string keyed maps be searched with a std::string_view without building a std::string
+ */
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view str) const {
+        return std::hash<std::string_view>{}(str);
+    }
+};
+
+/**
+ * Mix a value into a running hash
+ * @param seed The hash so far
+ * @param value The value to mix in
+ * @return The combined hash
+ */
+constexpr u64 hash_combine(u64 seed, u64 value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
 static std::vector<char> load_binary_file(const char* path) {
     std::vector<char> data;
 
@@ -0,0 +1,185 @@
+// Bakes lod chains for every .obj under an asset directory, writing a .lods file next to each one, see
+// gfx::save_lod_chain. GraphicsBackend::load_mesh reads them instead of simplifying the mesh when it's loaded. Meshes
+// are simplified in parallel on all cores.
+//
+// usage: mesh_lod_baker <asset directory> [max lods]
+
+#include "gfx/mesh_simplifier.h"
+#include "types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rune;
+
+namespace {
+
+/**
+ * Read the triangles of an obj file, polygons are triangulated as fans. Normals, materials and groups are ignored
+ */
+bool load_obj(const std::filesystem::path& path, std::vector<Vertex>& vertices) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    struct Position {
+        f32 x, y, z;
+    };
+    struct TexCoord {
+        f32 u, v;
+    };
+
+    std::vector<Position> positions;
+    std::vector<TexCoord> tex_coords;
+
+    // obj indices start at 1, negative ones count back from the last element
+    auto resolve = [](i64 index, size_t count) -> i64 { return index < 0 ? (i64)count + index : index - 1; };
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string        type;
+        stream >> type;
+
+        if (type == "v") {
+            Position& p = positions.emplace_back();
+            stream >> p.x >> p.y >> p.z;
+        } else if (type == "vt") {
+            TexCoord& t = tex_coords.emplace_back();
+            stream >> t.u >> t.v;
+            t.v = 1.0f - t.v; // obj has v pointing up, textures are sampled from the top left
+        } else if (type == "f") {
+            std::vector<Vertex> face;
+            std::string         corner;
+            while (stream >> corner) {
+                long long position_index  = 0;
+                long long tex_coord_index = 0;
+                if (std::sscanf(corner.c_str(), "%lld/%lld", &position_index, &tex_coord_index) < 1) {
+                    return false;
+                }
+
+                i64 p = resolve(position_index, positions.size());
+                if (p < 0 || p >= (i64)positions.size()) {
+                    return false;
+                }
+
+                Vertex& v = face.emplace_back();
+                v.x       = positions[p].x;
+                v.y       = positions[p].y;
+                v.z       = positions[p].z;
+                v.u       = 0.0f;
+                v.v       = 0.0f;
+
+                i64 t = tex_coord_index != 0 ? resolve(tex_coord_index, tex_coords.size()) : -1;
+                if (t >= 0 && t < (i64)tex_coords.size()) {
+                    v.u = tex_coords[t].u;
+                    v.v = tex_coords[t].v;
+                }
+            }
+
+            for (size_t i = 2; i < face.size(); ++i) {
+                vertices.push_back(face[0]);
+                vertices.push_back(face[i - 1]);
+                vertices.push_back(face[i]);
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <asset directory> [max lods]\n", argv[0]);
+        return 1;
+    }
+
+    std::filesystem::path asset_dir = argv[1];
+    u32                   max_lods  = argc > 2 ? (u32)std::atoi(argv[2]) : gfx::MAX_MESH_LODS;
+    if (max_lods == 0 || max_lods > gfx::MAX_MESH_LODS) {
+        std::fprintf(stderr, "max lods must be between 1 and %u\n", gfx::MAX_MESH_LODS);
+        return 1;
+    }
+
+    std::error_code                    error;
+    std::vector<std::filesystem::path> paths;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(asset_dir, error)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".obj") {
+            paths.push_back(entry.path());
+        }
+    }
+
+    if (error) {
+        std::fprintf(stderr, "could not read %s: %s\n", asset_dir.string().c_str(), error.message().c_str());
+        return 1;
+    }
+
+    // Biggest first so one large mesh doesn't end up alone on a thread at the end
+    std::sort(paths.begin(), paths.end(), [](const auto& lhs, const auto& rhs) {
+        return std::filesystem::file_size(lhs) > std::filesystem::file_size(rhs);
+    });
+
+    std::atomic<u32> next_path  = 0;
+    std::atomic<u32> num_failed = 0;
+    std::mutex       print_mutex;
+
+    auto start  = std::chrono::steady_clock::now();
+    auto worker = [&]() {
+        for (u32 i = next_path++; i < paths.size(); i = next_path++) {
+            std::vector<Vertex>        vertices;
+            std::vector<gfx::LodLevel> lods;
+
+            bool is_loaded = load_obj(paths[i], vertices);
+            if (is_loaded) {
+                lods = gfx::build_lod_chain(vertices.data(), vertices.size(), max_lods);
+            }
+            std::filesystem::path lods_path = std::filesystem::path(paths[i]).replace_extension(".lods");
+            bool                  is_saved  = is_loaded && gfx::save_lod_chain(lods_path.string().c_str(), lods);
+
+            std::lock_guard lock(print_mutex);
+            if (!is_saved) {
+                ++num_failed;
+                std::fprintf(stderr, "failed: %s\n", paths[i].string().c_str());
+                continue;
+            }
+
+            std::printf("%s:", paths[i].string().c_str());
+            for (const gfx::LodLevel& lod : lods) {
+                std::printf(" %zu (%g)", lod.vertices.size() / 3, lod.error);
+            }
+            std::printf("\n");
+        }
+    };
+
+    u32 num_threads = std::max(1u, std::min<u32>(std::thread::hardware_concurrency(), paths.size()));
+
+    std::vector<std::thread> threads;
+    for (u32 i = 0; i < num_threads; ++i) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    std::printf("baked %zu meshes on %u threads in %.2f s, %u failed\n",
+                paths.size() - num_failed,
+                num_threads,
+                std::chrono::duration<f64>(end - start).count(),
+                num_failed.load());
+
+    return num_failed > 0 ? 1 : 0;
+}